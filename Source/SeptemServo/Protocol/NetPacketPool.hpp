@@ -5,14 +5,16 @@
 #include "CoreMinimal.h"
 #include "Containers/Queue.h"
 #include "Containers/BinaryHeap.h"
+#include "HAL/ThreadSafeCounter64.h"
 
 #define MAX_NETPACKET_IN_POOL 1024
 
 /**
  * net packet pool base class
  * for set any pool algorithm 
+ * TItem is a packet handle: FServoPacketRef or TSharedPtr, with IsValid() and Reset()
  */
-template<typename T, ESPMode TMode = ESPMode::Fast>
+template<typename TItem>
 class SEPTEMSERVO_API TNetPacketPool
 {
 public:
@@ -24,23 +26,103 @@ public:
 	/**
 	 * Push an item to the pool.
 	 * @Thread-safe
-	 * @param InSharedPtr The item to add.
+	 * @param InItem The item to add.
 	 * @return true if the item was added, false otherwise.
 	 * @note To be called only from producer thread(s).
 	 * @see Pop
 	 */
-	virtual bool Push(const TSharedPtr<T, TMode>& InSharedPtr) = 0;
+	virtual bool Push(const TItem& InItem) = 0;
 	/**
 	 * Removes and returns the item from the tail of the pool.
 	 * @Thread-safe
-	 * @param OutSharedPtr Will hold the returned value.
+	 * @param OutItem Will hold the returned value.
 	 * @return true if a value was returned, false if the pool was empty.
 	 * @note To be called only from consumer thread.
 	 * @see Push
 	 */
-	virtual bool Pop(TSharedPtr<T, TMode>& OutSharedPtr) = 0;
+	virtual bool Pop(TItem& OutItem) = 0;
 	// may not Thread-safe
 	virtual bool IsEmpty() = 0;
+
+	/**
+	 * Items the pool can take before Push fails.
+	 * @Thread-safe, approximate while other threads push/pop
+	 * @return MAX_int32 for unbounded pools
+	 */
+	virtual int32 GetHeadroom()
+	{
+		return MAX_int32;
+	}
+
+	/**
+	 * Push all valid items of InItems to the pool.
+	 * @Thread-safe
+	 * @return count of items added
+	 * @note override to publish the batch with one lock or atomic op
+	 */
+	virtual int32 PushBatch(const TArray<TItem>& InItems)
+	{
+		int32 count = 0;
+		for (int32 i = 0; i < InItems.Num(); ++i)
+		{
+			if (InItems[i].IsValid() && Push(InItems[i]))
+			{
+				++count;
+			}
+		}
+		return count;
+	}
+
+	/**
+	 * Push valid items of InOutItems in order until the pool is full.
+	 * items which don't fit stay in InOutItems in order, invalid items are removed
+	 * @Thread-safe
+	 * @return count of items added
+	 */
+	virtual int32 TryPushBatch(TArray<TItem>& InOutItems)
+	{
+		int32 count = 0;
+		int32 keepNum = 0;
+		bool bFull = false;
+		for (int32 i = 0; i < InOutItems.Num(); ++i)
+		{
+			if (!InOutItems[i].IsValid())
+				continue;
+
+			if (!bFull && Push(InOutItems[i]))
+			{
+				++count;
+				continue;
+			}
+
+			// later items stay behind the first one kept, order is not broken
+			bFull = true;
+			if (keepNum != i)
+			{
+				InOutItems[keepNum] = MoveTemp(InOutItems[i]);
+			}
+			++keepNum;
+		}
+		InOutItems.SetNum(keepNum, false);
+		return count;
+	}
+
+	/**
+	 * Pop up to InMax items, append to the end of OutItems.
+	 * @note To be called only from consumer thread.
+	 * @return count of items popped
+	 */
+	virtual int32 PopBatch(TArray<TItem>& OutItems, int32 InMax)
+	{
+		int32 count = 0;
+		TItem item;
+		while (count < InMax && Pop(item))
+		{
+			OutItems.Add(MoveTemp(item));
+			++count;
+		}
+		return count;
+	}
 };
 
 /**
@@ -48,7 +130,7 @@ public:
  * Attention about maxnum > heap.num
  * add a private lock for Multiple-producers
  */
-template<typename T, ESPMode TMode = ESPMode::Fast>
+template<typename TItem>
 class SEPTEMSERVO_API TNetPacketStack
 {
 public:
@@ -66,20 +148,20 @@ public:
 	}
 
 	// Thread-safe
-	virtual bool Push(const TSharedPtr<T, TMode>& InSharedPtr) override
+	virtual bool Push(const TItem& InItem) override
 	{
 		FScopeLock lockPool(&StackPool);
-		//StackPool.Push(InSharedPtr);
-		StackPool.Emplace(InSharedPtr);
+		//StackPool.Push(InItem);
+		StackPool.Emplace(InItem);
 		return true;
 	}
 	// Thread-safe
-	virtual bool Pop(TSharedPtr<T, TMode>& OutSharedPtr) override
+	virtual bool Pop(TItem& OutItem) override
 	{
 		FScopeLock lockPool(&StackPool);
 		if (IsEmpty())
 			return false;
-		OutSharedPtr = StackPool.Pop(false);
+		OutItem = StackPool.Pop(false);
 		return true;
 	}
 	// may not Thread-safe
@@ -89,46 +171,262 @@ public:
 	}
 
 private:
-	TArray<TSharedPtr<T, TMode> > StackPool;
+	TArray<TItem> StackPool;
 	FCriticalSection StackLock;
 };
 
 /**
  * net packet pool with Queue strategy
  * Multiple-producers single-consumer (MPSC)  for multi-thread
+ * intrusive node list like TQueue<EQueueMode::Mpsc>, and a batch is
+ * linked privately then published with one atomic exchange
  */
-template<typename T, ESPMode TMode = ESPMode::Fast>
+template<typename TItem>
 class SEPTEMSERVO_API TNetPacketQueue
-	: public TNetPacketPool<T, TMode>
+	: public TNetPacketPool<TItem>
 {
 public:
 	FORCEINLINE TNetPacketQueue()
 		: TNetPacketPool()
 	{
+		Head = Tail = new FNode();
 	}
 
 	virtual ~TNetPacketQueue()
 	{
-		packetPool.Empty();
+		while (Tail != nullptr)
+		{
+			FNode* Node = Tail;
+			Tail = Tail->NextNode;
+			delete Node;
+		}
 	}
 
-	virtual bool Push(const TSharedPtr<T, TMode>& InSharedPtr) override
+	virtual bool Push(const TItem& InItem) override
 	{
-		return packetPool.Enqueue(InSharedPtr);
+		FNode* NewNode = new FNode(InItem);
+		Publish(NewNode, NewNode);
+		return true;
 	}
 
-	virtual bool Pop(TSharedPtr<T, TMode>& OutSharedPtr) override
+	virtual bool Pop(TItem& OutItem) override
 	{
-		return packetPool.Dequeue(OutSharedPtr);
+		FNode* Popped = Tail->NextNode;
+		if (Popped == nullptr)
+		{
+			return false;
+		}
+
+		OutItem = MoveTemp(Popped->Item);
+
+		FNode* OldTail = Tail;
+		Tail = Popped;
+		Tail->Item.Reset();
+		delete OldTail;
+
+		return true;
 	}
 
 	virtual bool IsEmpty() override
 	{
-		return packetPool.IsEmpty();
+		return Tail->NextNode == nullptr;
+	}
+
+	virtual int32 PushBatch(const TArray<TItem>& InItems) override
+	{
+		FNode* First = nullptr;
+		FNode* Last = nullptr;
+		int32 count = 0;
+
+		// link the batch privately
+		for (int32 i = 0; i < InItems.Num(); ++i)
+		{
+			if (!InItems[i].IsValid())
+				continue;
+
+			FNode* NewNode = new FNode(InItems[i]);
+			if (Last)
+			{
+				Last->NextNode = NewNode;
+			}
+			else {
+				First = NewNode;
+			}
+			Last = NewNode;
+			++count;
+		}
+
+		if (First)
+		{
+			Publish(First, Last);
+		}
+
+		return count;
 	}
 
 private:
-	TQueue<TSharedPtr<T, TMode>, EQueueMode::Mpsc > packetPool;
+	struct FNode
+	{
+		FNode* volatile NextNode;
+		TItem Item;
+
+		FNode()
+			: NextNode(nullptr)
+		{
+		}
+
+		explicit FNode(const TItem& InItem)
+			: NextNode(nullptr)
+			, Item(InItem)
+		{
+		}
+	};
+
+	// producers: swap head to Last, then link old head to First
+	FORCEINLINE void Publish(FNode* First, FNode* Last)
+	{
+		FNode* OldHead = (FNode*)FPlatformAtomics::InterlockedExchangePtr((void**)&Head, Last);
+		FPlatformAtomics::InterlockedExchangePtr((void**)&OldHead->NextNode, First);
+	}
+
+	// Holds a pointer to the head of the list, written by producers
+	MS_ALIGN(16) FNode* volatile Head GCC_ALIGN(16);
+
+	// Holds a pointer to the tail of the list, only read by consumer
+	FNode* Tail;
+};
+
+
+/**
+ * net packet pool with bounded Ring strategy
+ * Multiple-producers multiple-consumers (MPMC), Vyukov bounded array queue:
+ * each cell has a sequence number, producers and consumers claim a position with one CAS.
+ * capacity is rounded up to power of two, Push fails when the ring is full.
+ * no allocation after construction
+ */
+template<typename TItem>
+class SEPTEMSERVO_API TNetPacketRing
+	: public TNetPacketPool<TItem>
+{
+public:
+	TNetPacketRing(int32 InCapacity = MAX_NETPACKET_IN_POOL)
+		: TNetPacketPool()
+		, EnqueuePos(0)
+		, DequeuePos(0)
+	{
+		const int32 capacity = (int32)FMath::RoundUpToPowerOfTwo((uint32)FMath::Max(InCapacity, 2));
+		Mask = capacity - 1;
+		Cells = new FCell[capacity];
+		for (int32 i = 0; i < capacity; ++i)
+		{
+			Cells[i].Sequence = i;
+		}
+	}
+
+	virtual ~TNetPacketRing()
+	{
+		delete[] Cells;
+	}
+
+	virtual bool Push(const TItem& InItem) override
+	{
+		FCell* cell = nullptr;
+		int64 pos = FPlatformAtomics::AtomicRead(&EnqueuePos);
+		for (;;)
+		{
+			cell = &Cells[pos & Mask];
+			const int64 diff = FPlatformAtomics::AtomicRead(&cell->Sequence) - pos;
+			if (0 == diff)
+			{
+				// cell is free for pos, claim it
+				if (FPlatformAtomics::InterlockedCompareExchange(&EnqueuePos, pos + 1, pos) == pos)
+				{
+					break;
+				}
+				pos = FPlatformAtomics::AtomicRead(&EnqueuePos);
+			}
+			else if (diff < 0)
+			{
+				// ring is full
+				return false;
+			}
+			else {
+				pos = FPlatformAtomics::AtomicRead(&EnqueuePos);
+			}
+		}
+
+		cell->Item = InItem;
+		// publish to consumers
+		FPlatformAtomics::InterlockedExchange(&cell->Sequence, pos + 1);
+		return true;
+	}
+
+	virtual bool Pop(TItem& OutItem) override
+	{
+		FCell* cell = nullptr;
+		int64 pos = FPlatformAtomics::AtomicRead(&DequeuePos);
+		for (;;)
+		{
+			cell = &Cells[pos & Mask];
+			const int64 diff = FPlatformAtomics::AtomicRead(&cell->Sequence) - (pos + 1);
+			if (0 == diff)
+			{
+				// cell is filled for pos, claim it
+				if (FPlatformAtomics::InterlockedCompareExchange(&DequeuePos, pos + 1, pos) == pos)
+				{
+					break;
+				}
+				pos = FPlatformAtomics::AtomicRead(&DequeuePos);
+			}
+			else if (diff < 0)
+			{
+				// ring is empty
+				return false;
+			}
+			else {
+				pos = FPlatformAtomics::AtomicRead(&DequeuePos);
+			}
+		}
+
+		OutItem = MoveTemp(cell->Item);
+		// free the cell for the producer of next lap
+		FPlatformAtomics::InterlockedExchange(&cell->Sequence, pos + Mask + 1);
+		return true;
+	}
+
+	// approximate while other threads push/pop
+	virtual bool IsEmpty() override
+	{
+		return FPlatformAtomics::AtomicRead(&DequeuePos) >= FPlatformAtomics::AtomicRead(&EnqueuePos);
+	}
+
+	virtual int32 GetHeadroom() override
+	{
+		const int64 depth = FPlatformAtomics::AtomicRead(&EnqueuePos) - FPlatformAtomics::AtomicRead(&DequeuePos);
+		return (int32)FMath::Clamp<int64>(Mask + 1 - depth, 0, Mask + 1);
+	}
+
+	int32 GetCapacity() const
+	{
+		return Mask + 1;
+	}
+
+private:
+	struct FCell
+	{
+		volatile int64 Sequence;
+		TItem Item;
+	};
+
+	FCell* Cells;
+	int64 Mask;
+
+	// producers and consumers don't share cache lines
+	uint8 PaddingHead[PLATFORM_CACHE_LINE_SIZE];
+	volatile int64 EnqueuePos;
+	uint8 PaddingEnqueue[PLATFORM_CACHE_LINE_SIZE - sizeof(int64)];
+	volatile int64 DequeuePos;
+	uint8 PaddingDequeue[PLATFORM_CACHE_LINE_SIZE - sizeof(int64)];
 };
 
 
@@ -137,9 +435,9 @@ private:
  * Attention about maxnum > heap.num
  * add a private lock for Multiple-producers 
  */
-template<typename T, ESPMode TMode = ESPMode::Fast>
+template<typename TItem>
 class SEPTEMSERVO_API TNetPacketHeap
-	: public TNetPacketPool<T, TMode>
+	: public TNetPacketPool<TItem>
 {
 public:
 	FORCEINLINE TNetPacketHeap()
@@ -155,18 +453,18 @@ public:
 		heapPool.Empty(heapPool.Max());
 	}
 
-	bool Push(const TSharedPtr<T, TMode>& InSharedPtr) override
+	bool Push(const TItem& InItem) override
 	{
 		FScopeLock lockPool(&HeapLock);
-		return heapPool.HeapPush(InSharedPtr) >=0;
+		return heapPool.HeapPush(InItem) >=0;
 	}
 
-	bool Pop(TSharedPtr<T, TMode>& OutSharedPtr) override
+	bool Pop(TItem& OutItem) override
 	{
 		FScopeLock lockPool(&HeapLock);
 		if (IsEmpty())
 			return false;
-		heapPool.HeapPop(OutSharedPtr, false);
+		heapPool.HeapPop(OutItem, false);
 		return true;
 	}
 
@@ -174,8 +472,285 @@ public:
 	{
 		return heapPool.Num() == 0;
 	}
+
+	virtual int32 PushBatch(const TArray<TItem>& InItems) override
+	{
+		FScopeLock lockPool(&HeapLock);
+		int32 count = 0;
+		for (int32 i = 0; i < InItems.Num(); ++i)
+		{
+			if (InItems[i].IsValid())
+			{
+				heapPool.HeapPush(InItems[i]);
+				++count;
+			}
+		}
+		return count;
+	}
 	
 private:
-	TArray<TSharedPtr<T, TMode> > heapPool;
+	TArray<TItem> heapPool;
 	FCriticalSection HeapLock;
-};
\ No newline at end of file
+};
+
+/**
+ * lane of TNetPacketLanes, packets with MinUid <= Head.uid <= MaxUid
+ */
+struct FNetPacketLaneConfig
+{
+	uint16 MinUid;
+	uint16 MaxUid;
+	// bounded ring of this lane
+	int32 Capacity;
+	// share of pops under weighted fair policy
+	int32 Weight;
+
+	FNetPacketLaneConfig(uint16 InMinUid = 0, uint16 InMaxUid = 0xffff, int32 InCapacity = MAX_NETPACKET_IN_POOL, int32 InWeight = 1)
+		: MinUid(InMinUid)
+		, MaxUid(InMaxUid)
+		, Capacity(InCapacity)
+		, Weight(InWeight)
+	{
+	}
+};
+
+/**
+ * depth metrics of one lane
+ */
+struct FNetPacketLaneStats
+{
+	int32 Depth;		// packets waiting
+	int64 PushCount;	// total packets pushed
+	int64 PopCount;		// total packets popped
+	int64 DropCount;	// total packets dropped, lane was full
+};
+
+enum class ENetPacketLanePolicy : uint8
+{
+	// always pop the first non-empty lane, lower lane index first
+	StrictPriority,
+	// pop lanes by weight (smooth weighted round robin), empty turns go to the next lane by priority
+	WeightedFair
+};
+
+/**
+ * net packet pool with priority Lanes strategy
+ * packets are routed by Head.uid to lanes, each lane is a bounded MPMC ring.
+ * a uid without a lane goes to the last lane.
+ * MPMC, no lock: weighted schedule is precomputed and indexed by an atomic ticket
+ */
+template<typename TItem>
+class SEPTEMSERVO_API TNetPacketLanes
+	: public TNetPacketPool<TItem>
+{
+public:
+	TNetPacketLanes(const TArray<FNetPacketLaneConfig>& InLanes, ENetPacketLanePolicy InPolicy = ENetPacketLanePolicy::WeightedFair)
+		: TNetPacketPool()
+		, Policy(InPolicy)
+		, PopTicket(0)
+	{
+		check(InLanes.Num() > 0);
+		for (int32 i = 0; i < InLanes.Num(); ++i)
+		{
+			Lanes.Add(new FLane(InLanes[i]));
+		}
+		BuildSchedule();
+	}
+
+	virtual ~TNetPacketLanes()
+	{
+		for (int32 i = 0; i < Lanes.Num(); ++i)
+		{
+			delete Lanes[i];
+		}
+		Lanes.Empty();
+	}
+
+	virtual bool Push(const TItem& InItem) override
+	{
+		FLane& lane = *Lanes[LaneOf(InItem->Head.uid)];
+		if (lane.Ring.Push(InItem))
+		{
+			lane.PushCount.Increment();
+			return true;
+		}
+		lane.DropCount.Increment();
+		return false;
+	}
+
+	virtual bool Pop(TItem& OutItem) override
+	{
+		int32 first = 0;
+		if (ENetPacketLanePolicy::WeightedFair == Policy)
+		{
+			const int64 ticket = FPlatformAtomics::InterlockedIncrement(&PopTicket);
+			first = Schedule[ticket % Schedule.Num()];
+		}
+
+		// scheduled lane, then the others by priority
+		if (PopLane(first, OutItem))
+		{
+			return true;
+		}
+		for (int32 i = 0; i < Lanes.Num(); ++i)
+		{
+			if (i != first && PopLane(i, OutItem))
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	virtual bool IsEmpty() override
+	{
+		for (int32 i = 0; i < Lanes.Num(); ++i)
+		{
+			if (!Lanes[i]->Ring.IsEmpty())
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// lane of a packet is known only after decode: room of the emptiest lane,
+	// packets of a full lane are kept by TryPushBatch and don't stop the other lanes
+	virtual int32 GetHeadroom() override
+	{
+		int32 headroom = 0;
+		for (int32 i = 0; i < Lanes.Num(); ++i)
+		{
+			headroom = FMath::Max(headroom, Lanes[i]->Ring.GetHeadroom());
+		}
+		return headroom;
+	}
+
+	// a full lane keeps its items in order, items of lanes with room are still pushed
+	virtual int32 TryPushBatch(TArray<TItem>& InOutItems) override
+	{
+		TArray<bool, TInlineAllocator<8> > laneFull;
+		laneFull.SetNumZeroed(Lanes.Num());
+
+		int32 count = 0;
+		int32 keepNum = 0;
+		for (int32 i = 0; i < InOutItems.Num(); ++i)
+		{
+			if (!InOutItems[i].IsValid())
+				continue;
+
+			const int32 laneIndex = LaneOf(InOutItems[i]->Head.uid);
+			FLane& lane = *Lanes[laneIndex];
+			if (!laneFull[laneIndex] && lane.Ring.Push(InOutItems[i]))
+			{
+				lane.PushCount.Increment();
+				++count;
+				continue;
+			}
+
+			// kept, not dropped
+			laneFull[laneIndex] = true;
+			if (keepNum != i)
+			{
+				InOutItems[keepNum] = MoveTemp(InOutItems[i]);
+			}
+			++keepNum;
+		}
+		InOutItems.SetNum(keepNum, false);
+		return count;
+	}
+
+	// thread safe
+	void GetLaneStats(TArray<FNetPacketLaneStats>& OutStats)
+	{
+		OutStats.SetNum(Lanes.Num());
+		for (int32 i = 0; i < Lanes.Num(); ++i)
+		{
+			FLane& lane = *Lanes[i];
+			FNetPacketLaneStats& stats = OutStats[i];
+			stats.PushCount = lane.PushCount.GetValue();
+			stats.PopCount = lane.PopCount.GetValue();
+			stats.DropCount = lane.DropCount.GetValue();
+			stats.Depth = (int32)FMath::Max<int64>(stats.PushCount - stats.PopCount, 0);
+		}
+	}
+
+	int32 NumLanes() const
+	{
+		return Lanes.Num();
+	}
+
+	// lane index of uid
+	int32 LaneOf(uint16 InUid) const
+	{
+		for (int32 i = 0; i < Lanes.Num(); ++i)
+		{
+			if (InUid >= Lanes[i]->Config.MinUid && InUid <= Lanes[i]->Config.MaxUid)
+			{
+				return i;
+			}
+		}
+		return Lanes.Num() - 1;
+	}
+
+private:
+	struct FLane
+	{
+		FNetPacketLaneConfig Config;
+		TNetPacketRing<TItem> Ring;
+		FThreadSafeCounter64 PushCount;
+		FThreadSafeCounter64 PopCount;
+		FThreadSafeCounter64 DropCount;
+
+		explicit FLane(const FNetPacketLaneConfig& InConfig)
+			: Config(InConfig)
+			, Ring(InConfig.Capacity)
+		{
+		}
+	};
+
+	FORCEINLINE bool PopLane(int32 InLane, TItem& OutItem)
+	{
+		FLane& lane = *Lanes[InLane];
+		if (lane.Ring.Pop(OutItem))
+		{
+			lane.PopCount.Increment();
+			return true;
+		}
+		return false;
+	}
+
+	// smooth weighted round robin, lanes are spread over the schedule instead of bursts
+	void BuildSchedule()
+	{
+		int32 totalWeight = 0;
+		TArray<int32> current;
+		current.SetNumZeroed(Lanes.Num());
+		for (int32 i = 0; i < Lanes.Num(); ++i)
+		{
+			totalWeight += FMath::Max(Lanes[i]->Config.Weight, 1);
+		}
+
+		Schedule.Reset(totalWeight);
+		for (int32 slot = 0; slot < totalWeight; ++slot)
+		{
+			int32 best = 0;
+			for (int32 i = 0; i < Lanes.Num(); ++i)
+			{
+				current[i] += FMath::Max(Lanes[i]->Config.Weight, 1);
+				if (current[i] > current[best])
+				{
+					best = i;
+				}
+			}
+			current[best] -= totalWeight;
+			Schedule.Add(best);
+		}
+	}
+
+	TArray<FLane*> Lanes;
+	ENetPacketLanePolicy Policy;
+	// lane index of each pop turn
+	TArray<int32> Schedule;
+	volatile int64 PopTicket;
+};
@@ -0,0 +1,113 @@
+// Copyright (c) 2013-2019 7Mersenne All Rights Reserved.
+
+#include "NetRecvSlab.h"
+
+#include "Misc/ScopeLock.h"
+
+FSNetRecvSlab::FSNetRecvSlab(FSNetRecvSlabPool * InOwner, int32 InCapacity)
+	: Data(nullptr)
+	, Capacity(InCapacity)
+	, Owner(InOwner)
+{
+	check(InCapacity > 0);
+	Data = new uint8[Capacity];
+}
+
+FSNetRecvSlab::~FSNetRecvSlab()
+{
+	if (Data)
+	{
+		delete[] Data;
+		Data = nullptr;
+	}
+	Capacity = 0;
+}
+
+void FSNetRecvSlab::AddRef()
+{
+	RefCount.Increment();
+}
+
+void FSNetRecvSlab::Release()
+{
+	const int32 count = RefCount.Decrement();
+	check(count >= 0);
+
+	if (0 == count)
+	{
+		if (Owner)
+		{
+			Owner->Dealloc(this);
+		}
+		else {
+			delete this;
+		}
+	}
+}
+
+FSNetRecvSlabPool::FSNetRecvSlabPool(int32 InSlabSize, int32 InMaxnum)
+	: SlabSize(InSlabSize)
+	, Maxnum(InMaxnum)
+{
+	FScopeLock lockPool(&poolCriticalSection);
+	slabPool.Reset(Maxnum);
+}
+
+FSNetRecvSlabPool::~FSNetRecvSlabPool()
+{
+	FScopeLock lockPool(&poolCriticalSection);
+	for (int32 i = 0; i < slabPool.Num(); ++i)
+	{
+		delete slabPool[i];
+	}
+	slabPool.Empty();
+}
+
+FSNetRecvSlab * FSNetRecvSlabPool::Alloc()
+{
+	FSNetRecvSlab* slab = nullptr;
+	{
+		FScopeLock lockPool(&poolCriticalSection);
+		if (slabPool.Num() > 0)
+		{
+			slab = slabPool.Pop(false);
+		}
+	}
+
+	if (nullptr == slab)
+	{
+		slab = new FSNetRecvSlab(this, SlabSize);
+	}
+
+	// reference for the caller
+	slab->RefCount.Set(1);
+	return slab;
+}
+
+int32 FSNetRecvSlabPool::Num()
+{
+	return slabPool.Num();
+}
+
+int32 FSNetRecvSlabPool::GetSlabSize() const
+{
+	return SlabSize;
+}
+
+void FSNetRecvSlabPool::Dealloc(FSNetRecvSlab * InSlab)
+{
+	if (nullptr == InSlab)
+		return;
+
+	{
+		FScopeLock lockPool(&poolCriticalSection);
+		if (slabPool.Num() < Maxnum)
+		{
+			slabPool.Push(InSlab);
+			return;
+		}
+	}
+
+	// pool is full
+	delete InSlab;
+}
@@ -0,0 +1,95 @@
+// Copyright (c) 2013-2019 7Mersenne All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/ThreadSafeCounter.h"
+
+/*
+* Size of one receive slab
+* connection thread recv at most one slab per Recv call
+*/
+#ifndef SERVO_PROTOCOL_RECV_SLAB_SIZE
+#define SERVO_PROTOCOL_RECV_SLAB_SIZE (64 * 1024)
+#endif // !SERVO_PROTOCOL_RECV_SLAB_SIZE
+
+/*
+* Max count of free slabs kept in the slab pool
+* released slabs over this count will be deleted
+*/
+#ifndef SERVO_PROTOCOL_RECV_SLAB_POOL_MAX
+#define SERVO_PROTOCOL_RECV_SLAB_POOL_MAX 64
+#endif // !SERVO_PROTOCOL_RECV_SLAB_POOL_MAX
+
+class FSNetRecvSlabPool;
+
+/**
+ * receive slab
+ * connection thread recv into a slab, packet bodies are views into the slab.
+ * every view holds one reference, the reader holds one while parsing.
+ * the slab goes back to its pool when the last reference is released.
+ */
+class SEPTEMSERVO_API FSNetRecvSlab
+{
+public:
+	FSNetRecvSlab(FSNetRecvSlabPool* InOwner, int32 InCapacity);
+	~FSNetRecvSlab();
+
+	// thread safe
+	void AddRef();
+	// thread safe; recycle to owner pool when refcount == 0
+	void Release();
+
+	FORCEINLINE uint8* GetData()
+	{
+		return Data;
+	}
+
+	FORCEINLINE int32 GetCapacity() const
+	{
+		return Capacity;
+	}
+
+	FORCEINLINE int32 GetRefCount() const
+	{
+		return RefCount.GetValue();
+	}
+
+private:
+	friend class FSNetRecvSlabPool;
+
+	uint8* Data;
+	int32 Capacity;
+	FThreadSafeCounter RefCount;
+	FSNetRecvSlabPool* Owner;
+};
+
+/**
+ * pool of receive slabs
+ * thread safe
+ */
+class SEPTEMSERVO_API FSNetRecvSlabPool
+{
+public:
+	FSNetRecvSlabPool(int32 InSlabSize = SERVO_PROTOCOL_RECV_SLAB_SIZE, int32 InMaxnum = SERVO_PROTOCOL_RECV_SLAB_POOL_MAX);
+	~FSNetRecvSlabPool();
+
+	// thread safe; the returned slab holds one reference for the caller
+	FSNetRecvSlab* Alloc();
+
+	// not thread safe
+	int32 Num();
+	int32 GetSlabSize() const;
+
+private:
+	friend class FSNetRecvSlab;
+
+	// thread safe; called by slab when the last reference is released
+	void Dealloc(FSNetRecvSlab* InSlab);
+
+	// stack of free slabs
+	TArray<FSNetRecvSlab*> slabPool;
+	FCriticalSection poolCriticalSection;
+	int32 SlabSize;
+	int32 Maxnum;
+};
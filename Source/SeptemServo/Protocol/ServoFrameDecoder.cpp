@@ -0,0 +1,203 @@
+// Copyright (c) 2013-2019 7Mersenne All Rights Reserved.
+
+#include "ServoFrameDecoder.h"
+
+using namespace Septem;
+
+static const int32 ServoHeadSize = sizeof(FSNetBufferHead);
+
+FServoFrameDecoder::FServoFrameDecoder(int32 InSyncword)
+	: State(EState::SeekSyncword)
+	, Syncword(InSyncword)
+	, SyncMatched(0)
+	, FrameSize(-1)
+	, FootIndex(0)
+{
+	FMemory::Memcpy(SyncBytes, &Syncword, sizeof(int32));
+}
+
+int32 FServoFrameDecoder::Decode(uint8 * Data, int32 Length, FSNetPacket & OutPacket, bool & bOutReady, FSNetRecvSlab * InSlab)
+{
+	FServoFrame frame;
+	const int32 consumed = NextFrame(Data, Length, frame, bOutReady);
+	if (bOutReady)
+	{
+		// carried frame is reused by decoder, so body must be copied
+		OutPacket.ReUseFrame(frame.Data, frame.Size, frame.bCarried ? nullptr : InSlab);
+	}
+	return consumed;
+}
+
+int32 FServoFrameDecoder::NextFrame(uint8 * Data, int32 Length, FServoFrame & OutFrame, bool & bOutReady)
+{
+	bOutReady = false;
+	int32 index = 0;
+
+	while (index < Length)
+	{
+		if (EState::SeekSyncword == State)
+		{
+			if (SyncMatched > 0)
+			{
+				// continue the syncword split by last recv
+				if (Data[index] == SyncBytes[SyncMatched])
+				{
+					++index;
+					if (4 == ++SyncMatched)
+					{
+						SyncMatched = 0;
+						Pending.Reset();
+						Pending.Append(SyncBytes, 4);
+						State = EState::ReadHead;
+					}
+					continue;
+				}
+				// mismatch, seek again from this byte
+				SyncMatched = 0;
+			}
+
+			// 1. find syncword for head
+			const int32 found = BufferBufferSyncword(Data + index, Length - index, Syncword);
+			if (-1 == found)
+			{
+				SyncMatched = MatchSyncwordPrefix(Data + index, Length - index);
+				return Length;
+			}
+			index += found;
+
+			// 2. whole frame inside this buffer: read in place
+			const int32 rest = Length - index;
+			if (rest >= ServoHeadSize)
+			{
+				FSNetBufferHead head;
+				FMemory::Memcpy(&head, Data + index, ServoHeadSize);
+				const int32 frameSize = FSNetPacket::GetFrameSize(head);
+				if (frameSize < 0)
+				{
+					// illegal head, false syncword
+					++index;
+					continue;
+				}
+
+				if (rest >= frameSize)
+				{
+					OutFrame.Data = Data + index;
+					OutFrame.Size = frameSize;
+					OutFrame.bCarried = false;
+					bOutReady = true;
+					return index + frameSize;
+				}
+			}
+
+			// 3. frame is split by recv, carry it in pending
+			Pending.Reset();
+			FrameSize = -1;
+			State = EState::ReadHead;
+			continue;
+		}
+
+		// ReadHead, ReadBody, ReadFoot: fill pending up to head or whole frame
+		const int32 target = FrameSize < 0 ? ServoHeadSize : FrameSize;
+		const int32 copySize = FMath::Min(target - Pending.Num(), Length - index);
+		Pending.Append(Data + index, copySize);
+		index += copySize;
+
+		if (Pending.Num() < target)
+		{
+			// wait for next recv
+			UpdateReadState();
+			break;
+		}
+
+		if (FrameSize < 0)
+		{
+			// head complete
+			FSNetBufferHead head;
+			FMemory::Memcpy(&head, Pending.GetData(), ServoHeadSize);
+			FrameSize = FSNetPacket::GetFrameSize(head);
+			if (FrameSize < 0)
+			{
+				ResyncPending();
+			}
+			else {
+				FootIndex = ServoHeadSize + (0 != head.uid ? head.size : 0);
+				UpdateReadState();
+			}
+			continue;
+		}
+
+		// frame complete, keep it until the next carried frame completes
+		Exchange(Pending, Completed);
+		OutFrame.Data = Completed.GetData();
+		OutFrame.Size = FrameSize;
+		OutFrame.bCarried = true;
+		bOutReady = true;
+		Reset();
+		return index;
+	}
+
+	return index;
+}
+
+void FServoFrameDecoder::Reset()
+{
+	State = EState::SeekSyncword;
+	SyncMatched = 0;
+	FrameSize = -1;
+	Pending.Reset();
+}
+
+FServoFrameDecoder::EState FServoFrameDecoder::GetState() const
+{
+	return State;
+}
+
+int32 FServoFrameDecoder::GetPendingNum() const
+{
+	return Pending.Num();
+}
+
+int32 FServoFrameDecoder::MatchSyncwordPrefix(const uint8 * Data, int32 Length) const
+{
+	for (int32 k = FMath::Min(3, Length); k > 0; --k)
+	{
+		if (FMemory::Memcmp(Data + Length - k, SyncBytes, k) == 0)
+		{
+			return k;
+		}
+	}
+	return 0;
+}
+
+void FServoFrameDecoder::ResyncPending()
+{
+	FrameSize = -1;
+
+	const int32 found = BufferBufferSyncword(Pending.GetData() + 1, Pending.Num() - 1, Syncword);
+	if (-1 == found)
+	{
+		SyncMatched = MatchSyncwordPrefix(Pending.GetData() + 1, Pending.Num() - 1);
+		Pending.Reset();
+		State = EState::SeekSyncword;
+		return;
+	}
+
+	// pending begins with the next syncword and is shorter than head
+	Pending.RemoveAt(0, found + 1, false);
+	State = EState::ReadHead;
+}
+
+void FServoFrameDecoder::UpdateReadState()
+{
+	if (FrameSize < 0)
+	{
+		State = EState::ReadHead;
+	}
+	else if (Pending.Num() < FootIndex)
+	{
+		State = EState::ReadBody;
+	}
+	else {
+		State = EState::ReadFoot;
+	}
+}
@@ -0,0 +1,96 @@
+// Copyright (c) 2013-2019 7Mersenne All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ServoProtocol.h"
+
+/**
+ * one whole frame found by decoder
+ */
+struct SEPTEMSERVO_API FServoFrame
+{
+	// begin with syncword
+	uint8* Data;
+	// head + body + foot
+	int32 Size;
+	// true: frame was split by recv and lives in decoder memory
+	// false: frame is inside the buffer passed to decoder
+	bool bCarried;
+
+	FServoFrame()
+		: Data(nullptr)
+		, Size(0)
+		, bCarried(false)
+	{
+	}
+};
+
+/**
+ * streaming frame decoder, one per connection
+ * keeps the bytes of a frame split by recv until the frame completes.
+ * a frame inside one recv buffer is read in place (body view when slab given),
+ * only frames split by recv are carried in the pending buffer.
+ * not thread safe, owned by the connection reader
+ */
+class SEPTEMSERVO_API FServoFrameDecoder
+{
+public:
+	enum class EState : uint8
+	{
+		SeekSyncword,
+		ReadHead,
+		ReadBody,
+		ReadFoot
+	};
+
+	FServoFrameDecoder(int32 InSyncword = DEFAULT_SYNCWORD_INT32);
+
+	/**
+	 * Decode bytes until one packet completes or Data is used up.
+	 * @param Data			recv buffer
+	 * @param Length		bytes left in recv buffer
+	 * @param OutPacket		packet to fill, valid only when bOutReady
+	 * @param bOutReady		true if OutPacket has been filled with a whole frame
+	 * @param InSlab		slab which owns Data, nullptr to copy body
+	 * @return bytes consumed from Data
+	 */
+	int32 Decode(uint8* Data, int32 Length, FSNetPacket& OutPacket, bool& bOutReady, FSNetRecvSlab* InSlab = nullptr);
+
+	/**
+	 * Find the bounds of the next whole frame without reading it.
+	 * a carried frame stays valid until the next carried frame completes,
+	 * at most one carried frame completes per recv buffer.
+	 * @param OutFrame		valid only when bOutReady
+	 * @return bytes consumed from Data
+	 */
+	int32 NextFrame(uint8* Data, int32 Length, FServoFrame& OutFrame, bool& bOutReady);
+
+	// drop pending bytes and seek syncword again
+	void Reset();
+
+	EState GetState() const;
+	// bytes of the split frame carried from last recv
+	int32 GetPendingNum() const;
+
+private:
+	// count of syncword bytes at the end of buffer, syncword may be split by recv
+	int32 MatchSyncwordPrefix(const uint8* Data, int32 Length) const;
+	// pending head is illegal: drop the false syncword and seek again in pending bytes
+	void ResyncPending();
+	void UpdateReadState();
+
+	EState State;
+	int32 Syncword;
+	uint8 SyncBytes[4];
+	// syncword bytes matched at the end of last recv
+	int32 SyncMatched;
+	// frame size of pending head, -1 before head complete
+	int32 FrameSize;
+	// foot begins at this index of pending
+	int32 FootIndex;
+	// bytes of the frame split by recv, begin with syncword
+	TArray<uint8> Pending;
+	// last carried frame completed, swapped with pending
+	TArray<uint8> Completed;
+};
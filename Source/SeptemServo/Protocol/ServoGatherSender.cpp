@@ -0,0 +1,247 @@
+// Copyright (c) 2013-2019 7Mersenne All Rights Reserved.
+
+#include "ServoGatherSender.h"
+
+#if SERVO_PROTOCOL_GATHER_SEND
+#include "ServoNativeSocket.h"
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <errno.h>
+#endif // SERVO_PROTOCOL_GATHER_SEND
+
+using namespace Septem;
+
+/**
+ * bytes of packet on wire, begin at offset
+ */
+struct FServoSendSegment
+{
+	const uint8* Data;
+	int32 Size;
+};
+
+// head, body and foot of packet left after InOffset bytes
+static int32 GetPacketSegments(const FSNetPacket& InPacket, int32 InOffset, FServoSendSegment OutSegments[3])
+{
+	const int32 headSize = sizeof(FSNetBufferHead);
+	const int32 bodySize = 0 != InPacket.Head.uid ? InPacket.Head.size : 0;
+	const int32 footSize = FSNetPacket::GetFrameSize(InPacket.Head) - headSize - bodySize;
+
+	const uint8* data[3] = { (const uint8*)&InPacket.Head, InPacket.Body.bufferPtr, (const uint8*)&InPacket.Foot };
+	const int32 size[3] = { headSize, bodySize, footSize };
+
+	int32 num = 0;
+	for (int32 i = 0; i < 3; ++i)
+	{
+		if (InOffset >= size[i])
+		{
+			InOffset -= size[i];
+			continue;
+		}
+		OutSegments[num].Data = data[i] + InOffset;
+		OutSegments[num].Size = size[i] - InOffset;
+		InOffset = 0;
+		++num;
+	}
+	return num;
+}
+
+FServoGatherSender::FServoGatherSender(FSocket * InSocket)
+	: Socket(InSocket)
+	, QueueIndex(0)
+	, SentOffset(0)
+{
+}
+
+void FServoGatherSender::SetSocket(FSocket * InSocket)
+{
+	Socket = InSocket;
+}
+
+void FServoGatherSender::Enqueue(const FServoPacketRef& InPacket)
+{
+	if (!InPacket.IsValid())
+		return;
+
+	const FSNetBufferHead& head = InPacket->Head;
+	if (FSNetPacket::GetFrameSize(head) < 0 || head.IsCompressed()
+		|| (0 != head.uid && (head.size != InPacket->Body.length || (head.size > 0 && nullptr == InPacket->Body.bufferPtr))))
+	{
+		UE_LOG(LogTemp, Warning, TEXT("FServoGatherSender: drop packet uid %d, head doesn't match body"), head.uid);
+		return;
+	}
+
+	Queue.Add(InPacket);
+}
+
+bool FServoGatherSender::Flush(int32 & OutBytesSent)
+{
+	OutBytesSent = 0;
+	if (nullptr == Socket)
+		return false;
+
+	while (QueueIndex < Queue.Num())
+	{
+		const int32 sent = SendBatch();
+		if (sent < 0)
+		{
+			return false;
+		}
+		if (0 == sent)
+		{
+			// would block, try again next flush
+			break;
+		}
+		OutBytesSent += sent;
+		Advance(sent);
+	}
+
+	Compact();
+	return true;
+}
+
+void FServoGatherSender::Complete(int32 InBytes)
+{
+	Advance(InBytes);
+	Compact();
+}
+
+int32 FServoGatherSender::NumQueued() const
+{
+	return Queue.Num() - QueueIndex;
+}
+
+void FServoGatherSender::Reset()
+{
+	Queue.Reset();
+	QueueIndex = 0;
+	SentOffset = 0;
+}
+
+void FServoGatherSender::Advance(int32 InBytes)
+{
+	while (InBytes > 0 && QueueIndex < Queue.Num())
+	{
+		const int32 rest = FSNetPacket::GetFrameSize(Queue[QueueIndex]->Head) - SentOffset;
+		if (InBytes < rest)
+		{
+			SentOffset += InBytes;
+			return;
+		}
+
+		InBytes -= rest;
+		// release the packet as soon as it is on wire
+		Queue[QueueIndex].Reset();
+		++QueueIndex;
+		SentOffset = 0;
+	}
+}
+
+void FServoGatherSender::Compact()
+{
+	if (QueueIndex >= Queue.Num())
+	{
+		Queue.Reset();
+		QueueIndex = 0;
+		SentOffset = 0;
+	}
+	else if (QueueIndex * 2 >= Queue.Num())
+	{
+		// most packets are sent, compact the queue
+		Queue.RemoveAt(0, QueueIndex, false);
+		QueueIndex = 0;
+	}
+}
+
+#if SERVO_PROTOCOL_GATHER_SEND
+
+int32 FServoGatherSender::PrepareBatch(struct iovec * OutIovecs)
+{
+	int32 iovNum = 0;
+
+	const int32 lastIndex = FMath::Min(Queue.Num(), QueueIndex + SERVO_PROTOCOL_SEND_BATCH_MAX);
+	for (int32 i = QueueIndex; i < lastIndex; ++i)
+	{
+		FServoSendSegment segments[3];
+		const int32 num = GetPacketSegments(*Queue[i], i == QueueIndex ? SentOffset : 0, segments);
+		for (int32 j = 0; j < num; ++j)
+		{
+			OutIovecs[iovNum].iov_base = (void*)segments[j].Data;
+			OutIovecs[iovNum].iov_len = segments[j].Size;
+			++iovNum;
+		}
+	}
+
+	return iovNum;
+}
+
+int32 FServoGatherSender::SendBatch()
+{
+	struct iovec iov[SERVO_PROTOCOL_SEND_BATCH_MAX * 3];
+	const int32 iovNum = PrepareBatch(iov);
+
+	struct msghdr msg;
+	FMemory::Memzero(&msg, sizeof(msg));
+	msg.msg_iov = iov;
+	msg.msg_iovlen = iovNum;
+
+	const int32 fd = GetNativeSocketHandle(Socket);
+#ifdef MSG_NOSIGNAL
+	const int32 flags = MSG_DONTWAIT | MSG_NOSIGNAL;
+#else
+	const int32 flags = MSG_DONTWAIT;
+#endif // MSG_NOSIGNAL
+
+	for (;;)
+	{
+		const ssize_t sent = sendmsg(fd, &msg, flags);
+		if (sent >= 0)
+		{
+			return (int32)sent;
+		}
+		if (EINTR == errno)
+		{
+			continue;
+		}
+		if (EAGAIN == errno || EWOULDBLOCK == errno)
+		{
+			return 0;
+		}
+		UE_LOG(LogTemp, Warning, TEXT("FServoGatherSender: sendmsg failed, errno %d"), errno);
+		return -1;
+	}
+}
+
+#else
+
+int32 FServoGatherSender::SendBatch()
+{
+	// no sendmsg: gather the batch into scratch, still one send per batch
+	Scratch.Reset();
+	const int32 lastIndex = FMath::Min(Queue.Num(), QueueIndex + SERVO_PROTOCOL_SEND_BATCH_MAX);
+	for (int32 i = QueueIndex; i < lastIndex; ++i)
+	{
+		FServoSendSegment segments[3];
+		const int32 num = GetPacketSegments(*Queue[i], i == QueueIndex ? SentOffset : 0, segments);
+		for (int32 j = 0; j < num; ++j)
+		{
+			const int32 index = Scratch.AddUninitialized(segments[j].Size);
+			FMemory::Memcpy(Scratch.GetData() + index, segments[j].Data, segments[j].Size);
+		}
+	}
+
+	int32 bytesSent = 0;
+	if (!Socket->Send(Scratch.GetData(), Scratch.Num(), bytesSent))
+	{
+		const ESocketErrors error = ISocketSubsystem::Get(PLATFORM_SOCKETSUBSYSTEM)->GetLastErrorCode();
+		if (SE_EWOULDBLOCK == error || SE_EINTR == error)
+		{
+			return 0;
+		}
+		UE_LOG(LogTemp, Warning, TEXT("FServoGatherSender: send failed, error %d"), (int32)error);
+		return -1;
+	}
+	return bytesSent;
+}
+
+#endif // SERVO_PROTOCOL_GATHER_SEND
@@ -0,0 +1,102 @@
+// Copyright (c) 2013-2019 7Mersenne All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Networking.h"
+#include "ServoProtocol.h"
+
+/*
+* Gather send with sendmsg on posix sockets.
+* other platforms copy the batch into one buffer and send it with one FSocket::Send
+*/
+#ifndef SERVO_PROTOCOL_GATHER_SEND
+#define SERVO_PROTOCOL_GATHER_SEND (PLATFORM_LINUX || PLATFORM_MAC)
+#endif // !SERVO_PROTOCOL_GATHER_SEND
+
+/*
+* Max packets in one send call, 3 iovecs each (head, body, foot)
+* keep 3 * max under IOV_MAX (1024 on linux)
+*/
+#ifndef SERVO_PROTOCOL_SEND_BATCH_MAX
+#define SERVO_PROTOCOL_SEND_BATCH_MAX 64
+#endif // !SERVO_PROTOCOL_SEND_BATCH_MAX
+
+/************************************************************/
+/*
+		Help
+		// packets must be sealed before queued: packet->UpdateIntegrity();
+		FServoGatherSender sender(socket);
+		sender.Enqueue(packetA);
+		sender.Enqueue(packetB);
+		int32 bytesSent = 0;
+		if (!sender.Flush(bytesSent))
+		{
+			// socket error
+		}
+		// packets not sent yet (socket would block) stay queued for next Flush
+*/
+/************************************************************/
+
+/**
+ * scatter-gather sender, one per connection
+ * head, body and foot of queued packets are handed to the socket in place,
+ * without concatenation copy. a packet is held until all its bytes are sent.
+ * not thread safe, owned by the connection writer
+ */
+class SEPTEMSERVO_API FServoGatherSender
+{
+public:
+	FServoGatherSender(FSocket* InSocket = nullptr);
+
+	void SetSocket(FSocket* InSocket);
+
+	// queue sealed packet, raw body only (not compressed)
+	void Enqueue(const FServoPacketRef& InPacket);
+
+	/**
+	 * Send queued packets until queue is empty or socket would block.
+	 * @param OutBytesSent	bytes sent by this call
+	 * @return false when socket error
+	 */
+	bool Flush(int32& OutBytesSent);
+
+	// packets not fully sent
+	int32 NumQueued() const;
+
+	// drop all queued packets
+	void Reset();
+
+#if SERVO_PROTOCOL_GATHER_SEND
+	/**
+	 * Fill iovecs of the next batch for an async send (io_uring), nothing is sent.
+	 * queued packets are held until Complete reports the bytes sent
+	 * @param OutIovecs		room for SERVO_PROTOCOL_SEND_BATCH_MAX * 3 iovecs
+	 * @return iovec count, 0 if queue is empty
+	 */
+	int32 PrepareBatch(struct iovec* OutIovecs);
+#endif // SERVO_PROTOCOL_GATHER_SEND
+
+	// async send of a prepared batch completed with InBytes on wire
+	void Complete(int32 InBytes);
+
+private:
+	// drop InBytes sent from the front of queue
+	void Advance(int32 InBytes);
+	// recycle the slots of sent packets
+	void Compact();
+
+	// send up to SERVO_PROTOCOL_SEND_BATCH_MAX packets with one call, -1 on error, 0 if would block
+	int32 SendBatch();
+
+	FSocket* Socket;
+	TArray<FServoPacketRef> Queue;
+	// first packet not fully sent
+	int32 QueueIndex;
+	// bytes of Queue[QueueIndex] already sent
+	int32 SentOffset;
+#if !SERVO_PROTOCOL_GATHER_SEND
+	// batch is copied here on platforms without sendmsg
+	TArray<uint8> Scratch;
+#endif // !SERVO_PROTOCOL_GATHER_SEND
+};
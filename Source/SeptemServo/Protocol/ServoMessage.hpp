@@ -0,0 +1,172 @@
+// Copyright (c) 2013-2019 7Mersenne All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ServoProtocol.h"
+
+/************************************************************/
+/*
+		Help
+		// 1. declare packed body layout and bind it to uid
+		#pragma pack(push, 1)
+		struct FMoveLayout
+		{
+			int32 actor;
+			float x, y, z;
+		};
+		#pragma pack(pop)
+		typedef TServoMessage<100, FMoveLayout> FMoveMessage;
+
+		// 2. read fields straight from body bytes
+		if (const FMoveLayout* move = FMoveMessage::View(*packet))
+		{
+			float x = move->x;
+		}
+
+		// 3. or dispatch by uid to Handler.OnMessage(const FMoveLayout&, FSNetPacket&)
+		TServoMessageDispatcher<FMyHandler, FMoveMessage, FChatMessage>::Dispatch(handler, *packet);
+*/
+/************************************************************/
+
+/**
+ * compile-time message type
+ * Layout is a packed POD body, declared in #pragma pack(push, 1)
+ * body size is validated once in View, then fields are plain loads
+ */
+template<uint16 InUid, typename InLayout>
+struct TServoMessage
+{
+	static_assert(InUid != 0, "uid 0 is heartbeat, it has no body");
+	static_assert(TIsPODType<InLayout>::Value, "message layout must be POD");
+	static_assert(alignof(InLayout) == 1, "message layout must be declared in #pragma pack(push, 1)");
+
+	typedef InLayout FLayout;
+
+	enum { Uid = InUid };
+	enum { Size = sizeof(InLayout) };
+
+	// true if packet is this message and body size matches layout
+	static FORCEINLINE bool Match(const FSNetPacket& InPacket)
+	{
+		return InPacket.Head.uid == InUid && InPacket.Body.length == Size && InPacket.Body.bufferPtr != nullptr;
+	}
+
+	// typed view over body bytes, nullptr when packet doesn't match
+	// the view lives as long as the packet body
+	static FORCEINLINE const FLayout* View(const FSNetPacket& InPacket)
+	{
+		return Match(InPacket) ? reinterpret_cast<const FLayout*>(InPacket.Body.bufferPtr) : nullptr;
+	}
+};
+
+/**
+ * dispatch packet by uid to Handler.OnMessage(const Layout&, FSNetPacket&)
+ * table of uid -> handler thunk is built and sorted by uid at compile time,
+ * Dispatch is a binary search over it. an empty message list dispatches nothing
+ */
+template<typename THandler, typename... TMessages>
+class TServoMessageDispatcher
+{
+public:
+	enum { Num = sizeof...(TMessages) };
+
+	/**
+	 * @return false if no message matches Head.uid or body size doesn't match layout
+	 */
+	static bool Dispatch(THandler& Handler, FSNetPacket& InPacket)
+	{
+		const int32 index = Find(InPacket.Head.uid);
+		return index >= 0 ? Table.Entries[index].Thunk(Handler, InPacket) : false;
+	}
+
+	// true if uid is registered in this dispatcher
+	static bool Contains(uint16 InUid)
+	{
+		return Find(InUid) >= 0;
+	}
+
+private:
+	typedef bool(*FThunk)(THandler&, FSNetPacket&);
+
+	struct FEntry
+	{
+		uint16 Uid;
+		FThunk Thunk;
+	};
+
+	// one spare entry keeps the array legal when the message list is empty
+	struct FTable
+	{
+		FEntry Entries[Num + 1];
+	};
+
+	template<typename TMessage>
+	static bool Thunk(THandler& Handler, FSNetPacket& InPacket)
+	{
+		const typename TMessage::FLayout* view = TMessage::View(InPacket);
+		if (nullptr == view)
+		{
+			return false;
+		}
+		Handler.OnMessage(*view, InPacket);
+		return true;
+	}
+
+	// entries sorted by uid, the spare entry stays last
+	static constexpr FTable MakeTable()
+	{
+		FTable table = { { { (uint16)TMessages::Uid, &TServoMessageDispatcher::template Thunk<TMessages> }..., { 0, nullptr } } };
+		for (int32 i = 1; i < Num; ++i)
+		{
+			const FEntry entry = table.Entries[i];
+			int32 j = i - 1;
+			for (; j >= 0 && table.Entries[j].Uid > entry.Uid; --j)
+			{
+				table.Entries[j + 1] = table.Entries[j];
+			}
+			table.Entries[j + 1] = entry;
+		}
+		return table;
+	}
+
+	static constexpr bool IsUnique()
+	{
+		const FTable table = MakeTable();
+		for (int32 i = 1; i < Num; ++i)
+		{
+			if (table.Entries[i - 1].Uid == table.Entries[i].Uid)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	static FORCEINLINE int32 Find(uint16 InUid)
+	{
+		static_assert(IsUnique(), "duplicated message uid in dispatcher");
+
+		int32 low = 0;
+		int32 high = Num;
+		while (low < high)
+		{
+			const int32 mid = (low + high) >> 1;
+			if (Table.Entries[mid].Uid < InUid)
+			{
+				low = mid + 1;
+			}
+			else {
+				high = mid;
+			}
+		}
+		return low < Num && Table.Entries[low].Uid == InUid ? low : -1;
+	}
+
+	// constant initialized, no sort at runtime
+	static const FTable Table;
+};
+
+template<typename THandler, typename... TMessages>
+const typename TServoMessageDispatcher<THandler, TMessages...>::FTable TServoMessageDispatcher<THandler, TMessages...>::Table =
+	TServoMessageDispatcher<THandler, TMessages...>::MakeTable();
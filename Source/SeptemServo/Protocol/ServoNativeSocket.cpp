@@ -0,0 +1,33 @@
+// Copyright (c) 2013-2019 7Mersenne All Rights Reserved.
+
+#include "ServoNativeSocket.h"
+
+#include "SocketSubsystem.h"
+
+#if PLATFORM_HAS_BSD_SOCKETS
+#include "BSDSockets/SocketsBSD.h"
+#include "BSDSockets/SocketSubsystemBSD.h"
+#endif // PLATFORM_HAS_BSD_SOCKETS
+
+int32 GetNativeSocketHandle(FSocket* InSocket)
+{
+#if PLATFORM_HAS_BSD_SOCKETS
+	if (InSocket)
+	{
+		return (int32)static_cast<FSocketBSD*>(InSocket)->GetNativeSocket();
+	}
+#endif // PLATFORM_HAS_BSD_SOCKETS
+	return -1;
+}
+
+FSocket* CreateSocketFromNativeHandle(int32 InHandle, const FString& InDescription)
+{
+#if PLATFORM_HAS_BSD_SOCKETS
+	FSocketSubsystemBSD* socketSubsystem = static_cast<FSocketSubsystemBSD*>(ISocketSubsystem::Get(PLATFORM_SOCKETSUBSYSTEM));
+	if (socketSubsystem)
+	{
+		return socketSubsystem->InternalBSDSocketFactory(InHandle, SOCKTYPE_Streaming, InDescription);
+	}
+#endif // PLATFORM_HAS_BSD_SOCKETS
+	return nullptr;
+}
@@ -0,0 +1,19 @@
+// Copyright (c) 2013-2019 7Mersenne All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class FSocket;
+
+/*
+* Native handles of engine BSD sockets, for syscalls the FSocket api doesn't have
+* (setsockopt, accept4, epoll, io_uring, sendmsg).
+* only ServoNativeSocket.cpp includes the private BSD socket headers of the engine
+*/
+
+// native handle of a BSD socket; -1 when socket is null or the platform has no BSD sockets
+SEPTEMSERVO_API int32 GetNativeSocketHandle(FSocket* InSocket);
+
+// wrap a native stream socket (e.g. from accept4) into FSocket; nullptr on failure, the caller closes the handle then
+SEPTEMSERVO_API FSocket* CreateSocketFromNativeHandle(int32 InHandle, const FString& InDescription);
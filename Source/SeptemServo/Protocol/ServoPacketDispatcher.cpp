@@ -0,0 +1,150 @@
+// Copyright (c) 2013-2019 7Mersenne All Rights Reserved.
+
+#include "ServoPacketDispatcher.h"
+
+FServoPacketDispatcher::FServoPacketDispatcher(FServoPacketHandler InHandler, int32 InMaxPerFrame, int32 InBudgetMicroseconds)
+	: Handler(MoveTemp(InHandler))
+	, MaxPerFrame(InMaxPerFrame)
+	, BudgetMicroseconds(InBudgetMicroseconds)
+	, PendingIndex(0)
+	, LastDrainNum(0)
+	, OverBudgetFrames(0)
+{
+	Pending.Reserve(SERVO_PROTOCOL_DISPATCH_CHUNK);
+	ResetHistogram();
+}
+
+FServoPacketDispatcher::~FServoPacketDispatcher()
+{
+	// carried packets are recycled with their refs
+	Pending.Empty();
+}
+
+void FServoPacketDispatcher::Tick(float DeltaTime)
+{
+	const int32 maxNum = MaxPerFrame > 0 ? MaxPerFrame : MAX_int32;
+	const uint64 startCycles = FPlatformTime::Cycles64();
+	const uint64 budgetCycles = BudgetMicroseconds > 0 ? (uint64)(BudgetMicroseconds / (FPlatformTime::GetSecondsPerCycle64() * 1000000.0)) : MAX_uint64;
+
+	FServoProtocol* protocol = FServoProtocol::Get();
+	int32 drainNum = 0;
+	bool bOverBudget = false;
+	while (drainNum < maxNum)
+	{
+		if (PendingIndex == Pending.Num())
+		{
+			// pop no more than the count limit needs, so only time budget leaves packets carried
+			Pending.Reset();
+			PendingIndex = 0;
+			if (0 == protocol->PopBatch(Pending, FMath::Min(maxNum - drainNum, (int32)SERVO_PROTOCOL_DISPATCH_CHUNK)))
+			{
+				break;
+			}
+		}
+
+		FServoPacketRef& packet = Pending[PendingIndex++];
+		Handler(packet);
+		// recycle as soon as handled
+		packet.Reset();
+		++drainNum;
+
+		if (FPlatformTime::Cycles64() - startCycles >= budgetCycles)
+		{
+			bOverBudget = true;
+			break;
+		}
+	}
+
+	LastDrainNum = drainNum;
+	if (bOverBudget)
+	{
+		++OverBudgetFrames;
+	}
+	++Histogram[DrainBucket(drainNum)];
+}
+
+bool FServoPacketDispatcher::IsTickable() const
+{
+	return Handler ? true : false;
+}
+
+TStatId FServoPacketDispatcher::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(FServoPacketDispatcher, STATGROUP_Tickables);
+}
+
+void FServoPacketDispatcher::SetHandler(FServoPacketHandler InHandler)
+{
+	Handler = MoveTemp(InHandler);
+}
+
+void FServoPacketDispatcher::SetMaxPerFrame(int32 InMaxPerFrame)
+{
+	MaxPerFrame = InMaxPerFrame;
+}
+
+void FServoPacketDispatcher::SetBudgetMicroseconds(int32 InBudgetMicroseconds)
+{
+	BudgetMicroseconds = InBudgetMicroseconds;
+}
+
+int32 FServoPacketDispatcher::GetMaxPerFrame() const
+{
+	return MaxPerFrame;
+}
+
+int32 FServoPacketDispatcher::GetBudgetMicroseconds() const
+{
+	return BudgetMicroseconds;
+}
+
+int32 FServoPacketDispatcher::GetCarriedNum() const
+{
+	return Pending.Num() - PendingIndex;
+}
+
+int32 FServoPacketDispatcher::GetLastDrainNum() const
+{
+	return LastDrainNum;
+}
+
+int64 FServoPacketDispatcher::GetOverBudgetFrames() const
+{
+	return OverBudgetFrames;
+}
+
+void FServoPacketDispatcher::GetDrainHistogram(TArray<int64>& OutHistogram) const
+{
+	OutHistogram.Reset(SERVO_PROTOCOL_DISPATCH_HISTOGRAM_BUCKETS);
+	OutHistogram.Append(Histogram, SERVO_PROTOCOL_DISPATCH_HISTOGRAM_BUCKETS);
+}
+
+void FServoPacketDispatcher::ResetHistogram()
+{
+	FMemory::Memzero(Histogram, sizeof(Histogram));
+	OverBudgetFrames = 0;
+}
+
+void FServoPacketDispatcher::LogHistogram() const
+{
+	UE_LOG(LogTemp, Display, TEXT("FServoPacketDispatcher: max %d budget %dus over budget frames %lld carried %d"),
+		MaxPerFrame, BudgetMicroseconds, OverBudgetFrames, GetCarriedNum());
+	for (int32 i = 0; i < SERVO_PROTOCOL_DISPATCH_HISTOGRAM_BUCKETS; ++i)
+	{
+		if (Histogram[i] > 0)
+		{
+			const int32 low = 0 == i ? 0 : 1 << (i - 1);
+			UE_LOG(LogTemp, Display, TEXT("FServoPacketDispatcher: drain >= %d : %lld frames"), low, Histogram[i]);
+		}
+	}
+}
+
+int32 FServoPacketDispatcher::DrainBucket(int32 InDrainNum)
+{
+	if (InDrainNum <= 0)
+		return 0;
+
+	// bucket i holds [2^(i-1), 2^i)
+	const int32 bucket = (int32)FMath::FloorLog2((uint32)InDrainNum) + 1;
+	return FMath::Min(bucket, SERVO_PROTOCOL_DISPATCH_HISTOGRAM_BUCKETS - 1);
+}
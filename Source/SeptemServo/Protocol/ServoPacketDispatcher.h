@@ -0,0 +1,99 @@
+// Copyright (c) 2013-2019 7Mersenne All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Tickable.h"
+#include "ServoProtocol.h"
+
+/*
+* Packets popped from packet pool with one PopBatch by the dispatcher
+*/
+#ifndef SERVO_PROTOCOL_DISPATCH_CHUNK
+#define SERVO_PROTOCOL_DISPATCH_CHUNK 32
+#endif // !SERVO_PROTOCOL_DISPATCH_CHUNK
+
+/*
+* Buckets of drain histogram, bucket i counts frames which drained [2^(i-1), 2^i) packets
+* bucket 0 counts frames without packet, the last bucket holds all bigger frames
+*/
+#ifndef SERVO_PROTOCOL_DISPATCH_HISTOGRAM_BUCKETS
+#define SERVO_PROTOCOL_DISPATCH_HISTOGRAM_BUCKETS 16
+#endif // !SERVO_PROTOCOL_DISPATCH_HISTOGRAM_BUCKETS
+
+/************************************************************/
+/*
+		Help
+		// game thread drains packet pool each frame, at most 1000 packets or 2ms
+		FServoPacketDispatcher* dispatcher = new FServoPacketDispatcher([](const FServoPacketRef& InPacket)
+		{
+			// handle packet on game thread
+		}, 1000, 2000);
+
+		// tune the budget
+		dispatcher->LogHistogram();
+
+		// stop dispatch
+		delete dispatcher;
+*/
+/************************************************************/
+
+// called on game thread, once per packet in pop order
+typedef TFunction<void(const FServoPacketRef&)> FServoPacketHandler;
+
+/**
+ * drains FServoProtocol packet pool on game thread every frame
+ * stops at the count limit or the time budget of the frame,
+ * packets popped but not handled are carried to next frame in order.
+ * not thread safe, create/delete on game thread
+ */
+class SEPTEMSERVO_API FServoPacketDispatcher : public FTickableGameObject
+{
+public:
+	/**
+	 * @param InHandler				packet handler
+	 * @param InMaxPerFrame			max packets handled per frame, <= 0 means no limit
+	 * @param InBudgetMicroseconds	time budget per frame, <= 0 means no limit
+	 */
+	FServoPacketDispatcher(FServoPacketHandler InHandler, int32 InMaxPerFrame = 1024, int32 InBudgetMicroseconds = 2000);
+	virtual ~FServoPacketDispatcher();
+
+	// Begin FTickableGameObject interface.
+	virtual void Tick(float DeltaTime) override;
+	virtual bool IsTickable() const override;
+	virtual TStatId GetStatId() const override;
+	// End FTickableGameObject interface
+
+	void SetHandler(FServoPacketHandler InHandler);
+	void SetMaxPerFrame(int32 InMaxPerFrame);
+	void SetBudgetMicroseconds(int32 InBudgetMicroseconds);
+	int32 GetMaxPerFrame() const;
+	int32 GetBudgetMicroseconds() const;
+
+	// packets popped in former frames and not handled yet
+	int32 GetCarriedNum() const;
+	// packets handled in last frame
+	int32 GetLastDrainNum() const;
+	// frames which stopped at time budget
+	int64 GetOverBudgetFrames() const;
+
+	// frames counted per drain bucket, see SERVO_PROTOCOL_DISPATCH_HISTOGRAM_BUCKETS
+	void GetDrainHistogram(TArray<int64>& OutHistogram) const;
+	void ResetHistogram();
+	void LogHistogram() const;
+
+private:
+	static int32 DrainBucket(int32 InDrainNum);
+
+	FServoPacketHandler Handler;
+	int32 MaxPerFrame;
+	int32 BudgetMicroseconds;
+
+	// popped packets, handled from PendingIndex
+	TArray<FServoPacketRef> Pending;
+	int32 PendingIndex;
+
+	int32 LastDrainNum;
+	int64 OverBudgetFrames;
+	int64 Histogram[SERVO_PROTOCOL_DISPATCH_HISTOGRAM_BUCKETS];
+};
@@ -0,0 +1,188 @@
+// Copyright (c) 2013-2019 7Mersenne All Rights Reserved.
+
+#include "ServoPacketWriter.h"
+
+using namespace Septem;
+
+FServoPacketWriter::FServoPacketWriter(uint8 * InBuffer, int32 InCapacity)
+	: Buffer(InBuffer)
+	, Capacity(InCapacity)
+	, BufferArr(nullptr)
+	, Length(0)
+	, PacketIndex(0)
+	, BodyXOR(0)
+	, bWriting(false)
+	, bOverflow(false)
+{
+}
+
+FServoPacketWriter::FServoPacketWriter(TArray<uint8>& InBufferArr)
+	: Buffer(nullptr)
+	, Capacity(0)
+	, BufferArr(&InBufferArr)
+	, Length(InBufferArr.Num())
+	, PacketIndex(InBufferArr.Num())
+	, BodyXOR(0)
+	, bWriting(false)
+	, bOverflow(false)
+{
+}
+
+bool FServoPacketWriter::Begin(uint16 InUid, uint8 InVersion, uint32 InReserved, int32 InSyncword)
+{
+	if (bWriting)
+	{
+		// previous packet is not finished, drop it
+		DropPacket();
+	}
+
+	bOverflow = false;
+	PacketIndex = Length;
+	BodyXOR = 0;
+
+	FSNetBufferHead head;
+	head.syncword = InSyncword;
+	head.version = InVersion;
+	head.uid = InUid;
+	head.reserved = InReserved;
+
+	uint8* ptr = Reserve(sizeof(FSNetBufferHead));
+	if (nullptr == ptr)
+	{
+		return false;
+	}
+
+	FMemory::Memcpy(ptr, &head, sizeof(FSNetBufferHead));
+	bWriting = true;
+	return true;
+}
+
+bool FServoPacketWriter::Write(const void * InData, int32 InLength)
+{
+	if (!bWriting || InLength < 0)
+		return false;
+
+	uint8* ptr = Reserve(InLength);
+	if (nullptr == ptr)
+	{
+		return false;
+	}
+
+	// copy and xor in one pass
+	BodyXOR ^= BufferCopyXOR(ptr, (const uint8*)InData, InLength);
+	return true;
+}
+
+int32 FServoPacketWriter::Finish(uint64 InTimestamp)
+{
+	if (!bWriting)
+		return 0;
+
+	const int32 bodySize = Length - PacketIndex - sizeof(FSNetBufferHead);
+
+	// head is read back before foot reserve, array may move
+	FSNetBufferHead head;
+	FMemory::Memcpy(&head, GetData() + PacketIndex, sizeof(FSNetBufferHead));
+
+	if (head.uid == 0 && bodySize > 0)
+	{
+		// heartbeat has no body
+		DropPacket();
+		return 0;
+	}
+
+	FSNetBufferFoot foot(InTimestamp);
+	if (0 == InTimestamp)
+	{
+		foot.SetNow();
+	}
+
+	const int32 footSize = FSNetBufferFoot::MemSize(head.version);
+	uint8* footPtr = Reserve(footSize);
+	if (nullptr == footPtr)
+	{
+		return 0;
+	}
+
+	// fill head in place
+	head.size = bodySize;
+	head.fastcode = 0;
+	head.fastcode = head.XOR() ^ BodyXOR ^ foot.XOR();
+
+	uint8* packetPtr = GetData() + PacketIndex;
+	FMemory::Memcpy(packetPtr, &head, sizeof(FSNetBufferHead));
+
+	if (SERVO_PROTOCOL_VERSION_CRC32C == head.version)
+	{
+		// crc32c of head, body and foot before crc32c
+		uint32 crc = Crc32c(packetPtr, sizeof(FSNetBufferHead) + bodySize);
+		foot.crc32c = Crc32c((const uint8*)&foot, FSNetBufferFoot::MemSize(SERVO_PROTOCOL_VERSION_XOR), crc);
+	}
+	FMemory::Memcpy(footPtr, &foot, footSize);
+
+	bWriting = false;
+	return Length - PacketIndex;
+}
+
+int32 FServoPacketWriter::WritePacket(FSNetPacket & InPacket)
+{
+	if (!Begin(InPacket.Head.uid, InPacket.Head.version, InPacket.Head.reserved, InPacket.Head.syncword))
+	{
+		return 0;
+	}
+
+	if (InPacket.Head.uid != 0 && InPacket.Body.bufferPtr && !Write(InPacket.Body.bufferPtr, InPacket.Body.length))
+	{
+		return 0;
+	}
+
+	return Finish(InPacket.Foot.timestamp);
+}
+
+void FServoPacketWriter::Reset()
+{
+	Length = 0;
+	PacketIndex = 0;
+	BodyXOR = 0;
+	bWriting = false;
+	bOverflow = false;
+	if (BufferArr)
+	{
+		BufferArr->Reset();
+	}
+}
+
+uint8 * FServoPacketWriter::Reserve(int32 InLength)
+{
+	if (BufferArr)
+	{
+		// grow without zero fill, amortized by TArray slack; Num() == Length, dropped packets are cut
+		BufferArr->AddUninitialized(InLength);
+		uint8* ptr = BufferArr->GetData() + Length;
+		Length += InLength;
+		return ptr;
+	}
+
+	if (Length + InLength > Capacity)
+	{
+		// drop current packet
+		bOverflow = true;
+		DropPacket();
+		return nullptr;
+	}
+
+	uint8* ptr = Buffer + Length;
+	Length += InLength;
+	return ptr;
+}
+
+void FServoPacketWriter::DropPacket()
+{
+	Length = PacketIndex;
+	bWriting = false;
+	if (BufferArr)
+	{
+		// no bytes of the dropped packet are left for send
+		BufferArr->SetNum(PacketIndex, false);
+	}
+}
@@ -0,0 +1,96 @@
+// Copyright (c) 2013-2019 7Mersenne All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ServoProtocol.h"
+
+/************************************************************/
+/*
+		Help
+		// reuse one send buffer, no zero fill and no shrink
+		SendBuffer.Reset();
+		FServoPacketWriter writer(SendBuffer);
+		writer.Begin(100);
+		writer.Write(actorId);
+		writer.Write(location.X);
+		writer.Finish();
+		socket->Send(writer.GetData(), writer.Num(), bytesSend);
+*/
+/************************************************************/
+
+/**
+ * packet encoder writing in place
+ * head is reserved on Begin, body is streamed in with a running xor,
+ * size / timestamp / fastcode (crc32c) are filled on Finish.
+ * several packets can be appended to the same buffer for one send.
+ * not thread safe
+ */
+class SEPTEMSERVO_API FServoPacketWriter
+{
+public:
+	// write into caller buffer, never allocate
+	FServoPacketWriter(uint8* InBuffer, int32 InCapacity);
+	// append to array, grows without zero fill
+	explicit FServoPacketWriter(TArray<uint8>& InBufferArr);
+
+	// begin a packet at the end of buffer, reserve head
+	bool Begin(uint16 InUid, uint8 InVersion = SERVO_PROTOCOL_VERSION_XOR, uint32 InReserved = 0, int32 InSyncword = DEFAULT_SYNCWORD_INT32);
+
+	// append body bytes, heartbeat (uid == 0) has no body
+	bool Write(const void* InData, int32 InLength);
+
+	template<typename T>
+	FORCEINLINE bool Write(const T& InValue)
+	{
+		static_assert(TIsPODType<T>::Value, "only POD values can be written to packet body");
+		return Write(&InValue, sizeof(T));
+	}
+
+	/**
+	 * Write foot and fill head in place.
+	 * @param InTimestamp	0 means now
+	 * @return bytes of this packet, 0 when failed
+	 */
+	int32 Finish(uint64 InTimestamp = 0);
+
+	// encode a whole packet, body copied with running xor
+	int32 WritePacket(FSNetPacket& InPacket);
+
+	// drop all packets written
+	void Reset();
+
+	// bytes written, include all finished packets
+	FORCEINLINE int32 Num() const
+	{
+		return Length;
+	}
+
+	FORCEINLINE uint8* GetData()
+	{
+		return BufferArr ? BufferArr->GetData() : Buffer;
+	}
+
+	// true when caller buffer is too small, current packet is dropped
+	FORCEINLINE bool IsOverflow() const
+	{
+		return bOverflow;
+	}
+
+private:
+	// pointer to InLength bytes at the end of buffer, nullptr when buffer is full
+	uint8* Reserve(int32 InLength);
+	// cut the buffer back to the begin of current packet
+	void DropPacket();
+
+	uint8* Buffer;
+	int32 Capacity;
+	TArray<uint8>* BufferArr;
+
+	int32 Length;
+	// current packet begins at
+	int32 PacketIndex;
+	uint8 BodyXOR;
+	bool bWriting;
+	bool bOverflow;
+};
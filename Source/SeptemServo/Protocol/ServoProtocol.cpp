@@ -1,6 +1,8 @@
 // Copyright (c) 2013-2019 7Mersenne All Rights Reserved.
 
 #include "ServoProtocol.h"
+#include "ServoFrameDecoder.h"
+#include "ServoShards.h"
 
 #include "../SeptemAlgorithm/SeptemAlgorithm.h"
 using namespace Septem;
@@ -13,29 +15,108 @@ using namespace Septem;
 #include "Unix/UnixPlatformTime.h"
 #endif
 
+// lz totals, only touched by packets which run the codec
+static FThreadSafeCounter64 GCompressedNum;
+static FThreadSafeCounter64 GCompressedRawBytes;
+static FThreadSafeCounter64 GCompressedWireBytes;
+static FThreadSafeCounter64 GCompressSkippedNum;
+static FThreadSafeCounter64 GDecompressedNum;
+static FThreadSafeCounter64 GDecompressedRawBytes;
+static FThreadSafeCounter64 GDecompressedWireBytes;
+static FThreadSafeCounter64 GDecompressFailedNum;
+
 bool FSNetBufferBody::IsValid()
 {
 	return bufferPtr != nullptr;
 }
 
-bool FSNetBufferBody::MemRead(uint8 * Data, int32 BufferSize, int32 InLength)
+bool FSNetBufferBody::MemRead(uint8 * Data, int32 BufferSize, int32 InLength, uint8* OutXOR)
 {
 	if( BufferSize < InLength || InLength < 0)
 		return false;
 
-	if (length > 0)
+	if (bufferPtr || slab)
 	{
 		Reset();
 	}
 
 	length = InLength;
-	bufferPtr = new uint8[length];
-	
-	FMemory::Memcpy(bufferPtr, Data, length);
+	bufferPtr = (uint8*)FSizeClassAllocator::Get().Malloc(length);
+	if (nullptr == bufferPtr)
+	{
+		length = 0;
+		return false;
+	}
+
+	if (OutXOR)
+	{
+		// fused copy and xor, one traversal of the body
+		*OutXOR = BufferCopyXOR(bufferPtr, Data, length);
+	}
+	else {
+		FMemory::Memcpy(bufferPtr, Data, length);
+	}
+
+	return true;
+}
+
+bool FSNetBufferBody::MemView(uint8 * Data, int32 BufferSize, int32 InLength, FSNetRecvSlab * InSlab)
+{
+	if (BufferSize < InLength || InLength < 0 || nullptr == InSlab)
+		return false;
+
+	if (bufferPtr || slab)
+	{
+		Reset();
+	}
+
+	InSlab->AddRef();
+	slab = InSlab;
+	length = InLength;
+	bufferPtr = Data;
 
 	return true;
 }
 
+bool FSNetBufferBody::MemDecompress(uint8 * Data, int32 BufferSize, int32 InLength)
+{
+	const int32 RawSizeBytes = sizeof(uint32);
+	if (BufferSize < InLength || InLength <= RawSizeBytes)
+		return false;
+
+	uint32 rawSize = 0;
+	FMemory::Memcpy(&rawSize, Data, RawSizeBytes);
+	if (rawSize > SERVO_PROTOCOL_BODY_MAX)
+		return false;
+
+	if (bufferPtr || slab)
+	{
+		Reset();
+	}
+
+	length = (int32)rawSize;
+	bufferPtr = (uint8*)FSizeClassAllocator::Get().Malloc(length);
+	if (nullptr == bufferPtr)
+	{
+		length = 0;
+		return false;
+	}
+
+	// decompress into the pooled body buffer directly
+	if (LZDecompress(Data + RawSizeBytes, InLength - RawSizeBytes, bufferPtr, length) != length)
+	{
+		Reset();
+		return false;
+	}
+
+	return true;
+}
+
+bool FSNetBufferBody::IsView() const
+{
+	return slab != nullptr;
+}
+
 int32 FSNetBufferBody::MemSize()
 {
 	return length;
@@ -43,19 +124,25 @@ int32 FSNetBufferBody::MemSize()
 
 uint8 FSNetBufferBody::XOR()
 {
-	uint8 ret = 0;
-	for (int32 i = 0; i < length; ++i)
-		ret ^= bufferPtr[i];
-	return ret;
+	if (nullptr == bufferPtr)
+		return 0;
+	return BufferXOR(bufferPtr, length);
 }
 
 void FSNetBufferBody::Reset()
 {
-	if (bufferPtr)
+	if (slab)
 	{
-		delete bufferPtr;
+		// bufferPtr is owned by slab
+		bufferPtr = nullptr;
+		slab->Release();
+		slab = nullptr;
+	}
+	else if (bufferPtr)
+	{
+		// return to the size class of length
+		FSizeClassAllocator::Get().Free(bufferPtr, length);
 		bufferPtr = nullptr;
-		
 	}
 
 	length = 0;
@@ -85,14 +172,7 @@ int32 FSNetBufferHead::MemSize()
 
 uint8 FSNetBufferHead::XOR()
 {
-	uint8 ret = 0;
-	uint8 *ptr = (uint8*)this;
-	const int32 imax = sizeof(FSNetBufferHead);
-	for (int32 i = 0; i < imax; ++i)
-	{
-		ret ^= ptr[i];
-	}
-	return ret;
+	return BufferXOR((const uint8*)this, sizeof(FSNetBufferHead));
 }
 
 void FSNetBufferHead::Reset()
@@ -109,6 +189,11 @@ int32 FSNetBufferHead::SessionID()
 	return reserved & ((1 << 22) - 1);
 }
 
+bool FSNetBufferHead::IsCompressed() const
+{
+	return uid != 0 && (reserved & SERVO_PROTOCOL_FLAG_LZ) != 0;
+}
+
 bool FSNetPacket::IsValid()
 {
 	return bFastIntegrity;
@@ -116,25 +201,54 @@ bool FSNetPacket::IsValid()
 
 bool FSNetPacket::FastIntegrity(uint8 * DataPtr, int32 DataLength, uint8 fastcode)
 {
-	uint8 xor = 0;
-	for (int32 i = 0; i < DataLength; ++i)
-	{
-		xor ^= DataPtr[i];
-	}
-	return xor == fastcode;
+	return BufferXOR(DataPtr, DataLength) == fastcode;
 }
 
 bool FSNetPacket::CheckIntegrity()
 {
+	if (SERVO_PROTOCOL_VERSION_CRC32C == Head.version)
+	{
+		return bFastIntegrity = ComputeCrc32c() == Foot.crc32c;
+	}
+
+	// fastcode makes xor of all bytes zero
 	if (Head.uid == 0)
 	{
-		return bFastIntegrity = (Head.XOR() ^ Foot.XOR()) == Head.fastcode;
+		return bFastIntegrity = (Head.XOR() ^ Foot.XOR()) == 0;
 	}
-	return bFastIntegrity = (Head.XOR() ^ Body.XOR() ^ Foot.XOR()) == Head.fastcode;
+	return bFastIntegrity = (Head.XOR() ^ Body.XOR() ^ Foot.XOR()) == 0;
+}
+
+uint32 FSNetPacket::ComputeCrc32c()
+{
+	uint32 crc = Crc32c((const uint8*)&Head, FSNetBufferHead::MemSize());
+	if (Head.uid != 0 && Body.bufferPtr)
+	{
+		crc = Crc32c(Body.bufferPtr, Body.length, crc);
+	}
+	return Crc32c((const uint8*)&Foot, FSNetBufferFoot::MemSize(), crc);
+}
+
+void FSNetPacket::UpdateIntegrity()
+{
+	Head.fastcode = 0;
+	uint8 fastcode = Head.XOR() ^ Foot.XOR();
+	if (Head.uid != 0)
+	{
+		fastcode ^= Body.XOR();
+	}
+	Head.fastcode = fastcode;
+
+	if (SERVO_PROTOCOL_VERSION_CRC32C == Head.version)
+	{
+		Foot.crc32c = ComputeCrc32c();
+	}
+
+	bFastIntegrity = true;
 }
 
 FSNetPacket::FSNetPacket(uint8 * Data, int32 BufferSize, int32 & BytesRead, int32 InSyncword)
-	:sid(0), bFastIntegrity(false)
+	:sid(0), bFastIntegrity(false), RefCount(0)
 {
 	Head.syncword = InSyncword;
 	// 1. find syncword for head
@@ -156,6 +270,13 @@ FSNetPacket::FSNetPacket(uint8 * Data, int32 BufferSize, int32 & BytesRead, int3
 		return;
 	}
 
+	if (Head.IsCompressed())
+	{
+		// lz body is checked on wire bytes, then decompressed
+		ReadCompressedFrame(Data, BufferSize, index, BytesRead, nullptr);
+		return;
+	}
+
 	index += FSNetBufferHead::MemSize();
 	fastcode ^= Head.XOR();
 
@@ -169,29 +290,30 @@ FSNetPacket::FSNetPacket(uint8 * Data, int32 BufferSize, int32 & BytesRead, int3
 	if (0 != Head.uid)
 	{
 		// it is not a heart beat packet
-		if (!Body.MemRead(Data + index, BufferSize - index, Head.size))
+		uint8 bodyXOR = 0;
+		if (!Body.MemRead(Data + index, BufferSize - index, Head.size, &bodyXOR))
 		{
 			// failed to read from the rest buffer
 			BytesRead = BufferSize;
 			return;
 		}
 		index += Body.MemSize();
-		fastcode ^= Body.XOR();
+		fastcode ^= bodyXOR;
 	}
 
 	// 4. read foot
-	if (!Foot.MemRead(Data + index, BufferSize - index))
+	if (!Foot.MemRead(Data + index, BufferSize - index, Head.version))
 	{
 		// failed to read from the rest buffer
 		BytesRead = BufferSize;
 		return;
 	}
 
-	index += FSNetBufferFoot::MemSize();
+	index += FSNetBufferFoot::MemSize(Head.version);
 	fastcode ^= Foot.XOR();
 
 	BytesRead = index;
-	bFastIntegrity = 0 == fastcode;
+	bFastIntegrity = SERVO_PROTOCOL_VERSION_CRC32C == Head.version ? CheckIntegrity() : 0 == fastcode;
 
 	sid = Head.SessionID();
 
@@ -214,11 +336,11 @@ FSNetPacket * FSNetPacket::CreateHeartbeat(int32 InSyncword)
 	packet->Foot.SetNow();
 
 	// No need body xor
-	packet->Head.fastcode = packet->Head.XOR() ^ packet->Foot.XOR();
+	packet->UpdateIntegrity();
 	return packet;
 }
 
-void FSNetPacket::ReUse(uint8 * Data, int32 BufferSize, int32 & BytesRead, int32 InSyncword)
+void FSNetPacket::ReUse(uint8 * Data, int32 BufferSize, int32 & BytesRead, int32 InSyncword, FSNetRecvSlab* InSlab)
 {
 	sid = 0;
 	bFastIntegrity = false;
@@ -243,6 +365,13 @@ void FSNetPacket::ReUse(uint8 * Data, int32 BufferSize, int32 & BytesRead, int32
 		return;
 	}
 
+	if (Head.IsCompressed())
+	{
+		// lz body is checked on wire bytes, then decompressed
+		ReadCompressedFrame(Data, BufferSize, index, BytesRead, InSlab);
+		return;
+	}
+
 	index += FSNetBufferHead::MemSize();
 	fastcode ^= Head.XOR();
 
@@ -254,50 +383,193 @@ void FSNetPacket::ReUse(uint8 * Data, int32 BufferSize, int32 & BytesRead, int32
 	// 3. check and read body
 	if (0 != Head.uid)
 	{
-		if (!Body.MemRead(Data + index, BufferSize - index, Head.size))
+		// view: one xor pass over slab; copy: fused copy and xor pass
+		uint8 bodyXOR = 0;
+		const bool bBodyRead = InSlab ? Body.MemView(Data + index, BufferSize - index, Head.size, InSlab)
+			: Body.MemRead(Data + index, BufferSize - index, Head.size, &bodyXOR);
+		if (!bBodyRead)
 		{
 			// failed to read from the rest buffer
 			BytesRead = BufferSize;
 			return;
 		}
+		if (InSlab)
+		{
+			bodyXOR = Body.XOR();
+		}
 		index += Body.MemSize();
-		fastcode ^= Body.XOR();
+		fastcode ^= bodyXOR;
 	}
 
 	// 4. read foot
-	if (!Foot.MemRead(Data + index, BufferSize - index))
+	if (!Foot.MemRead(Data + index, BufferSize - index, Head.version))
 	{
 		// failed to read from the rest buffer
 		BytesRead = BufferSize;
 		return;
 	}
 
-	index += FSNetBufferFoot::MemSize();
+	index += FSNetBufferFoot::MemSize(Head.version);
 	fastcode ^= Foot.XOR();
 
 	BytesRead = index;
-	bFastIntegrity = fastcode == 0;
+	bFastIntegrity = SERVO_PROTOCOL_VERSION_CRC32C == Head.version ? CheckIntegrity() : fastcode == 0;
 
 	sid = Head.SessionID();
 
 	return;
 }
 
-void FSNetPacket::WriteToArray(TArray<uint8>& InBufferArr)
+bool FSNetPacket::ReUseFrame(uint8 * Frame, int32 FrameSize, FSNetRecvSlab * InSlab)
+{
+	sid = 0;
+	bFastIntegrity = false;
+
+	// 1. read head
+	if (!Head.MemRead(Frame, FrameSize))
+	{
+		return false;
+	}
+
+	// crc32c covers the whole frame in one pass, xor is not needed
+	const bool bCrc32c = SERVO_PROTOCOL_VERSION_CRC32C == Head.version;
+	const bool bCompressed = Head.IsCompressed();
+	int32 index = FSNetBufferHead::MemSize();
+	const int32 bodyIndex = index;
+	uint8 fastcode = bCrc32c ? 0 : Head.XOR();
+
+	// 2. read body, heartbeat has no body
+	if (0 != Head.uid)
+	{
+		uint8 bodyXOR = 0;
+		if (bCompressed)
+		{
+			// decompress after integrity check
+			if (Head.size > FrameSize - index)
+			{
+				return false;
+			}
+			if (!bCrc32c)
+			{
+				bodyXOR = BufferXOR(Frame + index, Head.size);
+			}
+			index += Head.size;
+		}
+		else {
+			const bool bBodyRead = InSlab ? Body.MemView(Frame + index, FrameSize - index, Head.size, InSlab)
+				: Body.MemRead(Frame + index, FrameSize - index, Head.size, bCrc32c ? nullptr : &bodyXOR);
+			if (!bBodyRead)
+			{
+				return false;
+			}
+			if (InSlab && !bCrc32c)
+			{
+				bodyXOR = Body.XOR();
+			}
+			index += Body.MemSize();
+		}
+		fastcode ^= bodyXOR;
+	}
+
+	// 3. read foot
+	if (!Foot.MemRead(Frame + index, FrameSize - index, Head.version))
+	{
+		return false;
+	}
+
+	index += FSNetBufferFoot::MemSize(Head.version);
+
+	if (index != FrameSize)
+	{
+		return false;
+	}
+
+	if (bCrc32c)
+	{
+		bFastIntegrity = Crc32c(Frame, FrameSize - sizeof(uint32)) == Foot.crc32c;
+	}
+	else {
+		fastcode ^= Foot.XOR();
+		bFastIntegrity = fastcode == 0;
+	}
+
+	// 4. decompress legal body, head describes the raw body after this
+	if (bFastIntegrity && bCompressed)
+	{
+		const int32 wireSize = Head.size;
+		bFastIntegrity = Body.MemDecompress(Frame + bodyIndex, FrameSize - bodyIndex, wireSize);
+		if (bFastIntegrity)
+		{
+			Head.size = Body.length;
+			Head.reserved &= ~SERVO_PROTOCOL_FLAG_LZ;
+			// reseal, fastcode and crc32c described the wire bytes
+			UpdateIntegrity();
+			GDecompressedNum.Increment();
+			GDecompressedRawBytes.Add(Body.length);
+			GDecompressedWireBytes.Add(wireSize);
+		}
+		else {
+			GDecompressFailedNum.Increment();
+		}
+	}
+
+	sid = Head.SessionID();
+
+	return bFastIntegrity;
+}
+
+void FSNetPacket::ReadCompressedFrame(uint8 * Data, int32 BufferSize, int32 HeadIndex, int32 & BytesRead, FSNetRecvSlab * InSlab)
 {
+	const int32 frameSize = GetFrameSize(Head);
+	if (frameSize < 0 || frameSize > BufferSize - HeadIndex)
+	{
+		// broken size or split frame, same as a failed body read
+		BytesRead = BufferSize;
+		return;
+	}
+
+	ReUseFrame(Data + HeadIndex, frameSize, InSlab);
+	BytesRead = HeadIndex + frameSize;
+}
+
+int32 FSNetPacket::GetFrameSize(const FSNetBufferHead & InHead)
+{
+	int32 bodySize = 0;
+	if (0 != InHead.uid)
+	{
+		if (InHead.size < 0 || InHead.size > SERVO_PROTOCOL_BODY_MAX)
+			return -1;
+		bodySize = InHead.size;
+	}
+
+	return FSNetBufferHead::MemSize() + bodySize + FSNetBufferFoot::MemSize(InHead.version);
+}
+
+void FSNetPacket::WriteToArray(TArray<uint8>& InBufferArr, bool bCompress)
+{
+	const int32 HeadSize = FSNetBufferHead::MemSize();
+	const int32 FootSize = FSNetBufferFoot::MemSize(Head.version);
+
+	if (bCompress && Head.uid != 0 && Body.bufferPtr && Body.length >= SERVO_PROTOCOL_LZ_MIN_SIZE && !Head.IsCompressed()
+		&& WriteCompressedToArray(InBufferArr))
+	{
+		return;
+	}
+
 	int32 BytesWrite = 0;
-	int32 writeSize = sizeof(FSNetBufferHead) + sizeof(FSNetBufferFoot);
+	int32 writeSize = HeadSize + FootSize;
 	if (Head.uid > 0ui16)
 	{
 		writeSize += Body.length;
 	}
 
-	InBufferArr.SetNumZeroed (writeSize);
+	// every byte is written below, no zero fill
+	InBufferArr.SetNumUninitialized(writeSize, false);
 	uint8* DataPtr = InBufferArr.GetData();
 	
 	//1. write heads
-	FMemory::Memcpy(DataPtr, &Head, FSNetBufferHead::MemSize());
-	BytesWrite += sizeof(FSNetBufferHead);
+	FMemory::Memcpy(DataPtr, &Head, HeadSize);
+	BytesWrite += HeadSize;
 	
 	//2. write Body
 	if (Head.uid != 0)
@@ -307,8 +579,59 @@ void FSNetPacket::WriteToArray(TArray<uint8>& InBufferArr)
 	}
 
 	//3. write Foot
-	FMemory::Memcpy(DataPtr + BytesWrite, &Foot, FSNetBufferFoot::MemSize());
-	BytesWrite += FSNetBufferFoot::MemSize();
+	FMemory::Memcpy(DataPtr + BytesWrite, &Foot, FootSize);
+	BytesWrite += FootSize;
+}
+
+bool FSNetPacket::WriteCompressedToArray(TArray<uint8>& InBufferArr)
+{
+	const int32 HeadSize = FSNetBufferHead::MemSize();
+	const int32 FootSize = FSNetBufferFoot::MemSize(Head.version);
+	const int32 RawSizeBytes = sizeof(uint32);
+	const int32 bound = LZCompressBound(Body.length);
+
+	InBufferArr.SetNumUninitialized(HeadSize + RawSizeBytes + bound + FootSize, false);
+	uint8* DataPtr = InBufferArr.GetData();
+
+	//1. compress body behind head and raw size
+	const int32 lzSize = LZCompress(Body.bufferPtr, Body.length, DataPtr + HeadSize + RawSizeBytes, bound);
+	if (lzSize <= 0 || lzSize + RawSizeBytes >= Body.length)
+	{
+		// not smaller, send raw body
+		GCompressSkippedNum.Increment();
+		return false;
+	}
+
+	const uint32 rawSize = (uint32)Body.length;
+	FMemory::Memcpy(DataPtr + HeadSize, &rawSize, RawSizeBytes);
+	const int32 bodySize = RawSizeBytes + lzSize;
+
+	//2. write head of compressed body
+	FSNetBufferHead wireHead = Head;
+	wireHead.size = bodySize;
+	wireHead.reserved |= SERVO_PROTOCOL_FLAG_LZ;
+	wireHead.fastcode = 0;
+	FMemory::Memcpy(DataPtr, &wireHead, HeadSize);
+
+	//3. write Foot
+	FMemory::Memcpy(DataPtr + HeadSize + bodySize, &Foot, FootSize);
+	const int32 writeSize = HeadSize + bodySize + FootSize;
+	InBufferArr.SetNum(writeSize, false);
+
+	//4. integrity covers wire bytes
+	const bool bCrc32c = SERVO_PROTOCOL_VERSION_CRC32C == Head.version;
+	const int32 xorSize = bCrc32c ? writeSize - (int32)sizeof(uint32) : writeSize;
+	DataPtr[STRUCT_OFFSET(FSNetBufferHead, fastcode)] = BufferXOR(DataPtr, xorSize);
+	if (bCrc32c)
+	{
+		const uint32 crc = Crc32c(DataPtr, xorSize);
+		FMemory::Memcpy(DataPtr + xorSize, &crc, sizeof(uint32));
+	}
+
+	GCompressedNum.Increment();
+	GCompressedRawBytes.Add(Body.length);
+	GCompressedWireBytes.Add(bodySize);
+	return true;
 }
 
 void FSNetPacket::OnDealloc()
@@ -331,7 +654,7 @@ void FSNetPacket::ReUseAsHeartbeat(int32 InSyncword)
 	Head.syncword = InSyncword;
 	Body.Reset();
 	Foot.SetNow();
-	Head.fastcode = Head.XOR() ^ Foot.XOR();
+	UpdateIntegrity();
 }
 
 bool FSNetPacket::operator<(const FSNetPacket & Other)
@@ -339,9 +662,14 @@ bool FSNetPacket::operator<(const FSNetPacket & Other)
 	return Foot.timestamp < Other.Foot.timestamp;
 }
 
-bool FSNetBufferFoot::MemRead(uint8 * Data, int32 BufferSize)
+void FSNetPacket::Recycle()
+{
+	FServoProtocol::Get()->RecycleNetPacket(this);
+}
+
+bool FSNetBufferFoot::MemRead(uint8 * Data, int32 BufferSize, uint8 InVersion)
 {
-	const int32 ReadSize = sizeof(FSNetBufferFoot);
+	const int32 ReadSize = MemSize(InVersion);
 	if (BufferSize < ReadSize)
 		return false;
 
@@ -350,21 +678,9 @@ bool FSNetBufferFoot::MemRead(uint8 * Data, int32 BufferSize)
 	return true;
 }
 
-int32 FSNetBufferFoot::MemSize()
-{
-	return sizeof(FSNetBufferFoot);
-}
-
 uint8 FSNetBufferFoot::XOR()
 {
-	uint8 ret = 0;
-	uint8 *ptr = (uint8*)this;
-	const int32 imax = sizeof(FSNetBufferFoot);
-	for (int32 i = 0; i < imax; ++i)
-	{
-		ret ^= ptr[i];
-	}
-	return ret;
+	return BufferXOR((const uint8*)this, MemSize());
 }
 
 void FSNetBufferFoot::SetNow()
@@ -379,18 +695,46 @@ void FSNetBufferFoot::SetNow()
 
 FServoProtocol::FServoProtocol()
 	:Syncword(DEFAULT_SYNCWORD_INT32)
-	, PacketPoolCount(0)
-	, RecyclePool(RecyclePoolMaxnum)
+	, bBackpressure(false)
+	, ArrivalEvent(nullptr)
+	, RecyclePool(RecyclePoolMaxnum, RecyclePoolMinnum)
+	, LastMaintainTime(0)
 {
 	check(pSingleton == nullptr && "Protocol singleton can't create 2 object!");
 	pSingleton = this;
-	PacketPool = new TNetPacketQueue<FSNetPacket, ESPMode::ThreadSafe>();
+	PacketLanes = nullptr;
+	Shards = ShardNum > 0 ? new FServoShards(ShardNum) : nullptr;
+	if (bArrivalEvent)
+	{
+		ArrivalEvent = FPlatformProcess::GetSynchEventFromPool(false);
+	}
+	if (SERVO_PROTOCOL_PACKET_POOL_RING == PacketPoolStrategy)
+	{
+		PacketPool = new TNetPacketRing<FServoPacketRef>(SERVO_PROTOCOL_PACKET_POOL_MAX);
+	}
+	else if (SERVO_PROTOCOL_PACKET_POOL_LANES == PacketPoolStrategy)
+	{
+		TArray<FNetPacketLaneConfig> lanes;
+		GetDefaultPacketLanes(lanes);
+		PacketLanes = new TNetPacketLanes<FServoPacketRef>(lanes, ENetPacketLanePolicy::WeightedFair);
+		PacketPool = PacketLanes;
+	}
+	else {
+		PacketPool = new TNetPacketQueue<FServoPacketRef>();
+	}
 }
 
 FServoProtocol::~FServoProtocol()
 {
-	pSingleton = nullptr;
+	// queued refs recycle into this protocol, so delete pool while singleton is alive
+	delete Shards;
 	delete PacketPool;
+	if (ArrivalEvent)
+	{
+		FPlatformProcess::ReturnSynchEventToPool(ArrivalEvent);
+		ArrivalEvent = nullptr;
+	}
+	pSingleton = nullptr;
 }
 
 FServoProtocol * FServoProtocol::Get()
@@ -425,67 +769,297 @@ FServoProtocol & FServoProtocol::SingletonRef()
 	return *pSingleton;
 }
 
-bool FServoProtocol::Push(const TSharedPtr<FSNetPacket, ESPMode::ThreadSafe>& InNetPacket)
+bool FServoProtocol::Push(const FServoPacketRef& InNetPacket, int32 InRank)
 {
+	if (nullptr != Shards)
+	{
+		return Shards->Push(InNetPacket, InRank);
+	}
+
 	if (PacketPool->Push(InNetPacket))
 	{
-		++PacketPoolCount;
+		// wake consumer only on empty to non-empty
+		if (1 == PacketPoolCount.Increment() && ArrivalEvent)
+		{
+			ArrivalEvent->Trigger();
+		}
 		return true;
 	}
 
 	return false;
 }
 
-bool FServoProtocol::Pop(TSharedPtr<FSNetPacket, ESPMode::ThreadSafe>& OutNetPacket)
+bool FServoProtocol::Pop(FServoPacketRef& OutNetPacket)
 {
 	if (PacketPool->Pop(OutNetPacket))
 	{
-		--PacketPoolCount;
+		PacketPoolCount.Decrement();
 		return true;
 	}
 
 	return false;
 }
 
+int32 FServoProtocol::PopBatch(TArray<FServoPacketRef>& OutNetPackets, int32 InMax)
+{
+	if (InMax <= 0)
+		return 0;
+
+	OutNetPackets.Reserve(OutNetPackets.Num() + InMax);
+	const int32 count = PacketPool->PopBatch(OutNetPackets, InMax);
+	PacketPoolCount.Subtract(count);
+	return count;
+}
+
+bool FServoProtocol::WaitForPackets(uint32 WaitMs)
+{
+	if (nullptr == ArrivalEvent)
+	{
+		FPlatformProcess::Sleep(WaitMs / 1000.0f);
+		return false;
+	}
+
+	// auto reset event keeps a trigger without waiter, so an arrival before Wait is not lost
+	return ArrivalEvent->Wait(WaitMs);
+}
+
+FEvent * FServoProtocol::GetArrivalEvent()
+{
+	return ArrivalEvent;
+}
+
 int32 FServoProtocol::PacketPoolNum()
 {
-	return PacketPoolCount;
+	// packets waiting in shards count for backpressure too
+	return PacketPoolCount.GetValue() + (Shards ? Shards->Num() : 0);
 }
 
-TSharedPtr<FSNetPacket, ESPMode::ThreadSafe> FServoProtocol::AllocNetPacket()
+FServoShards * FServoProtocol::GetShards()
 {
-	return RecyclePool.Alloc();
+	return Shards;
 }
 
-TSharedPtr<FSNetPacket, ESPMode::ThreadSafe> FServoProtocol::AllocHeartbeat()
+bool FServoProtocol::GetPacketLaneStats(TArray<FNetPacketLaneStats>& OutStats)
 {
-	TSharedPtr<FSNetPacket, ESPMode::ThreadSafe>&& ret = RecyclePool.Alloc();
+	if (nullptr == PacketLanes)
+	{
+		OutStats.Reset();
+		return false;
+	}
 
-	ret->ReUseAsHeartbeat(Syncword);
+	PacketLanes->GetLaneStats(OutStats);
+	return true;
+}
 
-	ret->CheckIntegrity();
+void FServoProtocol::GetDefaultPacketLanes(TArray<FNetPacketLaneConfig>& OutLanes)
+{
+	// control traffic gets most pop turns, bulk still drains
+	OutLanes.Reset(3);
+	OutLanes.Add(FNetPacketLaneConfig(0, 0, SERVO_PROTOCOL_PACKET_POOL_MAX / 4, 2));
+	OutLanes.Add(FNetPacketLaneConfig(1, SERVO_PROTOCOL_CONTROL_UID_MAX, SERVO_PROTOCOL_PACKET_POOL_MAX / 2, 4));
+	OutLanes.Add(FNetPacketLaneConfig(SERVO_PROTOCOL_CONTROL_UID_MAX + 1, 0xffff, SERVO_PROTOCOL_PACKET_POOL_MAX, 2));
+}
 
-	return ret;
+bool FServoProtocol::IsBackpressure()
+{
+	// shard queues count too, readers pause when workers fall behind
+	const int32 num = PacketPoolNum();
+	if (num >= SERVO_PROTOCOL_PACKET_POOL_HIGH_WATERMARK)
+	{
+		if (!bBackpressure)
+		{
+			bBackpressure = true;
+			UE_LOG(LogTemp, Display, TEXT("FServoProtocol: packet pool %d reaches high watermark, pause readers"), num);
+		}
+	}
+	else if (num <= SERVO_PROTOCOL_PACKET_POOL_LOW_WATERMARK && bBackpressure)
+	{
+		bBackpressure = false;
+		UE_LOG(LogTemp, Display, TEXT("FServoProtocol: packet pool %d drains to low watermark, resume readers"), num);
+	}
+
+	return bBackpressure;
 }
 
-void FServoProtocol::DeallockNetPacket(const TSharedPtr<FSNetPacket, ESPMode::ThreadSafe>& InSharedPtr, bool bForceRecycle)
+int32 FServoProtocol::TryPushBatch(TArray<FServoPacketRef>& InOutNetPackets, int32 InRank)
 {
-	if (!InSharedPtr.IsValid())
-		return;
+	if (nullptr != Shards)
+	{
+		const int32 count = Shards->PushBatch(InOutNetPackets, InRank);
+		InOutNetPackets.Reset();
+		return count;
+	}
 
-	//UE_LOG(LogTemp, Display, TEXT("OnDeallocBegin"));
-	InSharedPtr->OnDealloc();
-	//UE_LOG(LogTemp, Display, TEXT("OnDeallocEnd"));
-	if (bForceRecycle)
+	const int32 count = PacketPool->TryPushBatch(InOutNetPackets);
+	// Add returns the old count, wake consumer only on empty to non-empty
+	if (0 == PacketPoolCount.Add(count) && count > 0 && ArrivalEvent)
 	{
-		RecyclePool.DeallocForceRecycle(InSharedPtr);
+		ArrivalEvent->Trigger();
 	}
-	else 
+	return count;
+}
+
+int32 FServoProtocol::PushBatch(const TArray<FServoPacketRef>& InNetPackets, int32 InRank)
+{
+	if (nullptr != Shards)
 	{
-		//UE_LOG(LogTemp, Display, TEXT("recycle begin"));
-		RecyclePool.Dealloc(InSharedPtr);
-		//UE_LOG(LogTemp, Display, TEXT("recycle end"));
+		return Shards->PushBatch(InNetPackets, InRank);
 	}
+
+	const int32 count = PacketPool->PushBatch(InNetPackets);
+	// Add returns the old count, wake consumer only on empty to non-empty
+	if (0 == PacketPoolCount.Add(count) && count > 0 && ArrivalEvent)
+	{
+		ArrivalEvent->Trigger();
+	}
+
+	// readers decode within headroom, a drop means producers raced for the last slots
+	int32 validNum = 0;
+	for (int32 i = 0; i < InNetPackets.Num(); ++i)
+	{
+		if (InNetPackets[i].IsValid())
+		{
+			++validNum;
+		}
+	}
+	if (count < validNum)
+	{
+		const int64 dropped = PushDropCount.Add(validNum - count) + (validNum - count);
+		UE_LOG(LogTemp, Warning, TEXT("FServoProtocol: packet pool is full, drop %d packets of rank %d, %lld dropped in total"), validNum - count, InRank, dropped);
+	}
+	return count;
+}
+
+int32 FServoProtocol::GetPushHeadroom()
+{
+	return nullptr != Shards ? MAX_int32 : PacketPool->GetHeadroom();
+}
+
+int64 FServoProtocol::GetPushDropCount()
+{
+	return PushDropCount.GetValue();
+}
+
+FServoCompressionStats::FServoCompressionStats()
+	: CompressedNum(0)
+	, CompressedRawBytes(0)
+	, CompressedWireBytes(0)
+	, SkippedNum(0)
+	, DecompressedNum(0)
+	, DecompressedRawBytes(0)
+	, DecompressedWireBytes(0)
+	, DecompressFailedNum(0)
+{
+}
+
+float FServoCompressionStats::GetSendRatio() const
+{
+	return CompressedRawBytes > 0 ? (float)((double)CompressedWireBytes / (double)CompressedRawBytes) : 1.f;
+}
+
+float FServoCompressionStats::GetRecvRatio() const
+{
+	return DecompressedRawBytes > 0 ? (float)((double)DecompressedWireBytes / (double)DecompressedRawBytes) : 1.f;
+}
+
+void FServoProtocol::GetCompressionStats(FServoCompressionStats & OutStats)
+{
+	OutStats.CompressedNum = GCompressedNum.GetValue();
+	OutStats.CompressedRawBytes = GCompressedRawBytes.GetValue();
+	OutStats.CompressedWireBytes = GCompressedWireBytes.GetValue();
+	OutStats.SkippedNum = GCompressSkippedNum.GetValue();
+	OutStats.DecompressedNum = GDecompressedNum.GetValue();
+	OutStats.DecompressedRawBytes = GDecompressedRawBytes.GetValue();
+	OutStats.DecompressedWireBytes = GDecompressedWireBytes.GetValue();
+	OutStats.DecompressFailedNum = GDecompressFailedNum.GetValue();
+}
+
+void FServoProtocol::LogCompressionStats()
+{
+	FServoCompressionStats stats;
+	GetCompressionStats(stats);
+	UE_LOG(LogTemp, Display, TEXT("FServoProtocol: lz send %lld packets %lld -> %lld bytes ratio %.3f, %lld skipped; recv %lld packets %lld -> %lld bytes ratio %.3f, %lld failed"),
+		stats.CompressedNum, stats.CompressedRawBytes, stats.CompressedWireBytes, stats.GetSendRatio(), stats.SkippedNum,
+		stats.DecompressedNum, stats.DecompressedWireBytes, stats.DecompressedRawBytes, stats.GetRecvRatio(), stats.DecompressFailedNum);
+}
+
+int32 FServoProtocol::DecodeBatch(FServoFrameDecoder & Decoder, uint8 * Data, int32 Length, TArray<FServoPacketRef>& OutNetPackets, FSNetRecvSlab * InSlab, int32 MaxPackets)
+{
+	// 1. find frame bounds, no packet touched
+	TArray<FServoFrame, TInlineAllocator<64> > frames;
+	int32 index = 0;
+	while (index < Length && frames.Num() < MaxPackets)
+	{
+		FServoFrame frame;
+		bool bReady = false;
+		index += Decoder.NextFrame(Data + index, Length - index, frame, bReady);
+		if (bReady)
+		{
+			frames.Add(frame);
+		}
+	}
+
+	if (frames.Num() == 0)
+	{
+		return index;
+	}
+
+	// 2. alloc all packets with one lock
+	TArray<FSNetPacket*, TInlineAllocator<64> > packets;
+	RecyclePool.AllocBatch(frames.Num(), packets);
+
+	// 3. read frames, carried frame is reused by decoder so body must be copied
+	TArray<FSNetPacket*, TInlineAllocator<16> > illegalPackets;
+	OutNetPackets.Reserve(OutNetPackets.Num() + frames.Num());
+	for (int32 i = 0; i < frames.Num(); ++i)
+	{
+		FSNetPacket* packet = packets[i];
+		packet->ReUseFrame(frames[i].Data, frames[i].Size, frames[i].bCarried ? nullptr : InSlab);
+
+		if (packet->IsValid())
+		{
+			OutNetPackets.Emplace(packet);
+		}
+		else {
+			packet->OnDealloc();
+			illegalPackets.Add(packet);
+		}
+	}
+
+	// 4. recycle illegal packets with one lock, they never had a ref
+	if (illegalPackets.Num() > 0)
+	{
+		RecyclePool.DeallocBatch(illegalPackets);
+	}
+
+	return index;
+}
+
+FServoPacketRef FServoProtocol::AllocNetPacket()
+{
+	return FServoPacketRef(RecyclePool.Alloc());
+}
+
+FServoPacketRef FServoProtocol::AllocHeartbeat()
+{
+	FServoPacketRef ret(RecyclePool.Alloc());
+
+	ret->ReUseAsHeartbeat(Syncword);
+
+	ret->CheckIntegrity();
+
+	return ret;
+}
+
+void FServoProtocol::DeallockNetPacket(FServoPacketRef& InOutNetPacket)
+{
+	InOutNetPacket.Reset();
+}
+
+void FServoProtocol::RecycleNetPacket(FSNetPacket * InPacket)
+{
+	InPacket->OnDealloc();
+	RecyclePool.Dealloc(InPacket);
 }
 
 int32 FServoProtocol::RecyclePoolNum()
@@ -493,12 +1067,42 @@ int32 FServoProtocol::RecyclePoolNum()
 	return RecyclePool.Num();
 }
 
-bool FServoProtocol::PopWithRecycle(TSharedPtr<FSNetPacket, ESPMode::ThreadSafe>& OutRecyclePacket)
+void FServoProtocol::MaintainRecyclePool()
+{
+	FScopeLock lockMaintain(&MaintainCriticalSection);
+	const double now = FPlatformTime::Seconds();
+	if (now - LastMaintainTime < SERVO_PROTOCOL_RECYCLE_MAINTAIN_INTERVAL)
+	{
+		return;
+	}
+	LastMaintainTime = now;
+
+	RecyclePool.Maintain();
+	// packet bodies, depots keep blocks of the busiest moment otherwise
+	FSizeClassAllocator::Get().Maintain();
+}
+
+void FServoProtocol::GetRecyclePoolStats(Septem::FRecyclePoolStats & OutStats)
+{
+	RecyclePool.GetStats(OutStats);
+}
+
+FSNetRecvSlab * FServoProtocol::AllocRecvSlab()
+{
+	return RecvSlabPool.Alloc();
+}
+
+int32 FServoProtocol::RecvSlabPoolNum()
+{
+	return RecvSlabPool.Num();
+}
+
+bool FServoProtocol::PopWithRecycle(FServoPacketRef& OutRecyclePacket)
 {
-	TSharedPtr<FSNetPacket, ESPMode::ThreadSafe> newPacket;
+	FServoPacketRef newPacket;
 	if (Pop(newPacket))
 	{
-		DeallockNetPacket(OutRecyclePacket);
+		// old packet is recycled when its last ref is dropped
 		OutRecyclePacket = MoveTemp(newPacket);
 		return true;
 	}
@@ -508,4 +1112,8 @@ bool FServoProtocol::PopWithRecycle(TSharedPtr<FSNetPacket, ESPMode::ThreadSafe>
 
 FServoProtocol* FServoProtocol::pSingleton = nullptr;
 FCriticalSection FServoProtocol::mCriticalSection;
-int32 FServoProtocol::RecyclePoolMaxnum = 1024;
\ No newline at end of file
+int32 FServoProtocol::RecyclePoolMaxnum = 1024;
+int32 FServoProtocol::RecyclePoolMinnum = 64;
+int32 FServoProtocol::PacketPoolStrategy = SERVO_PROTOCOL_PACKET_POOL_STRATEGY;
+int32 FServoProtocol::ShardNum = 0;
+bool FServoProtocol::bArrivalEvent = false;
\ No newline at end of file
@@ -3,12 +3,37 @@
 #pragma once
 
 #include "CoreMinimal.h"
+#include "HAL/ThreadSafeCounter.h"
+#include "HAL/ThreadSafeBool.h"
+#include "HAL/Event.h"
 
 #include "NetPacketPool.hpp"
+#include "NetRecvSlab.h"
 #include "../SeptemAlgorithm/SeptemAlgorithm.h"
 
 //#define SERVO_PROTOCOL_SIGNATURE
 
+/*
+* Integrity mode selected by FSNetBufferHead.version
+* XOR		: 1 byte fastcode in head
+* SIGNATURE	: sha256 signature in foot, need SERVO_PROTOCOL_SIGNATURE
+* CRC32C	: crc32c of head + body + foot timestamp, appended to foot
+*/
+#define SERVO_PROTOCOL_VERSION_XOR 0
+#define SERVO_PROTOCOL_VERSION_SIGNATURE 1
+#define SERVO_PROTOCOL_VERSION_CRC32C 2
+
+/*
+* Body compression flag in FSNetBufferHead.reserved (not for heartbeat)
+* compressed body on wire: [uint32 raw size][lz block], head.size = compressed size
+* bodies smaller than min size are never compressed
+*/
+#define SERVO_PROTOCOL_FLAG_LZ 0x80000000u
+
+#ifndef SERVO_PROTOCOL_LZ_MIN_SIZE
+#define SERVO_PROTOCOL_LZ_MIN_SIZE 256
+#endif // !SERVO_PROTOCOL_LZ_MIN_SIZE
+
 #ifndef DEFAULT_SYNCWORD_INT32
 #define DEFAULT_SYNCWORD_INT32 0xE6B7F1A2
 #endif // !DEFAULT_SYNCWORD_INT32
@@ -24,6 +49,77 @@
 #define SERVO_PROTOCOL_PACKET_POOL_MAX 1024
 #endif // !SERVO_PROTOCOL_PACKET_POOL_MAX
 
+/*
+* Backpressure of packet pool
+* readers stop reading sockets when pool reaches high watermark,
+* bytes stay in kernel and TCP flow control slows the clients.
+* readers resume when pool drains to low watermark.
+* space over high watermark is headroom for recvs already in flight
+*/
+#ifndef SERVO_PROTOCOL_PACKET_POOL_HIGH_WATERMARK
+#define SERVO_PROTOCOL_PACKET_POOL_HIGH_WATERMARK (SERVO_PROTOCOL_PACKET_POOL_MAX * 3 / 4)
+#endif // !SERVO_PROTOCOL_PACKET_POOL_HIGH_WATERMARK
+
+#ifndef SERVO_PROTOCOL_PACKET_POOL_LOW_WATERMARK
+#define SERVO_PROTOCOL_PACKET_POOL_LOW_WATERMARK (SERVO_PROTOCOL_PACKET_POOL_MAX / 2)
+#endif // !SERVO_PROTOCOL_PACKET_POOL_LOW_WATERMARK
+
+/*
+* Max body size of one packet
+* head with a bigger size is treated as a false syncword
+* frames split by recv are carried in memory up to this size
+*/
+#ifndef SERVO_PROTOCOL_BODY_MAX
+#define SERVO_PROTOCOL_BODY_MAX (1024 * 1024)
+#endif // !SERVO_PROTOCOL_BODY_MAX
+
+/*
+* Packet pool strategy of FServoProtocol
+* QUEUE	: unbounded MPSC node list, one consumer
+* RING	: bounded MPMC ring of SERVO_PROTOCOL_PACKET_POOL_MAX, no allocation, many consumers
+* LANES	: heartbeat / control / bulk lanes by uid, weighted fair pop
+*/
+#define SERVO_PROTOCOL_PACKET_POOL_QUEUE 0
+#define SERVO_PROTOCOL_PACKET_POOL_RING 1
+#define SERVO_PROTOCOL_PACKET_POOL_LANES 2
+
+#ifndef SERVO_PROTOCOL_PACKET_POOL_STRATEGY
+#define SERVO_PROTOCOL_PACKET_POOL_STRATEGY SERVO_PROTOCOL_PACKET_POOL_QUEUE
+#endif // !SERVO_PROTOCOL_PACKET_POOL_STRATEGY
+
+/*
+* Max uid of control messages for LANES strategy
+* lane 0: heartbeat (uid 0), lane 1: control (1 ~ max), lane 2: bulk (the rest)
+*/
+#ifndef SERVO_PROTOCOL_CONTROL_UID_MAX
+#define SERVO_PROTOCOL_CONTROL_UID_MAX 1023
+#endif // !SERVO_PROTOCOL_CONTROL_UID_MAX
+
+/*
+* Recycle pool of packets
+* 1: lock-free pool with fixed slots, no mutex on alloc/dealloc
+* 0: mutex pool, force recycle can grow it
+*/
+#ifndef SERVO_PROTOCOL_LOCKFREE_RECYCLE_POOL
+#define SERVO_PROTOCOL_LOCKFREE_RECYCLE_POOL 1
+#endif // !SERVO_PROTOCOL_LOCKFREE_RECYCLE_POOL
+
+/*
+* Per-thread magazines in front of the recycle pool
+* 1: alloc/dealloc hit the thread's magazine, the shared pool is touched in batches
+*/
+#ifndef SERVO_PROTOCOL_RECYCLE_MAGAZINE
+#define SERVO_PROTOCOL_RECYCLE_MAGAZINE 1
+#endif // !SERVO_PROTOCOL_RECYCLE_MAGAZINE
+
+/*
+* Min seconds between two recycle pool maintain steps
+* demand window of recycle pool = interval * SEPTEM_RECYCLE_POOL_WINDOW
+*/
+#ifndef SERVO_PROTOCOL_RECYCLE_MAINTAIN_INTERVAL
+#define SERVO_PROTOCOL_RECYCLE_MAINTAIN_INTERVAL 0.05
+#endif // !SERVO_PROTOCOL_RECYCLE_MAINTAIN_INTERVAL
+
 
 
 /***************************************/
@@ -58,6 +154,8 @@ struct SEPTEMSERVO_API FSNetBufferHead
 	uint8 XOR();
 	void Reset();
 	int32 SessionID();
+	// body is compressed on wire
+	bool IsCompressed() const;
 };
 #pragma pack(pop)
 
@@ -94,10 +192,14 @@ struct SEPTEMSERVO_API FSNetBufferBody
 {
 	uint8* bufferPtr;
 	int32 length; // lenght == BufferHead.size;
+	// recv slab which owns bufferPtr when body is a view
+	// nullptr when bufferPtr is owned by body, allocated from FSizeClassAllocator
+	FSNetRecvSlab* slab;
 
 	FSNetBufferBody()
 		: bufferPtr(nullptr)
 		, length(0)
+		, slab(nullptr)
 	{}
 
 	~FSNetBufferBody()
@@ -106,8 +208,14 @@ struct SEPTEMSERVO_API FSNetBufferBody
 	}
 
 	bool IsValid();
-	FORCEINLINE bool MemRead(uint8 *Data, int32 BufferSize, int32 InLength);
+	// when OutXOR != nullptr, body fastcode is computed during the copy
+	FORCEINLINE bool MemRead(uint8 *Data, int32 BufferSize, int32 InLength, uint8* OutXOR = nullptr);
+	// zero copy: view into InSlab, hold a slab reference until Reset()
+	bool MemView(uint8 *Data, int32 BufferSize, int32 InLength, FSNetRecvSlab* InSlab);
+	// decompress [raw size][lz block] of InLength bytes into owned buffer
+	bool MemDecompress(uint8 *Data, int32 BufferSize, int32 InLength);
 	FORCEINLINE int32 MemSize();
+	bool IsView() const;
 	uint8 XOR();
 
 	void Reset();
@@ -149,6 +257,9 @@ struct SEPTEMSERVO_API FSNetBufferBody
 		only timestamp;
 	version 1:
 		[ signature, timestamp]
+	version 2:
+		[ (signature), timestamp, crc32c]
+		crc32c of head, body and foot before crc32c
 */
 /***************************************************/
 #pragma pack(push, 1)
@@ -159,19 +270,28 @@ struct SEPTEMSERVO_API FSNetBufferFoot
 	FSHA256Signature signature;
 #endif // SERVO_PROTOCOL_SIGNATURE
 	uint64 timestamp; // unix timestamp
+	uint32 crc32c; // only on wire when version == SERVO_PROTOCOL_VERSION_CRC32C
 
 	FSNetBufferFoot()
 		: timestamp(0)
+		, crc32c(0)
 	{
 	}
 
 	FSNetBufferFoot(uint64 InTimestamp)
 		: timestamp(InTimestamp)
+		, crc32c(0)
 	{
 	}
 
-	FORCEINLINE bool MemRead(uint8 *Data, int32 BufferSize);
-	FORCEINLINE static int32 MemSize();
+	FORCEINLINE bool MemRead(uint8 *Data, int32 BufferSize, uint8 InVersion = SERVO_PROTOCOL_VERSION_XOR);
+	// bytes on wire for version, inline for packet writer and decoder
+	FORCEINLINE static int32 MemSize(uint8 InVersion = SERVO_PROTOCOL_VERSION_XOR)
+	{
+		const int32 BaseSize = sizeof(FSNetBufferFoot) - sizeof(uint32);
+		return SERVO_PROTOCOL_VERSION_CRC32C == InVersion ? BaseSize + sizeof(uint32) : BaseSize;
+	}
+	// xor of foot before crc32c
 	uint8 XOR();
 
 	void Reset()
@@ -181,6 +301,7 @@ struct SEPTEMSERVO_API FSNetBufferFoot
 #endif // SERVO_PROTOCOL_SIGNATURE
 
 		timestamp = 0ui64;
+		crc32c = 0;
 	}
 
 	void SetNow();
@@ -218,34 +339,267 @@ struct SEPTEMSERVO_API FSNetPacket
 	// check data integrity with fastcode
 	static bool FastIntegrity(uint8* DataPtr, int32 DataLength, uint8 fastcode);
 
+	// dispatch on Head.version: xor fastcode or crc32c
 	bool CheckIntegrity();
+	// crc32c of head, body and foot before crc32c
+	uint32 ComputeCrc32c();
+	// fill fastcode (and crc32c for version CRC32C) after head, body and foot are set
+	void UpdateIntegrity();
 
 	FSNetPacket()
 		: sid (0)
 		, bFastIntegrity(false)
+		, RefCount(0)
 	{
 	}
 
+	// packets are shared by FServoPacketRef, never copied
+	FSNetPacket(const FSNetPacket&) = delete;
+	FSNetPacket& operator=(const FSNetPacket&) = delete;
+
 	FSNetPacket(uint8* Data, int32 BufferSize, int32& BytesRead, int32 InSyncword = DEFAULT_SYNCWORD_INT32);
 	uint64 GetTimestamp();
 
 	static FSNetPacket* CreateHeartbeat(int32 InSyncword = DEFAULT_SYNCWORD_INT32);
-	void ReUse(uint8* Data, int32 BufferSize, int32& BytesRead, int32 InSyncword = DEFAULT_SYNCWORD_INT32);
-	void WriteToArray(TArray<uint8>& InBufferArr);
+	// when InSlab != nullptr, Data must be inside InSlab and Body will be a view into it
+	void ReUse(uint8* Data, int32 BufferSize, int32& BytesRead, int32 InSyncword = DEFAULT_SYNCWORD_INT32, FSNetRecvSlab* InSlab = nullptr);
+	// read one whole frame which begins with syncword, FrameSize must be GetFrameSize(head of frame)
+	// when InSlab != nullptr, Frame must be inside InSlab and Body will be a view into it
+	// compressed body is decompressed into owned buffer, then head describes the raw body
+	bool ReUseFrame(uint8* Frame, int32 FrameSize, FSNetRecvSlab* InSlab = nullptr);
+	// bytes of head + body + foot on wire, -1 when head is illegal
+	static int32 GetFrameSize(const FSNetBufferHead& InHead);
+protected:
+	// legacy ReUse of a lz frame whose head is read at HeadIndex, goes through ReUseFrame
+	void ReadCompressedFrame(uint8* Data, int32 BufferSize, int32 HeadIndex, int32& BytesRead, FSNetRecvSlab* InSlab);
+public:
+	// body over SERVO_PROTOCOL_LZ_MIN_SIZE is compressed on wire when it gets smaller
+	void WriteToArray(TArray<uint8>& InBufferArr, bool bCompress = true);
+	// return false when body does not get smaller
+	bool WriteCompressedToArray(TArray<uint8>& InBufferArr);
 	void OnDealloc();
 	void OnAlloc();
 	void ReUseAsHeartbeat(int32 InSyncword = DEFAULT_SYNCWORD_INT32);
 	bool operator < (const FSNetPacket& Other);
+
+	// intrusive reference count, used by FServoPacketRef
+	FORCEINLINE void AddRef()
+	{
+		FPlatformAtomics::InterlockedIncrement(&RefCount);
+	}
+
+	// the last release returns packet to recycle pool
+	FORCEINLINE void Release()
+	{
+		if (0 == FPlatformAtomics::InterlockedDecrement(&RefCount))
+		{
+			Recycle();
+		}
+	}
+
+	FORCEINLINE int32 GetRefCount() const
+	{
+		return RefCount;
+	}
+
+private:
+	void Recycle();
+
+	volatile int32 RefCount;
+};
+
+/**
+ * packet handle with intrusive reference count
+ * 8 bytes, one atomic op on copy, none on move.
+ * packet goes back to FServoProtocol recycle pool when the last ref is dropped,
+ * so packets don't need manual dealloc.
+ * thread safe like TSharedPtr<ESPMode::ThreadSafe>: refs to one packet may live on any threads
+ */
+class SEPTEMSERVO_API FServoPacketRef
+{
+public:
+	FORCEINLINE FServoPacketRef()
+		: Packet(nullptr)
+	{
+	}
+
+	// take a new reference of InPacket, packet must be allocated by new
+	FORCEINLINE explicit FServoPacketRef(FSNetPacket* InPacket)
+		: Packet(InPacket)
+	{
+		if (Packet)
+		{
+			Packet->AddRef();
+		}
+	}
+
+	FORCEINLINE FServoPacketRef(const FServoPacketRef& Other)
+		: Packet(Other.Packet)
+	{
+		if (Packet)
+		{
+			Packet->AddRef();
+		}
+	}
+
+	FORCEINLINE FServoPacketRef(FServoPacketRef&& Other)
+		: Packet(Other.Packet)
+	{
+		Other.Packet = nullptr;
+	}
+
+	FORCEINLINE ~FServoPacketRef()
+	{
+		if (Packet)
+		{
+			Packet->Release();
+		}
+	}
+
+	FORCEINLINE FServoPacketRef& operator=(const FServoPacketRef& Other)
+	{
+		if (Packet != Other.Packet)
+		{
+			FServoPacketRef temp(Other);
+			Swap(Packet, temp.Packet);
+		}
+		return *this;
+	}
+
+	FORCEINLINE FServoPacketRef& operator=(FServoPacketRef&& Other)
+	{
+		if (this != &Other)
+		{
+			FSNetPacket* oldPacket = Packet;
+			Packet = Other.Packet;
+			Other.Packet = nullptr;
+			if (oldPacket)
+			{
+				oldPacket->Release();
+			}
+		}
+		return *this;
+	}
+
+	// drop the reference
+	FORCEINLINE void Reset()
+	{
+		if (Packet)
+		{
+			FSNetPacket* oldPacket = Packet;
+			Packet = nullptr;
+			oldPacket->Release();
+		}
+	}
+
+	FORCEINLINE bool IsValid() const
+	{
+		return Packet != nullptr;
+	}
+
+	FORCEINLINE explicit operator bool() const
+	{
+		return Packet != nullptr;
+	}
+
+	FORCEINLINE FSNetPacket* Get() const
+	{
+		return Packet;
+	}
+
+	FORCEINLINE FSNetPacket* operator->() const
+	{
+		return Packet;
+	}
+
+	FORCEINLINE FSNetPacket& operator*() const
+	{
+		return *Packet;
+	}
+
+	FORCEINLINE bool operator==(const FServoPacketRef& Other) const
+	{
+		return Packet == Other.Packet;
+	}
+
+	FORCEINLINE bool operator!=(const FServoPacketRef& Other) const
+	{
+		return Packet != Other.Packet;
+	}
+
+	// heap order by packet
+	FORCEINLINE bool operator<(const FServoPacketRef& Other) const
+	{
+		return Packet && Other.Packet && *Packet < *Other.Packet;
+	}
+
+private:
+	FSNetPacket* Packet;
 };
 
 /************************************************************/
 /*
 		Help
-		TSharedPtr<FSNetPacket> packet = MakeShareable(FSNetPacket::Create(Data, BufferSize, BytesRead));
-		TSharedPtr<FSNetPacket, ESPMode::ThreadSafe> packet = MakeShared<FSNetPacket, ESPMode::ThreadSafe>(?);
+		FServoPacketRef packet = FServoProtocol::Get()->AllocNetPacket();
+		packet->ReUse(Data, BufferSize, BytesRead);
+		// no dealloc: packet returns to recycle pool when the last ref is dropped
+
+		// consumer thread wakes on arrival instead of polling, set bArrivalEvent before first Get()
+		TArray<FServoPacketRef> packets;
+		while (!TimeToDie)
+		{
+			if (0 == FServoProtocol::Get()->PopBatch(packets, 64))
+			{
+				FServoProtocol::Get()->WaitForPackets(10);
+				continue;
+			}
+			// handle packets
+			packets.Reset();
+		}
 */
 /************************************************************/
 
+class FServoFrameDecoder;
+
+// recycle pool of FServoProtocol
+#if SERVO_PROTOCOL_LOCKFREE_RECYCLE_POOL
+typedef Septem::TLockFreeRecyclePool<FSNetPacket> FServoRecycleDepot;
+#else
+typedef Septem::TRecyclePool<FSNetPacket> FServoRecycleDepot;
+#endif // SERVO_PROTOCOL_LOCKFREE_RECYCLE_POOL
+
+#if SERVO_PROTOCOL_RECYCLE_MAGAZINE
+typedef Septem::TMagazineRecyclePool<FSNetPacket, FServoRecycleDepot> FServoRecyclePool;
+#else
+typedef FServoRecycleDepot FServoRecyclePool;
+#endif // SERVO_PROTOCOL_RECYCLE_MAGAZINE
+
+class FServoShards;
+
+// process wide lz totals, wire bytes include the raw size prefix
+struct SEPTEMSERVO_API FServoCompressionStats
+{
+	// bodies sent compressed and their raw/wire bytes
+	int64 CompressedNum;
+	int64 CompressedRawBytes;
+	int64 CompressedWireBytes;
+	// bodies tried but sent raw, lz output was not smaller
+	int64 SkippedNum;
+	// bodies received compressed and their raw/wire bytes
+	int64 DecompressedNum;
+	int64 DecompressedRawBytes;
+	int64 DecompressedWireBytes;
+	// received lz bodies which failed to decompress
+	int64 DecompressFailedNum;
+
+	FServoCompressionStats();
+
+	// wire bytes per raw byte of sent bodies, 1 when nothing was compressed
+	float GetSendRatio() const;
+	// wire bytes per raw byte of received bodies, 1 when nothing was decompressed
+	float GetRecvRatio() const;
+};
+
 /**
  * the protocol of SeptemServo
  * singleton for handle pools
@@ -268,38 +622,148 @@ public:
 	// danger call, but fast
 	static FServoProtocol& SingletonRef();
 
-	// push recv packet into packet pool
-	bool Push(const TSharedPtr<FSNetPacket, ESPMode::ThreadSafe>& InNetPacket);
+	/**
+	 * push recv packet into packet pool
+	 * when shards are enabled the packet goes to the shard of its session instead
+	 * @param InRank		rank of pushing connection, shard key of packet without session
+	 */
+	bool Push(const FServoPacketRef& InNetPacket, int32 InRank = 0);
 	// pop from packet pool
-	bool Pop(TSharedPtr<FSNetPacket, ESPMode::ThreadSafe>& OutNetPacket);
+	bool Pop(FServoPacketRef& OutNetPacket);
+	// pop up to InMax packets, append to the end of OutNetPackets; return count popped
+	int32 PopBatch(TArray<FServoPacketRef>& OutNetPackets, int32 InMax);
+
+	/**
+	 * thread safe; block consumer until packet pool may have packets or timeout.
+	 * call it after Pop/PopBatch found the pool empty, a packet pushed in between is not missed.
+	 * without arrival event it sleeps WaitMs
+	 * @return true if woken by arrival
+	 */
+	bool WaitForPackets(uint32 WaitMs);
+	// auto reset event triggered when packet pool goes from empty to non-empty, nullptr when bArrivalEvent is false
+	FEvent* GetArrivalEvent();
+	// thread safe
 	int32 PacketPoolNum();
+	// thread safe; false if packet pool strategy is not LANES
+	bool GetPacketLaneStats(TArray<FNetPacketLaneStats>& OutStats);
+
+	/**
+	 * thread safe; true when readers should stop reading sockets
+	 * turns on at high watermark and off at low watermark
+	 */
+	bool IsBackpressure();
+
+	/**
+	 * thread safe; packets PushBatch can take before the packet pool is full, approximate.
+	 * readers decode no more frames than this, the rest stays in the recv slab.
+	 * LANES: room of the emptiest lane, packets of full lanes are kept by TryPushBatch
+	 * @return MAX_int32 for unbounded pool and shards
+	 */
+	int32 GetPushHeadroom();
+	// thread safe; packets dropped by PushBatch because the bounded pool was full
+	int64 GetPushDropCount();
+
+	// thread safe; lz totals of every packet written or decoded in this process
+	static void GetCompressionStats(FServoCompressionStats& OutStats);
+	// log GetCompressionStats with ratios
+	static void LogCompressionStats();
+
+	/**
+	 * push valid packets in order while their lane (or the pool) has room; return count pushed.
+	 * packets which don't fit stay in InOutNetPackets in order, push them again before newer packets.
+	 * shard queues are unbounded, they take all packets
+	 */
+	int32 TryPushBatch(TArray<FServoPacketRef>& InOutNetPackets, int32 InRank = 0);
+
+	/**
+	 * push all valid packets into packet pool, publish with one op; return count pushed
+	 * when shards are enabled packets go to the shard of their session instead
+	 * @param InRank		rank of pushing connection, shard key of packets without session
+	 */
+	int32 PushBatch(const TArray<FServoPacketRef>& InNetPackets, int32 InRank = 0);
+
+	/**
+	 * Decode whole frames of a recv buffer into packets.
+	 * packets are allocated from recycle pool with one lock, illegal packets are recycled with one lock.
+	 * @param Decoder		connection decoder, carries split frames
+	 * @param OutNetPackets	legal packets are appended
+	 * @param InSlab		slab which owns Data, nullptr to copy bodies
+	 * @param MaxPackets	stop after this count of frames
+	 * @return bytes consumed from Data
+	 */
+	int32 DecodeBatch(FServoFrameDecoder& Decoder, uint8* Data, int32 Length, TArray<FServoPacketRef>& OutNetPackets,
+		FSNetRecvSlab* InSlab = nullptr, int32 MaxPackets = SERVO_PROTOCOL_PACKET_POOL_MAX);
 
 	//=========================================
 	//		Net Packet Pool Memory Management
 	//=========================================
+	// recycle pool starts with Minnum packets, grows toward demand up to Maxnum; set before the singleton is created
 	static int32 RecyclePoolMaxnum;
+	static int32 RecyclePoolMinnum;
+	// SERVO_PROTOCOL_PACKET_POOL_QUEUE, _RING or _LANES, set before the singleton is created
+	static int32 PacketPoolStrategy;
+	// lanes of LANES strategy: heartbeat, control and bulk
+	static void GetDefaultPacketLanes(TArray<FNetPacketLaneConfig>& OutLanes);
+	// create arrival event for consumer threads; set before the singleton is created
+	static bool bArrivalEvent;
+	// count of per-session shards, 0 to use the shared packet pool; set before the singleton is created
+	// with shards, packets are consumed by shard handlers instead of Pop
+	static int32 ShardNum;
+	// nullptr when ShardNum is 0
+	FServoShards* GetShards();
 
 	// please call ReUse or set value manulity after recycle alloc
-	TSharedPtr<FSNetPacket, ESPMode::ThreadSafe> AllocNetPacket();
-	TSharedPtr<FSNetPacket, ESPMode::ThreadSafe> AllocHeartbeat();
-	// recycle dealloc
-	void DeallockNetPacket(const TSharedPtr<FSNetPacket, ESPMode::ThreadSafe>& InSharedPtr, bool bForceRecycle = false);
+	FServoPacketRef AllocNetPacket();
+	FServoPacketRef AllocHeartbeat();
+	// drop the reference now, packet is recycled when the last reference is dropped
+	void DeallockNetPacket(FServoPacketRef& InOutNetPacket);
 	int32 RecyclePoolNum();
 
+	/**
+	 * thread safe; grow/trim recycle pool and trim body allocator depots toward demand, call it from a housekeeping thread.
+	 * calls within SERVO_PROTOCOL_RECYCLE_MAINTAIN_INTERVAL are skipped
+	 */
+	void MaintainRecyclePool();
+	void GetRecyclePoolStats(Septem::FRecyclePoolStats& OutStats);
+
+	//=========================================
+	//		Recv Slab Memory Management
+	//=========================================
+
+	// thread safe; the slab holds one reference for the caller, call slab->Release() when parse done
+	FSNetRecvSlab* AllocRecvSlab();
+	int32 RecvSlabPoolNum();
+
 	//=========================================
 	//		Net Packet Pool & Recycle Pool Union Control
 	//=========================================
 
 	// pop from packetpool to OutRecyclePacket, auto recycle
-	bool PopWithRecycle(TSharedPtr<FSNetPacket, ESPMode::ThreadSafe>& OutRecyclePacket);
+	bool PopWithRecycle(FServoPacketRef& OutRecyclePacket);
 protected:
+	friend struct FSNetPacket;
+
+	// thread safe; called by the last FServoPacketRef of InPacket
+	void RecycleNetPacket(FSNetPacket* InPacket);
+
 	static FServoProtocol* pSingleton;
 	static FCriticalSection mCriticalSection;
 
 	int32 Syncword;
 
-	// force to push/pop TSharedPtr
-	TNetPacketPool<FSNetPacket, ESPMode::ThreadSafe>* PacketPool;
-	int32 PacketPoolCount;
-	Septem::TSharedRecyclePool<FSNetPacket, ESPMode::ThreadSafe> RecyclePool;
+	// force to push/pop packet refs
+	TNetPacketPool<FServoPacketRef>* PacketPool;
+	// PacketPool when strategy is LANES, or nullptr
+	TNetPacketLanes<FServoPacketRef>* PacketLanes;
+	// per-session shards, or nullptr
+	FServoShards* Shards;
+	FThreadSafeCounter PacketPoolCount;
+	FThreadSafeCounter64 PushDropCount;
+	FThreadSafeBool bBackpressure;
+	// triggered on empty to non-empty, or nullptr
+	FEvent* ArrivalEvent;
+	FServoRecyclePool RecyclePool;
+	FCriticalSection MaintainCriticalSection;
+	double LastMaintainTime;
+	FSNetRecvSlabPool RecvSlabPool;
 };
@@ -0,0 +1,175 @@
+// Copyright (c) 2013-2019 7Mersenne All Rights Reserved.
+
+#include "ServoShards.h"
+#include "../Threads/ShardWorkerThread.h"
+
+#include "Misc/ScopeLock.h"
+
+// spread sequential keys over shards, ranks step by listener shard count
+static FORCEINLINE uint32 MixShardKey(uint32 InKey)
+{
+	InKey ^= InKey >> 16;
+	InKey *= 0x85ebca6bu;
+	InKey ^= InKey >> 13;
+	InKey *= 0xc2b2ae35u;
+	InKey ^= InKey >> 16;
+	return InKey;
+}
+
+FServoShards::FServoShards(int32 InNumShards)
+{
+	const int32 numShards = FMath::Max(InNumShards, 1);
+	Shards.Reserve(numShards);
+	for (int32 i = 0; i < numShards; ++i)
+	{
+		FShard* shard = new FShard();
+		shard->Arrival = FPlatformProcess::GetSynchEventFromPool(false);
+		Shards.Add(shard);
+	}
+}
+
+FServoShards::~FServoShards()
+{
+	StopWorkers();
+	for (int32 i = 0; i < Shards.Num(); ++i)
+	{
+		FPlatformProcess::ReturnSynchEventToPool(Shards[i]->Arrival);
+		delete Shards[i];
+	}
+	Shards.Empty();
+}
+
+int32 FServoShards::NumShards() const
+{
+	return Shards.Num();
+}
+
+int32 FServoShards::ShardOf(const FSNetPacket & InPacket, int32 InRank) const
+{
+	const uint32 key = 0 != InPacket.sid ? (uint32)InPacket.sid : (uint32)InRank;
+	return (int32)(MixShardKey(key) % (uint32)Shards.Num());
+}
+
+bool FServoShards::Push(const FServoPacketRef& InNetPacket, int32 InRank)
+{
+	if (!InNetPacket.IsValid())
+		return false;
+
+	FShard& shard = *Shards[ShardOf(*InNetPacket, InRank)];
+	shard.Queue.Push(InNetPacket);
+	// wake the worker only on empty to non-empty
+	if (1 == shard.Count.Increment())
+	{
+		shard.Arrival->Trigger();
+	}
+	TotalCount.Increment();
+	return true;
+}
+
+int32 FServoShards::PushBatch(const TArray<FServoPacketRef>& InNetPackets, int32 InRank)
+{
+	int32 count = 0;
+	for (int32 i = 0; i < InNetPackets.Num(); ++i)
+	{
+		if (Push(InNetPackets[i], InRank))
+		{
+			++count;
+		}
+	}
+	return count;
+}
+
+bool FServoShards::RegisterHandler(int32 InShard, FServoShardHandler InHandler)
+{
+	if (!Shards.IsValidIndex(InShard))
+		return false;
+
+	FShard& shard = *Shards[InShard];
+	{
+		FScopeLock lockHandler(&shard.HandlerLock);
+		shard.Handler = MoveTemp(InHandler);
+	}
+
+	if (nullptr == shard.Worker)
+	{
+		shard.Worker = FShardWorkerThread::Create(this, InShard);
+	}
+	return nullptr != shard.Worker;
+}
+
+bool FServoShards::PopShard(int32 InShard, FServoPacketRef & OutNetPacket)
+{
+	if (!Shards.IsValidIndex(InShard))
+		return false;
+
+	FShard& shard = *Shards[InShard];
+	if (shard.Queue.Pop(OutNetPacket))
+	{
+		shard.Count.Decrement();
+		TotalCount.Decrement();
+		return true;
+	}
+	return false;
+}
+
+int32 FServoShards::DrainShard(int32 InShard, int32 InMax)
+{
+	FShard& shard = *Shards[InShard];
+	FScopeLock lockHandler(&shard.HandlerLock);
+	if (!shard.Handler)
+		return 0;
+
+	int32 count = 0;
+	FServoPacketRef packet;
+	while (count < InMax && shard.Queue.Pop(packet))
+	{
+		shard.Count.Decrement();
+		TotalCount.Decrement();
+		shard.Handler(InShard, packet);
+		// recycle as soon as handled
+		packet.Reset();
+		++count;
+	}
+	return count;
+}
+
+bool FServoShards::WaitShard(int32 InShard, uint32 InWaitMs)
+{
+	if (!Shards.IsValidIndex(InShard))
+		return false;
+
+	// auto reset event keeps a trigger without waiter, so an arrival before Wait is not lost
+	return Shards[InShard]->Arrival->Wait(InWaitMs);
+}
+
+void FServoShards::WakeShard(int32 InShard)
+{
+	if (Shards.IsValidIndex(InShard))
+	{
+		Shards[InShard]->Arrival->Trigger();
+	}
+}
+
+int32 FServoShards::ShardPacketNum(int32 InShard) const
+{
+	return Shards.IsValidIndex(InShard) ? Shards[InShard]->Count.GetValue() : 0;
+}
+
+int32 FServoShards::Num() const
+{
+	return TotalCount.GetValue();
+}
+
+void FServoShards::StopWorkers()
+{
+	for (int32 i = 0; i < Shards.Num(); ++i)
+	{
+		FShard& shard = *Shards[i];
+		if (shard.Worker)
+		{
+			shard.Worker->KillThread();
+			delete shard.Worker;
+			shard.Worker = nullptr;
+		}
+	}
+}
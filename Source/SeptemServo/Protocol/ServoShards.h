@@ -0,0 +1,123 @@
+// Copyright (c) 2013-2019 7Mersenne All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/ThreadSafeCounter.h"
+#include "HAL/Event.h"
+#include "ServoProtocol.h"
+
+class FShardWorkerThread;
+
+/*
+* Max packets handled by a shard worker before it checks for stop
+*/
+#ifndef SERVO_PROTOCOL_SHARD_DRAIN_MAX
+#define SERVO_PROTOCOL_SHARD_DRAIN_MAX 256
+#endif // !SERVO_PROTOCOL_SHARD_DRAIN_MAX
+
+/*
+* Max milliseconds an idle shard worker blocks before it checks for stop
+* workers are woken by packet arrival, this only bounds stop latency
+*/
+#ifndef SERVO_PROTOCOL_SHARD_WAIT_MS
+#define SERVO_PROTOCOL_SHARD_WAIT_MS 50
+#endif // !SERVO_PROTOCOL_SHARD_WAIT_MS
+
+/************************************************************/
+/*
+		Help
+		// set before FServoProtocol singleton is created
+		FServoProtocol::ShardNum = 8;
+
+		// handler runs on the worker of its shard, packets of one session keep order
+		FServoShards* shards = FServoProtocol::Get()->GetShards();
+		for (int32 i = 0; i < shards->NumShards(); ++i)
+		{
+			shards->RegisterHandler(i, [](int32 InShard, const FServoPacketRef& InPacket)
+			{
+				// handle packet
+			});
+		}
+*/
+/************************************************************/
+
+// called on shard worker thread, once per packet in push order
+typedef TFunction<void(int32, const FServoPacketRef&)> FServoShardHandler;
+
+/**
+ * packet queues sharded by session
+ * shard = hash(sid) when client set a session, else hash(connection rank).
+ * each shard is an MPSC queue drained by its own worker thread,
+ * packets of one session keep order while sessions run in parallel.
+ * thread safe
+ */
+class SEPTEMSERVO_API FServoShards
+{
+public:
+	FServoShards(int32 InNumShards);
+	~FServoShards();
+
+	int32 NumShards() const;
+
+	// shard of packet pushed by connection InRank
+	int32 ShardOf(const FSNetPacket& InPacket, int32 InRank) const;
+
+	// push one valid packet to its shard; false if packet is invalid
+	bool Push(const FServoPacketRef& InNetPacket, int32 InRank);
+
+	/**
+	 * Push valid packets to their shards, one connection thread per rank keeps order.
+	 * @return count pushed
+	 */
+	int32 PushBatch(const TArray<FServoPacketRef>& InNetPackets, int32 InRank);
+
+	/**
+	 * Set handler of shard and start its worker.
+	 * a shard without handler keeps packets until a handler is registered or PopShard drains it
+	 * @return false when shard index is illegal or worker can't start
+	 */
+	bool RegisterHandler(int32 InShard, FServoShardHandler InHandler);
+
+	// pop one packet of a shard without handler, single consumer per shard
+	bool PopShard(int32 InShard, FServoPacketRef& OutNetPacket);
+
+	// called by shard worker: pop up to InMax packets and call handler, return count handled
+	int32 DrainShard(int32 InShard, int32 InMax = SERVO_PROTOCOL_SHARD_DRAIN_MAX);
+
+	/**
+	 * called by shard worker: block until a packet arrives in the shard, WakeShard or timeout
+	 * @return true if woken
+	 */
+	bool WaitShard(int32 InShard, uint32 InWaitMs = SERVO_PROTOCOL_SHARD_WAIT_MS);
+	// wake the worker of a shard, used to stop it
+	void WakeShard(int32 InShard);
+
+	// packets waiting in one shard / all shards
+	int32 ShardPacketNum(int32 InShard) const;
+	int32 Num() const;
+
+	// stop and delete all workers, handlers are kept
+	void StopWorkers();
+
+private:
+	struct FShard
+	{
+		TNetPacketQueue<FServoPacketRef> Queue;
+		FThreadSafeCounter Count;
+		FCriticalSection HandlerLock;
+		FServoShardHandler Handler;
+		FShardWorkerThread* Worker;
+		// auto reset, triggered when the shard goes from empty to non-empty
+		FEvent* Arrival;
+
+		FShard()
+			: Worker(nullptr)
+			, Arrival(nullptr)
+		{
+		}
+	};
+
+	TArray<FShard*> Shards;
+	FThreadSafeCounter TotalCount;
+};
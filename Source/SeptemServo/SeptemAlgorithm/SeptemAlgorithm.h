@@ -3,7 +3,13 @@
 #pragma once
 
 #include "SeptemBuffer.h"
+#include "SeptemRecyclePoolSizer.h"
 #include "SeptemRecyclePool.hpp"
+#include "SeptemLockFreeRecyclePool.hpp"
+#include "SeptemMagazineRecyclePool.hpp"
+#include "SeptemSizeClassAllocator.h"
+#include "SeptemChecksum.h"
+#include "SeptemCompress.h"
 
 namespace Septem
 {
@@ -1,3 +1,316 @@
 // Copyright (c) 2013-2019 7Mersenne All Rights Reserved.
 
-#include "SeptemBuffer.h"
\ No newline at end of file
+#include "SeptemBuffer.h"
+
+#if SEPTEM_SIMD_X86
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#include <immintrin.h>
+#endif
+
+namespace Septem
+{
+#if SEPTEM_SIMD_X86
+	static void CpuidEx(uint32 Leaf, uint32 SubLeaf, uint32 OutRegs[4])
+	{
+#if defined(_MSC_VER)
+		int32 regs[4];
+		__cpuidex(regs, (int32)Leaf, (int32)SubLeaf);
+		for (int32 i = 0; i < 4; ++i)
+		{
+			OutRegs[i] = (uint32)regs[i];
+		}
+#else
+		__cpuid_count(Leaf, SubLeaf, OutRegs[0], OutRegs[1], OutRegs[2], OutRegs[3]);
+#endif
+	}
+
+	static uint64 XGetBV0()
+	{
+#if defined(_MSC_VER)
+		return _xgetbv(0);
+#else
+		uint32 eax = 0;
+		uint32 edx = 0;
+		__asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+		return ((uint64)edx << 32) | eax;
+#endif
+	}
+#endif // SEPTEM_SIMD_X86
+
+	static FCpuFeatures DetectCpuFeatures()
+	{
+		FCpuFeatures features;
+		features.bSSE2 = false;
+		features.bSSE42 = false;
+		features.bAVX2 = false;
+
+#if SEPTEM_SIMD_X86
+		uint32 regs[4] = { 0 };
+		CpuidEx(0, 0, regs);
+		const uint32 maxLeaf = regs[0];
+
+		if (maxLeaf >= 1)
+		{
+			CpuidEx(1, 0, regs);
+			features.bSSE2 = (regs[3] & (1u << 26)) != 0;
+			features.bSSE42 = (regs[2] & (1u << 20)) != 0;
+
+			// ymm registers must be saved by os: OSXSAVE + AVX + xcr0 sse/avx state
+			const bool bOSXSave = (regs[2] & (1u << 27)) != 0;
+			const bool bAVX = (regs[2] & (1u << 28)) != 0;
+			const bool bYmmState = bOSXSave && (XGetBV0() & 0x6) == 0x6;
+
+			if (maxLeaf >= 7 && bAVX && bYmmState)
+			{
+				CpuidEx(7, 0, regs);
+				features.bAVX2 = (regs[1] & (1u << 5)) != 0;
+			}
+		}
+#endif // SEPTEM_SIMD_X86
+
+		return features;
+	}
+
+	const FCpuFeatures & FCpuFeatures::Get()
+	{
+		static const FCpuFeatures features = DetectCpuFeatures();
+		return features;
+	}
+
+	// finish simd scan with the scalar loop, index is the first unchecked offset
+	static FORCEINLINE int32 SyncwordScanTail(const uint8* Buffer, int32 BufferSize, int32 Syncword, int32 index)
+	{
+		const int32 tail = BufferBufferSyncwordScalar(Buffer + index, BufferSize - index, Syncword);
+		return tail < 0 ? -1 : index + tail;
+	}
+
+	int32 BufferBufferSyncwordSSE2(const uint8 * Buffer, int32 BufferSize, int32 Syncword)
+	{
+#if SEPTEM_SIMD_X86
+		uint8 sync[4];
+		FMemory::Memcpy(sync, &Syncword, sizeof(int32));
+
+		const __m128i sync0 = _mm_set1_epi8((char)sync[0]);
+		const __m128i sync1 = _mm_set1_epi8((char)sync[1]);
+		const __m128i sync2 = _mm_set1_epi8((char)sync[2]);
+		const __m128i sync3 = _mm_set1_epi8((char)sync[3]);
+
+		int32 index = 0;
+		// one block checks offsets [index, index + 16), reads bytes up to index + 19
+		while (index + 19 <= BufferSize)
+		{
+			const uint8* ptr = Buffer + index;
+			__m128i eq = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(ptr)), sync0);
+			eq = _mm_and_si128(eq, _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(ptr + 1)), sync1));
+			eq = _mm_and_si128(eq, _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(ptr + 2)), sync2));
+			eq = _mm_and_si128(eq, _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(ptr + 3)), sync3));
+
+			const uint32 mask = (uint32)_mm_movemask_epi8(eq);
+			if (mask)
+			{
+				return index + (int32)FMath::CountTrailingZeros(mask);
+			}
+			index += 16;
+		}
+
+		return SyncwordScanTail(Buffer, BufferSize, Syncword, index);
+#else
+		return BufferBufferSyncwordScalar(Buffer, BufferSize, Syncword);
+#endif // SEPTEM_SIMD_X86
+	}
+
+	SEPTEM_TARGET_AVX2 int32 BufferBufferSyncwordAVX2(const uint8 * Buffer, int32 BufferSize, int32 Syncword)
+	{
+#if SEPTEM_SIMD_X86
+		uint8 sync[4];
+		FMemory::Memcpy(sync, &Syncword, sizeof(int32));
+
+		const __m256i sync0 = _mm256_set1_epi8((char)sync[0]);
+		const __m256i sync1 = _mm256_set1_epi8((char)sync[1]);
+		const __m256i sync2 = _mm256_set1_epi8((char)sync[2]);
+		const __m256i sync3 = _mm256_set1_epi8((char)sync[3]);
+
+		int32 index = 0;
+		// one block checks offsets [index, index + 32), reads bytes up to index + 35
+		while (index + 35 <= BufferSize)
+		{
+			const uint8* ptr = Buffer + index;
+			__m256i eq = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(ptr)), sync0);
+			eq = _mm256_and_si256(eq, _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(ptr + 1)), sync1));
+			eq = _mm256_and_si256(eq, _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(ptr + 2)), sync2));
+			eq = _mm256_and_si256(eq, _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(ptr + 3)), sync3));
+
+			const uint32 mask = (uint32)_mm256_movemask_epi8(eq);
+			if (mask)
+			{
+				return index + (int32)FMath::CountTrailingZeros(mask);
+			}
+			index += 32;
+		}
+
+		return SyncwordScanTail(Buffer, BufferSize, Syncword, index);
+#else
+		return BufferBufferSyncwordScalar(Buffer, BufferSize, Syncword);
+#endif // SEPTEM_SIMD_X86
+	}
+
+	typedef int32(*FSyncwordKernel)(const uint8*, int32, int32);
+
+	static FSyncwordKernel SelectSyncwordKernel()
+	{
+		const FCpuFeatures& features = FCpuFeatures::Get();
+		if (features.bAVX2)
+		{
+			return &BufferBufferSyncwordAVX2;
+		}
+		if (features.bSSE2)
+		{
+			return &BufferBufferSyncwordSSE2;
+		}
+		return &BufferBufferSyncwordScalar;
+	}
+
+	int32 BufferBufferSyncword(const uint8 * Buffer, int32 BufferSize, int32 Syncword)
+	{
+		static const FSyncwordKernel kernel = SelectSyncwordKernel();
+		return kernel(Buffer, BufferSize, Syncword);
+	}
+
+#if SEPTEM_SIMD_X86
+	static FORCEINLINE uint64 FoldLane128(__m128i lane)
+	{
+		lane = _mm_xor_si128(lane, _mm_srli_si128(lane, 8));
+		uint64 value;
+		_mm_storel_epi64((__m128i*)&value, lane);
+		return value;
+	}
+
+	SEPTEM_TARGET_AVX2 static FORCEINLINE uint64 FoldLane256(__m256i lane)
+	{
+		return FoldLane128(_mm_xor_si128(_mm256_castsi256_si128(lane), _mm256_extracti128_si256(lane, 1)));
+	}
+#endif // SEPTEM_SIMD_X86
+
+	static FORCEINLINE uint8 FoldLane64(uint64 lane)
+	{
+		lane ^= lane >> 32;
+		lane ^= lane >> 16;
+		lane ^= lane >> 8;
+		return (uint8)lane;
+	}
+
+	uint8 BufferXORSSE2(const uint8 * Buffer, int32 Length)
+	{
+#if SEPTEM_SIMD_X86
+		__m128i lane = _mm_setzero_si128();
+		int32 index = 0;
+		for (; index + 16 <= Length; index += 16)
+		{
+			lane = _mm_xor_si128(lane, _mm_loadu_si128((const __m128i*)(Buffer + index)));
+		}
+
+		return FoldLane64(FoldLane128(lane)) ^ BufferXORScalar(Buffer + index, Length - index);
+#else
+		return BufferXORScalar(Buffer, Length);
+#endif // SEPTEM_SIMD_X86
+	}
+
+	SEPTEM_TARGET_AVX2 uint8 BufferXORAVX2(const uint8 * Buffer, int32 Length)
+	{
+#if SEPTEM_SIMD_X86
+		__m256i lane = _mm256_setzero_si256();
+		int32 index = 0;
+		for (; index + 32 <= Length; index += 32)
+		{
+			lane = _mm256_xor_si256(lane, _mm256_loadu_si256((const __m256i*)(Buffer + index)));
+		}
+
+		return FoldLane64(FoldLane256(lane)) ^ BufferXORScalar(Buffer + index, Length - index);
+#else
+		return BufferXORScalar(Buffer, Length);
+#endif // SEPTEM_SIMD_X86
+	}
+
+	uint8 BufferCopyXORSSE2(uint8 * Dst, const uint8 * Src, int32 Length)
+	{
+#if SEPTEM_SIMD_X86
+		__m128i lane = _mm_setzero_si128();
+		int32 index = 0;
+		for (; index + 16 <= Length; index += 16)
+		{
+			const __m128i value = _mm_loadu_si128((const __m128i*)(Src + index));
+			_mm_storeu_si128((__m128i*)(Dst + index), value);
+			lane = _mm_xor_si128(lane, value);
+		}
+
+		return FoldLane64(FoldLane128(lane)) ^ BufferCopyXORScalar(Dst + index, Src + index, Length - index);
+#else
+		return BufferCopyXORScalar(Dst, Src, Length);
+#endif // SEPTEM_SIMD_X86
+	}
+
+	SEPTEM_TARGET_AVX2 uint8 BufferCopyXORAVX2(uint8 * Dst, const uint8 * Src, int32 Length)
+	{
+#if SEPTEM_SIMD_X86
+		__m256i lane = _mm256_setzero_si256();
+		int32 index = 0;
+		for (; index + 32 <= Length; index += 32)
+		{
+			const __m256i value = _mm256_loadu_si256((const __m256i*)(Src + index));
+			_mm256_storeu_si256((__m256i*)(Dst + index), value);
+			lane = _mm256_xor_si256(lane, value);
+		}
+
+		return FoldLane64(FoldLane256(lane)) ^ BufferCopyXORScalar(Dst + index, Src + index, Length - index);
+#else
+		return BufferCopyXORScalar(Dst, Src, Length);
+#endif // SEPTEM_SIMD_X86
+	}
+
+	typedef uint8(*FXORKernel)(const uint8*, int32);
+	typedef uint8(*FCopyXORKernel)(uint8*, const uint8*, int32);
+
+	static FXORKernel SelectXORKernel()
+	{
+		const FCpuFeatures& features = FCpuFeatures::Get();
+		if (features.bAVX2)
+		{
+			return &BufferXORAVX2;
+		}
+		if (features.bSSE2)
+		{
+			return &BufferXORSSE2;
+		}
+		return &BufferXORScalar;
+	}
+
+	static FCopyXORKernel SelectCopyXORKernel()
+	{
+		const FCpuFeatures& features = FCpuFeatures::Get();
+		if (features.bAVX2)
+		{
+			return &BufferCopyXORAVX2;
+		}
+		if (features.bSSE2)
+		{
+			return &BufferCopyXORSSE2;
+		}
+		return &BufferCopyXORScalar;
+	}
+
+	uint8 BufferXOR(const uint8 * Buffer, int32 Length)
+	{
+		static const FXORKernel kernel = SelectXORKernel();
+		return kernel(Buffer, Length);
+	}
+
+	uint8 BufferCopyXOR(uint8 * Dst, const uint8 * Src, int32 Length)
+	{
+		static const FCopyXORKernel kernel = SelectCopyXORKernel();
+		return kernel(Dst, Src, Length);
+	}
+}
@@ -4,8 +4,35 @@
 
 #include "CoreMinimal.h"
 
+// simd kernels are only built for x86/x64
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define SEPTEM_SIMD_X86 1
+#else
+#define SEPTEM_SIMD_X86 0
+#endif
+
+// gcc/clang need target attributes to emit instructions above the module baseline
+#if SEPTEM_SIMD_X86 && !defined(_MSC_VER)
+#define SEPTEM_TARGET_SSE42 __attribute__((target("sse4.2")))
+#define SEPTEM_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define SEPTEM_TARGET_SSE42
+#define SEPTEM_TARGET_AVX2
+#endif
+
 namespace Septem
 {
+	// cpu features, detected once by cpuid
+	struct SEPTEMSERVO_API FCpuFeatures
+	{
+		bool bSSE2;
+		bool bSSE42;
+		bool bAVX2; // include os support for ymm state
+
+		// thread safe
+		static const FCpuFeatures& Get();
+	};
+
 	// Get Fail Array 
 	// like getnext in KMP
 	// private call for BufferBuffer
@@ -94,15 +121,18 @@ namespace Septem
 	}
 
 	// find the first syncword index in buffer
-	// return -1 or BufferSize when failed
-	static int32 BufferBufferSyncword(uint8* Buffer, int32 BufferSize, int32 Syncword)
+	// byte-at-a-time reference loop, used as fallback and for the tail of simd scan
+	// return -1 when failed
+	static int32 BufferBufferSyncwordScalar(const uint8* Buffer, int32 BufferSize, int32 Syncword)
 	{
 		int32 index = 0;
+		// the last possible syncword begins at BufferSize - 4
 		int32 maxdex = BufferSize - 4;
-		while (index < maxdex)
+		while (index <= maxdex)
 		{
-			int32* ptr = (int32*)(Buffer + index);
-			if (*ptr == Syncword)
+			int32 value;
+			FMemory::Memcpy(&value, Buffer + index, sizeof(int32));
+			if (value == Syncword)
 				return index;
 
 			++index;
@@ -110,5 +140,82 @@ namespace Septem
 
 		return -1;
 	}
+
+	// simd kernels for syncword scan, compare 16/32 offsets per instruction
+	// call BufferBufferSyncword instead, it selects the kernel by cpuid
+	SEPTEMSERVO_API int32 BufferBufferSyncwordSSE2(const uint8* Buffer, int32 BufferSize, int32 Syncword);
+	SEPTEMSERVO_API int32 BufferBufferSyncwordAVX2(const uint8* Buffer, int32 BufferSize, int32 Syncword);
+
+	// find the first syncword index in buffer
+	// AVX2 / SSE2 / scalar kernel selected at runtime
+	// return -1 when failed
+	SEPTEMSERVO_API int32 BufferBufferSyncword(const uint8* Buffer, int32 BufferSize, int32 Syncword);
+
+	// xor of all bytes, folded from 8 byte lanes
+	// scalar kernel, used as fallback and for the tail of simd kernels
+	static uint8 BufferXORScalar(const uint8* Buffer, int32 Length)
+	{
+		uint64 lane = 0;
+		int32 index = 0;
+		for (; index + 8 <= Length; index += 8)
+		{
+			uint64 value;
+			FMemory::Memcpy(&value, Buffer + index, sizeof(uint64));
+			lane ^= value;
+		}
+
+		uint8 ret = 0;
+		for (; index < Length; ++index)
+		{
+			ret ^= Buffer[index];
+		}
+
+		lane ^= lane >> 32;
+		lane ^= lane >> 16;
+		lane ^= lane >> 8;
+		return ret ^ (uint8)lane;
+	}
+
+	// copy Src to Dst and return xor of all bytes in one pass
+	// scalar kernel, used as fallback and for the tail of simd kernels
+	static uint8 BufferCopyXORScalar(uint8* Dst, const uint8* Src, int32 Length)
+	{
+		uint64 lane = 0;
+		int32 index = 0;
+		for (; index + 8 <= Length; index += 8)
+		{
+			uint64 value;
+			FMemory::Memcpy(&value, Src + index, sizeof(uint64));
+			FMemory::Memcpy(Dst + index, &value, sizeof(uint64));
+			lane ^= value;
+		}
+
+		uint8 ret = 0;
+		for (; index < Length; ++index)
+		{
+			Dst[index] = Src[index];
+			ret ^= Src[index];
+		}
+
+		lane ^= lane >> 32;
+		lane ^= lane >> 16;
+		lane ^= lane >> 8;
+		return ret ^ (uint8)lane;
+	}
+
+	// simd kernels for xor fastcode, 16/32 byte lanes folded down to one byte
+	// call BufferXOR / BufferCopyXOR instead, they select the kernel by cpuid
+	SEPTEMSERVO_API uint8 BufferXORSSE2(const uint8* Buffer, int32 Length);
+	SEPTEMSERVO_API uint8 BufferXORAVX2(const uint8* Buffer, int32 Length);
+	SEPTEMSERVO_API uint8 BufferCopyXORSSE2(uint8* Dst, const uint8* Src, int32 Length);
+	SEPTEMSERVO_API uint8 BufferCopyXORAVX2(uint8* Dst, const uint8* Src, int32 Length);
+
+	// xor of all bytes
+	// AVX2 / SSE2 / scalar kernel selected at runtime
+	SEPTEMSERVO_API uint8 BufferXOR(const uint8* Buffer, int32 Length);
+
+	// copy Src to Dst and return xor of all bytes, one memory traversal
+	// AVX2 / SSE2 / scalar kernel selected at runtime
+	SEPTEMSERVO_API uint8 BufferCopyXOR(uint8* Dst, const uint8* Src, int32 Length);
 }
 
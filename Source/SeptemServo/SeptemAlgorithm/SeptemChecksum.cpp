@@ -0,0 +1,126 @@
+// Copyright (c) 2013-2019 7Mersenne All Rights Reserved.
+
+#include "SeptemChecksum.h"
+
+#if SEPTEM_SIMD_X86
+#include <nmmintrin.h>
+#endif
+
+namespace Septem
+{
+	// reflected castagnoli polynomial
+	static const uint32 Crc32cPoly = 0x82F63B78u;
+
+	struct FCrc32cTables
+	{
+		uint32 Table[8][256];
+
+		FCrc32cTables()
+		{
+			for (uint32 i = 0; i < 256; ++i)
+			{
+				uint32 crc = i;
+				for (int32 k = 0; k < 8; ++k)
+				{
+					crc = (crc & 1) ? (crc >> 1) ^ Crc32cPoly : crc >> 1;
+				}
+				Table[0][i] = crc;
+			}
+
+			for (uint32 i = 0; i < 256; ++i)
+			{
+				for (int32 t = 1; t < 8; ++t)
+				{
+					Table[t][i] = (Table[t - 1][i] >> 8) ^ Table[0][Table[t - 1][i] & 0xFF];
+				}
+			}
+		}
+	};
+
+	static const FCrc32cTables& GetCrc32cTables()
+	{
+		static const FCrc32cTables tables;
+		return tables;
+	}
+
+	uint32 Crc32cSlicing8(const uint8 * Buffer, int32 Length, uint32 InCrc)
+	{
+		const FCrc32cTables& tables = GetCrc32cTables();
+		uint32 crc = ~InCrc;
+		int32 index = 0;
+
+		for (; index + 8 <= Length; index += 8)
+		{
+			uint32 low;
+			uint32 high;
+			FMemory::Memcpy(&low, Buffer + index, sizeof(uint32));
+			FMemory::Memcpy(&high, Buffer + index + 4, sizeof(uint32));
+#if !PLATFORM_LITTLE_ENDIAN
+			low = ByteSwap(low);
+			high = ByteSwap(high);
+#endif
+			low ^= crc;
+			crc = tables.Table[7][low & 0xFF] ^ tables.Table[6][(low >> 8) & 0xFF]
+				^ tables.Table[5][(low >> 16) & 0xFF] ^ tables.Table[4][low >> 24]
+				^ tables.Table[3][high & 0xFF] ^ tables.Table[2][(high >> 8) & 0xFF]
+				^ tables.Table[1][(high >> 16) & 0xFF] ^ tables.Table[0][high >> 24];
+		}
+
+		for (; index < Length; ++index)
+		{
+			crc = (crc >> 8) ^ tables.Table[0][(crc ^ Buffer[index]) & 0xFF];
+		}
+
+		return ~crc;
+	}
+
+	SEPTEM_TARGET_SSE42 uint32 Crc32cSSE42(const uint8 * Buffer, int32 Length, uint32 InCrc)
+	{
+#if SEPTEM_SIMD_X86
+		int32 index = 0;
+#if defined(_M_X64) || defined(__x86_64__)
+		uint64 crc64 = ~InCrc;
+		for (; index + 8 <= Length; index += 8)
+		{
+			uint64 value;
+			FMemory::Memcpy(&value, Buffer + index, sizeof(uint64));
+			crc64 = _mm_crc32_u64(crc64, value);
+		}
+		uint32 crc = (uint32)crc64;
+#else
+		uint32 crc = ~InCrc;
+		for (; index + 4 <= Length; index += 4)
+		{
+			uint32 value;
+			FMemory::Memcpy(&value, Buffer + index, sizeof(uint32));
+			crc = _mm_crc32_u32(crc, value);
+		}
+#endif
+		for (; index < Length; ++index)
+		{
+			crc = _mm_crc32_u8(crc, Buffer[index]);
+		}
+
+		return ~crc;
+#else
+		return Crc32cSlicing8(Buffer, Length, InCrc);
+#endif // SEPTEM_SIMD_X86
+	}
+
+	typedef uint32(*FCrc32cKernel)(const uint8*, int32, uint32);
+
+	static FCrc32cKernel SelectCrc32cKernel()
+	{
+		if (FCpuFeatures::Get().bSSE42)
+		{
+			return &Crc32cSSE42;
+		}
+		return &Crc32cSlicing8;
+	}
+
+	uint32 Crc32c(const uint8 * Buffer, int32 Length, uint32 InCrc)
+	{
+		static const FCrc32cKernel kernel = SelectCrc32cKernel();
+		return kernel(Buffer, Length, InCrc);
+	}
+}
@@ -0,0 +1,21 @@
+// Copyright (c) 2013-2019 7Mersenne All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "SeptemBuffer.h"
+
+namespace Septem
+{
+	// crc32c (castagnoli) slicing-by-8 kernel, fallback without sse4.2
+	SEPTEMSERVO_API uint32 Crc32cSlicing8(const uint8* Buffer, int32 Length, uint32 InCrc = 0);
+
+	// crc32c kernel with sse4.2 crc32 instruction
+	// call Crc32c instead, it selects the kernel by cpuid
+	SEPTEMSERVO_API uint32 Crc32cSSE42(const uint8* Buffer, int32 Length, uint32 InCrc = 0);
+
+	// crc32c of buffer
+	// chain a split buffer by passing the crc of previous part as InCrc:
+	// Crc32c(B, Blen, Crc32c(A, Alen)) == Crc32c(A + B)
+	SEPTEMSERVO_API uint32 Crc32c(const uint8* Buffer, int32 Length, uint32 InCrc = 0);
+}
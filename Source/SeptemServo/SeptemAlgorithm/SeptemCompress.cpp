@@ -0,0 +1,208 @@
+// Copyright (c) 2013-2019 7Mersenne All Rights Reserved.
+
+#include "SeptemCompress.h"
+
+namespace Septem
+{
+	static const int32 LZMinMatch = 4;
+	// last bytes are always literals
+	static const int32 LZLastLiterals = 5;
+	// last match must begin before this count of bytes from the end
+	static const int32 LZMatchFindLimit = 12;
+	static const int32 LZMaxOffset = 65535;
+	static const int32 LZHashLog = 12;
+
+	static FORCEINLINE uint32 LZRead32(const uint8* Ptr)
+	{
+		uint32 value;
+		FMemory::Memcpy(&value, Ptr, sizeof(uint32));
+		return value;
+	}
+
+	static FORCEINLINE uint32 LZHash(uint32 Sequence)
+	{
+		return (Sequence * 2654435761u) >> (32 - LZHashLog);
+	}
+
+	// write length over 15 as 255 bytes run
+	static FORCEINLINE bool LZWriteLength(uint8*& Op, const uint8* OpEnd, int32 Length)
+	{
+		for (; Length >= 255; Length -= 255)
+		{
+			if (Op >= OpEnd)
+				return false;
+			*Op++ = 255;
+		}
+		if (Op >= OpEnd)
+			return false;
+		*Op++ = (uint8)Length;
+		return true;
+	}
+
+	// one sequence: token, literals, (offset, match length)
+	static bool LZWriteSequence(uint8*& Op, const uint8* OpEnd, const uint8* Literals, int32 LiteralLength, int32 Offset, int32 MatchLength)
+	{
+		if (Op >= OpEnd)
+			return false;
+
+		uint8* token = Op++;
+		*token = (uint8)(FMath::Min(LiteralLength, 15) << 4);
+		if (LiteralLength >= 15 && !LZWriteLength(Op, OpEnd, LiteralLength - 15))
+			return false;
+
+		if (Op + LiteralLength > OpEnd)
+			return false;
+		FMemory::Memcpy(Op, Literals, LiteralLength);
+		Op += LiteralLength;
+
+		if (MatchLength == 0)
+		{
+			// last sequence has literals only
+			return true;
+		}
+
+		if (Op + 2 > OpEnd)
+			return false;
+		*Op++ = (uint8)(Offset & 0xFF);
+		*Op++ = (uint8)(Offset >> 8);
+
+		const int32 matchCode = MatchLength - LZMinMatch;
+		*token |= (uint8)FMath::Min(matchCode, 15);
+		if (matchCode >= 15 && !LZWriteLength(Op, OpEnd, matchCode - 15))
+			return false;
+
+		return true;
+	}
+
+	int32 LZCompress(const uint8 * Src, int32 SrcLength, uint8 * Dst, int32 DstCapacity)
+	{
+		if (SrcLength < 0 || DstCapacity <= 0)
+			return 0;
+
+		int32 hashTable[1 << LZHashLog];
+		for (int32 i = 0; i < (1 << LZHashLog); ++i)
+		{
+			hashTable[i] = -LZMaxOffset - 1;
+		}
+
+		uint8* op = Dst;
+		const uint8* opEnd = Dst + DstCapacity;
+		int32 ip = 0;
+		int32 anchor = 0;
+		const int32 matchLimit = SrcLength - LZLastLiterals;
+
+		while (ip < SrcLength - LZMatchFindLimit)
+		{
+			const uint32 sequence = LZRead32(Src + ip);
+			const uint32 hash = LZHash(sequence);
+			const int32 ref = hashTable[hash];
+			hashTable[hash] = ip;
+
+			if (ip - ref > LZMaxOffset || LZRead32(Src + ref) != sequence)
+			{
+				// skip faster on incompressible data
+				ip += 1 + ((ip - anchor) >> 6);
+				continue;
+			}
+
+			int32 matchLength = LZMinMatch;
+			while (ip + matchLength < matchLimit && Src[ref + matchLength] == Src[ip + matchLength])
+			{
+				++matchLength;
+			}
+
+			if (!LZWriteSequence(op, opEnd, Src + anchor, ip - anchor, ip - ref, matchLength))
+				return 0;
+
+			ip += matchLength;
+			anchor = ip;
+		}
+
+		if (!LZWriteSequence(op, opEnd, Src + anchor, SrcLength - anchor, 0, 0))
+			return 0;
+
+		return (int32)(op - Dst);
+	}
+
+	// read length over 15 from 255 bytes run
+	static FORCEINLINE bool LZReadLength(const uint8*& Ip, const uint8* IpEnd, int32& Length)
+	{
+		uint8 value;
+		do
+		{
+			if (Ip >= IpEnd)
+				return false;
+			value = *Ip++;
+			Length += value;
+			if (Length < 0)
+				return false;
+		} while (value == 255);
+		return true;
+	}
+
+	int32 LZDecompress(const uint8 * Src, int32 SrcLength, uint8 * Dst, int32 DstCapacity)
+	{
+		if (SrcLength <= 0 || DstCapacity < 0)
+			return -1;
+
+		const uint8* ip = Src;
+		const uint8* ipEnd = Src + SrcLength;
+		uint8* op = Dst;
+		const uint8* opEnd = Dst + DstCapacity;
+
+		while (true)
+		{
+			const uint8 token = *ip++;
+
+			// 1. literals
+			int32 literalLength = token >> 4;
+			if (literalLength == 15 && !LZReadLength(ip, ipEnd, literalLength))
+				return -1;
+			if (literalLength > ipEnd - ip || literalLength > opEnd - op)
+				return -1;
+			FMemory::Memcpy(op, ip, literalLength);
+			ip += literalLength;
+			op += literalLength;
+
+			if (ip == ipEnd)
+			{
+				// last sequence
+				break;
+			}
+
+			// 2. match
+			if (ipEnd - ip < 2)
+				return -1;
+			const int32 offset = ip[0] | (ip[1] << 8);
+			ip += 2;
+			if (offset == 0 || offset > op - Dst)
+				return -1;
+
+			int32 matchLength = token & 15;
+			if (matchLength == 15 && !LZReadLength(ip, ipEnd, matchLength))
+				return -1;
+			matchLength += LZMinMatch;
+			if (matchLength > opEnd - op)
+				return -1;
+
+			const uint8* match = op - offset;
+			if (offset >= matchLength)
+			{
+				FMemory::Memcpy(op, match, matchLength);
+				op += matchLength;
+			}
+			else {
+				// overlapped copy repeats the pattern
+				for (int32 i = 0; i < matchLength; ++i)
+				{
+					*op++ = *match++;
+				}
+			}
+
+			if (ip >= ipEnd)
+				return -1;
+		}
+
+		return (int32)(op - Dst);
+	}
+}
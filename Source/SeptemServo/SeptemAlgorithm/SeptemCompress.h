@@ -0,0 +1,27 @@
+// Copyright (c) 2013-2019 7Mersenne All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+namespace Septem
+{
+	// max size of LZCompress output for InLength bytes
+	static FORCEINLINE int32 LZCompressBound(int32 InLength)
+	{
+		return InLength + InLength / 255 + 16;
+	}
+
+	/*
+	*	fast lz compress, lz4 block format
+	*	return compressed size, 0 when Dst is too small
+	*/
+	SEPTEMSERVO_API int32 LZCompress(const uint8* Src, int32 SrcLength, uint8* Dst, int32 DstCapacity);
+
+	/*
+	*	safe lz decompress, lz4 block format
+	*	never read or write out of buffers
+	*	return decompressed size, -1 when Src is malformed or Dst is too small
+	*/
+	SEPTEMSERVO_API int32 LZDecompress(const uint8* Src, int32 SrcLength, uint8* Dst, int32 DstCapacity);
+}
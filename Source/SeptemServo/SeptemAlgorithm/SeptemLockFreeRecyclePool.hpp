@@ -0,0 +1,361 @@
+// Copyright (c) 2013-2019 7Mersenne All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/ThreadSafeCounter.h"
+#include "HAL/ThreadSafeCounter64.h"
+#include "SeptemRecyclePoolSizer.h"
+
+namespace Septem
+{
+	/*
+	*	lock-free stack of slot indices (treiber stack)
+	*	head packs a tag in high 32 bits and index + 1 in low 32 bits,
+	*	the tag changes on every push/pop, so a stale head never wins the CAS (ABA)
+	*/
+	struct FLockFreeIndexStack
+	{
+		FLockFreeIndexStack()
+			: Head(0)
+		{
+		}
+
+		// Next must be the link array shared by all stacks of the pool
+		void Push(volatile int32* Next, int32 InIndex)
+		{
+			for (;;)
+			{
+				const int64 oldHead = Head;
+				Next[InIndex] = (int32)(uint32)oldHead - 1;
+				const int64 newHead = (int64)(((((uint64)oldHead >> 32) + 1) << 32) | (uint32)(InIndex + 1));
+				if (FPlatformAtomics::InterlockedCompareExchange(&Head, newHead, oldHead) == oldHead)
+				{
+					return;
+				}
+			}
+		}
+
+		// push a run linked through Next from InFirst to InLast with one CAS
+		void PushChain(volatile int32* Next, int32 InFirst, int32 InLast)
+		{
+			for (;;)
+			{
+				const int64 oldHead = Head;
+				Next[InLast] = (int32)(uint32)oldHead - 1;
+				const int64 newHead = (int64)(((((uint64)oldHead >> 32) + 1) << 32) | (uint32)(InFirst + 1));
+				if (FPlatformAtomics::InterlockedCompareExchange(&Head, newHead, oldHead) == oldHead)
+				{
+					return;
+				}
+			}
+		}
+
+		/*
+		*	detach a run of up to InMax top indices with one CAS, write them to OutIndices in stack order
+		*	the run stays linked through Next; return count, 0 when empty
+		*/
+		int32 PopChain(volatile int32* Next, int32 InMax, int32* OutIndices)
+		{
+			for (;;)
+			{
+				const int64 oldHead = Head;
+				int32 index = (int32)(uint32)oldHead - 1;
+				int32 count = 0;
+				// links may be stale if another thread changed the stack, then the tag differs and the CAS fails
+				while (index >= 0 && count < InMax)
+				{
+					OutIndices[count++] = index;
+					index = Next[index];
+				}
+				if (0 == count)
+				{
+					return 0;
+				}
+				const int64 newHead = (int64)(((((uint64)oldHead >> 32) + 1) << 32) | (uint32)(index + 1));
+				if (FPlatformAtomics::InterlockedCompareExchange(&Head, newHead, oldHead) == oldHead)
+				{
+					return count;
+				}
+			}
+		}
+
+		// -1 when empty
+		int32 Pop(volatile int32* Next)
+		{
+			for (;;)
+			{
+				const int64 oldHead = Head;
+				const int32 index = (int32)(uint32)oldHead - 1;
+				if (index < 0)
+				{
+					return -1;
+				}
+				// may be stale if another thread popped index, then the CAS fails
+				const int32 nextIndex = Next[index];
+				const int64 newHead = (int64)(((((uint64)oldHead >> 32) + 1) << 32) | (uint32)(nextIndex + 1));
+				if (FPlatformAtomics::InterlockedCompareExchange(&Head, newHead, oldHead) == oldHead)
+				{
+					return index;
+				}
+			}
+		}
+
+		volatile int64 Head;
+		// keep heads of different stacks on different cache lines
+		uint8 Padding[PLATFORM_CACHE_LINE_SIZE - sizeof(int64)];
+	};
+
+	/*
+	*	Lock-free Recycle Pool, same api as TRecyclePool
+	*	fixed slots allocated on construction, InMinNum of them filled with objects:
+	*	Full stack holds slots with an object, Empty stack holds slots without
+	*	a slot is owned by one thread between pop and push, so the object moves in/out without lock
+	*	capacity is InMaxNum slots, objects over capacity are deleted on dealloc
+	*	Maintain grows/trims cached objects toward demand off the hot path
+	*	always thread safe
+	*/
+	template<typename T>
+	class SEPTEMSERVO_API TLockFreeRecyclePool
+	{
+	public:
+		// InMinNum < 0 fills all slots
+		TLockFreeRecyclePool(int32 InMaxNum = 1024, int32 InMinNum = -1)
+			: Capacity(FMath::Max(InMaxNum, 1))
+			, Sizer(InMinNum < 0 ? Capacity : FMath::Min(InMinNum, Capacity), Capacity)
+			, LastMissCount(0)
+		{
+			Slots = new T*[Capacity];
+			Next = new int32[Capacity];
+
+			const int32 fillNum = Sizer.GetMinNum();
+			for (int32 i = Capacity - 1; i >= fillNum; --i)
+			{
+				Slots[i] = nullptr;
+				EmptyStack.Push(Next, i);
+			}
+			for (int32 i = fillNum - 1; i >= 0; --i)
+			{
+				Slots[i] = new T();
+				FullStack.Push(Next, i);
+			}
+			FullNum.Set(fillNum);
+			LiveNum.Set(fillNum);
+		}
+
+		// not thread safe
+		~TLockFreeRecyclePool()
+		{
+			for (int32 index = FullStack.Pop(Next); index >= 0; index = FullStack.Pop(Next))
+			{
+				delete Slots[index];
+			}
+			delete[] Slots;
+			delete[] Next;
+		}
+
+		// thread safe
+		T* Alloc()
+		{
+			const int32 index = FullStack.Pop(Next);
+			if (index < 0)
+			{
+				MissCount.Increment();
+				LiveNum.Increment();
+				return new T();
+			}
+
+			FullNum.Decrement();
+			T* ptr = Slots[index];
+			EmptyStack.Push(Next, index);
+			return ptr;
+		}
+
+		// thread safe
+		void Dealloc(T* InPtr)
+		{
+			if (nullptr == InPtr)
+				return;
+
+			const int32 index = EmptyStack.Pop(Next);
+			if (index < 0)
+			{
+				// pool is full
+				DropCount.Increment();
+				LiveNum.Decrement();
+				delete InPtr;
+				return;
+			}
+
+			Slots[index] = InPtr;
+			FullStack.Push(Next, index);
+			FullNum.Increment();
+		}
+
+		// thread safe; alloc InNum ptrs, append to the end of OutPtrs
+		// one CAS per stack per BatchChunk ptrs
+		template<typename AllocatorType>
+		void AllocBatch(int32 InNum, TArray<T*, AllocatorType>& OutPtrs)
+		{
+			if (InNum <= 0)
+				return;
+
+			OutPtrs.Reserve(OutPtrs.Num() + InNum);
+			int32 indices[BatchChunk];
+			int32 rest = InNum;
+			while (rest > 0)
+			{
+				const int32 count = FullStack.PopChain(Next, FMath::Min(rest, (int32)BatchChunk), indices);
+				if (0 == count)
+					break;
+
+				FullNum.Subtract(count);
+				for (int32 i = 0; i < count; ++i)
+				{
+					OutPtrs.Add(Slots[indices[i]]);
+				}
+				// the detached run is still linked, hand it to empty stack as it is
+				EmptyStack.PushChain(Next, indices[0], indices[count - 1]);
+				rest -= count;
+			}
+
+			if (rest > 0)
+			{
+				MissCount.Add(rest);
+				LiveNum.Add(rest);
+				for (int32 i = 0; i < rest; ++i)
+				{
+					OutPtrs.Add(new T());
+				}
+			}
+		}
+
+		// thread safe; dealloc valid ptrs of InPtrs
+		// one CAS per stack per BatchChunk ptrs
+		template<typename AllocatorType>
+		void DeallocBatch(const TArray<T*, AllocatorType>& InPtrs)
+		{
+			int32 indices[BatchChunk];
+			int32 i = 0;
+			while (i < InPtrs.Num())
+			{
+				// valid ptrs of the next chunk
+				T* chunk[BatchChunk];
+				int32 chunkNum = 0;
+				for (; i < InPtrs.Num() && chunkNum < BatchChunk; ++i)
+				{
+					if (nullptr != InPtrs[i])
+					{
+						chunk[chunkNum++] = InPtrs[i];
+					}
+				}
+				if (0 == chunkNum)
+					break;
+
+				const int32 count = EmptyStack.PopChain(Next, chunkNum, indices);
+				if (count > 0)
+				{
+					for (int32 j = 0; j < count; ++j)
+					{
+						Slots[indices[j]] = chunk[j];
+					}
+					FullStack.PushChain(Next, indices[0], indices[count - 1]);
+					FullNum.Add(count);
+				}
+
+				if (count < chunkNum)
+				{
+					// pool is full
+					DropCount.Add(chunkNum - count);
+					LiveNum.Subtract(chunkNum - count);
+					for (int32 j = count; j < chunkNum; ++j)
+					{
+						delete chunk[j];
+					}
+				}
+			}
+		}
+
+		/*
+		*	thread safe
+		*	capacity is fixed, same as Dealloc
+		*/
+		void DeallocForceRecycle(T* InPtr)
+		{
+			Dealloc(InPtr);
+		}
+
+		// thread safe, approximate while other threads alloc/dealloc
+		int32 Num()
+		{
+			return FullNum.GetValue();
+		}
+
+		/*
+		*	thread safe with alloc/dealloc, one maintain thread at a time
+		*	sample demand, then create or delete up to one chunk of cached objects
+		*/
+		void Maintain()
+		{
+			const int64 missCount = MissCount.GetValue();
+			const int32 delta = Sizer.Sample(LiveNum.GetValue(), FullNum.GetValue(), missCount != LastMissCount);
+			LastMissCount = missCount;
+
+			for (int32 i = 0; i < delta; ++i)
+			{
+				const int32 index = EmptyStack.Pop(Next);
+				if (index < 0)
+					break;
+
+				Slots[index] = new T();
+				LiveNum.Increment();
+				FullStack.Push(Next, index);
+				FullNum.Increment();
+			}
+
+			for (int32 i = 0; i > delta; --i)
+			{
+				const int32 index = FullStack.Pop(Next);
+				if (index < 0)
+					break;
+
+				FullNum.Decrement();
+				delete Slots[index];
+				LiveNum.Decrement();
+				EmptyStack.Push(Next, index);
+			}
+		}
+
+		// thread safe, approximate while other threads alloc/dealloc
+		void GetStats(FRecyclePoolStats& OutStats)
+		{
+			OutStats.LiveNum = LiveNum.GetValue();
+			OutStats.CachedNum = FullNum.GetValue();
+			OutStats.PeakInUse = Sizer.GetPeakInUse();
+			OutStats.TargetNum = Sizer.GetTargetNum();
+			OutStats.MissCount = MissCount.GetValue();
+			OutStats.DropCount = DropCount.GetValue();
+		}
+
+	private:
+		// max slots moved by one CAS of AllocBatch/DeallocBatch
+		enum { BatchChunk = 64 };
+
+		FLockFreeIndexStack FullStack;
+		FLockFreeIndexStack EmptyStack;
+
+		int32 Capacity;
+		T** Slots;
+		// links of both stacks, a slot is in one stack at a time
+		volatile int32* Next;
+		FThreadSafeCounter FullNum;
+
+		// objects owned by pool and callers
+		FThreadSafeCounter LiveNum;
+		FThreadSafeCounter64 MissCount;
+		FThreadSafeCounter64 DropCount;
+		// used by maintain thread only
+		FRecyclePoolSizer Sizer;
+		int64 LastMissCount;
+	};
+}
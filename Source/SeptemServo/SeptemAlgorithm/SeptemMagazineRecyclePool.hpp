@@ -0,0 +1,282 @@
+// Copyright (c) 2013-2019 7Mersenne All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/ThreadSafeCounter.h"
+#include "Misc/ScopeLock.h"
+#include "SeptemRecyclePoolSizer.h"
+
+/*
+* Max objects cached by one thread in front of the shared recycle pool
+* half of the magazine moves to/from the shared pool when it is empty/full
+*/
+#ifndef SEPTEM_RECYCLE_MAGAZINE_SIZE
+#define SEPTEM_RECYCLE_MAGAZINE_SIZE 32
+#endif // !SEPTEM_RECYCLE_MAGAZINE_SIZE
+
+namespace Septem
+{
+	// live magazine pools of one pool type, thread magazines check their owner here before touching it
+	struct FMagazinePoolRegistry
+	{
+		FCriticalSection Lock;
+		TArray<uint64> LiveIds;
+		uint64 LastId = 0;
+		// pools destroyed so far, a magazine rechecks its owner only when it changed
+		FThreadSafeCounter DeathCount;
+	};
+
+	/*
+	*	Recycle Pool with per-thread magazines, same api as TRecyclePool
+	*	each thread keeps a small LIFO magazine, the shared pool (depot)
+	*	is touched only when the magazine is empty or full, in half magazine batches.
+	*	one magazine per thread per T: a second pool of the same type goes to its depot directly.
+	*	magazines return to depot on thread exit; a destroyed pool flushes the magazine of the destroying thread,
+	*	objects left in magazines of other threads are dropped when those threads find their owner dead.
+	*	thread safe when TDepot is thread safe
+	*/
+	template<typename T, typename TDepot>
+	class TMagazineRecyclePool
+	{
+	public:
+		enum { MagazineSize = SEPTEM_RECYCLE_MAGAZINE_SIZE };
+
+		TMagazineRecyclePool(int32 InMaxNum = 1024, int32 InMinNum = -1)
+			: Depot(InMaxNum, InMinNum)
+		{
+			FMagazinePoolRegistry& registry = Registry();
+			FScopeLock lockRegistry(&registry.Lock);
+			// ids are never reused, a new pool at the address of a dead one doesn't adopt its magazines
+			Id = ++registry.LastId;
+			registry.LiveIds.Add(Id);
+		}
+
+		// no thread may use the pool during destruction
+		~TMagazineRecyclePool()
+		{
+			FMagazine& magazine = ThreadMagazine();
+			if (magazine.Owner == this && magazine.OwnerId == Id)
+			{
+				if (magazine.Num > 0)
+				{
+					Flush(magazine, magazine.Num);
+				}
+				magazine.Owner = nullptr;
+			}
+
+			FMagazinePoolRegistry& registry = Registry();
+			FScopeLock lockRegistry(&registry.Lock);
+			registry.LiveIds.RemoveSwap(Id);
+			registry.DeathCount.Increment();
+		}
+
+		T* Alloc()
+		{
+			FMagazine* magazine = GetMagazine();
+			if (nullptr == magazine)
+			{
+				return Depot.Alloc();
+			}
+
+			if (0 == magazine->Num)
+			{
+				Refill(*magazine);
+			}
+			return magazine->Items[--magazine->Num];
+		}
+
+		void Dealloc(T* InPtr)
+		{
+			if (nullptr == InPtr)
+				return;
+
+			FMagazine* magazine = GetMagazine();
+			if (nullptr == magazine)
+			{
+				Depot.Dealloc(InPtr);
+				return;
+			}
+
+			if (MagazineSize == magazine->Num)
+			{
+				Flush(*magazine, MagazineSize / 2);
+			}
+			magazine->Items[magazine->Num++] = InPtr;
+		}
+
+		// alloc InNum objects, append to the end of OutPtrs
+		template<typename AllocatorType>
+		void AllocBatch(int32 InNum, TArray<T*, AllocatorType>& OutPtrs)
+		{
+			if (InNum <= 0)
+				return;
+
+			FMagazine* magazine = GetMagazine();
+			if (nullptr == magazine || InNum > MagazineSize)
+			{
+				// big batch goes to depot in one call
+				Depot.AllocBatch(InNum, OutPtrs);
+				return;
+			}
+
+			OutPtrs.Reserve(OutPtrs.Num() + InNum);
+			for (int32 i = 0; i < InNum; ++i)
+			{
+				if (0 == magazine->Num)
+				{
+					Refill(*magazine);
+				}
+				OutPtrs.Add(magazine->Items[--magazine->Num]);
+			}
+		}
+
+		// dealloc objects of InPtrs
+		template<typename AllocatorType>
+		void DeallocBatch(const TArray<T*, AllocatorType>& InPtrs)
+		{
+			for (int32 i = 0; i < InPtrs.Num(); ++i)
+			{
+				Dealloc(InPtrs[i]);
+			}
+		}
+
+		void DeallocForceRecycle(T* InPtr)
+		{
+			Depot.DeallocForceRecycle(InPtr);
+		}
+
+		// objects in depot, magazines of threads are not counted
+		int32 Num()
+		{
+			return Depot.Num();
+		}
+
+		// grow/trim depot toward demand, objects in magazines count as in use
+		void Maintain()
+		{
+			Depot.Maintain();
+		}
+
+		void GetStats(FRecyclePoolStats& OutStats)
+		{
+			Depot.GetStats(OutStats);
+		}
+
+		// return the magazine of calling thread to depot, before the thread idles for long
+		void FlushThread()
+		{
+			FMagazine* magazine = GetMagazine();
+			if (magazine && magazine->Num > 0)
+			{
+				Flush(*magazine, magazine->Num);
+			}
+		}
+
+	private:
+		struct FMagazine
+		{
+			TMagazineRecyclePool* Owner;
+			uint64 OwnerId;
+			// registry death count when owner was last seen alive
+			int32 CheckedDeaths;
+			T* Items[MagazineSize];
+			int32 Num;
+
+			FMagazine()
+				: Owner(nullptr)
+				, OwnerId(0)
+				, CheckedDeaths(-1)
+				, Num(0)
+			{
+			}
+
+			~FMagazine()
+			{
+				if (Owner && Num > 0)
+				{
+					// the lock keeps the owner alive while flushing
+					FMagazinePoolRegistry& registry = Registry();
+					FScopeLock lockRegistry(&registry.Lock);
+					if (registry.LiveIds.Contains(OwnerId))
+					{
+						Owner->Flush(*this, Num);
+					}
+				}
+			}
+		};
+
+		// never destructed, magazines may flush after static destruction
+		static FMagazinePoolRegistry& Registry()
+		{
+			static FMagazinePoolRegistry* registry = new FMagazinePoolRegistry();
+			return *registry;
+		}
+
+		static FMagazine& ThreadMagazine()
+		{
+			static thread_local FMagazine magazine;
+			return magazine;
+		}
+
+		// nullptr when the magazine of this thread belongs to another live pool
+		FORCEINLINE FMagazine* GetMagazine()
+		{
+			FMagazine& magazine = ThreadMagazine();
+			if (magazine.Owner == this && magazine.OwnerId == Id)
+			{
+				return &magazine;
+			}
+			return AdoptMagazine(magazine);
+		}
+
+		// magazine is free, owned by another pool, or owned by a dead pool
+		FORCENOINLINE FMagazine* AdoptMagazine(FMagazine& InMagazine)
+		{
+			FMagazinePoolRegistry& registry = Registry();
+			if (InMagazine.Owner && InMagazine.CheckedDeaths == registry.DeathCount.GetValue())
+			{
+				// owner was alive and no pool died since
+				return nullptr;
+			}
+
+			FScopeLock lockRegistry(&registry.Lock);
+			InMagazine.CheckedDeaths = registry.DeathCount.GetValue();
+			if (InMagazine.Owner && registry.LiveIds.Contains(InMagazine.OwnerId))
+			{
+				return nullptr;
+			}
+
+			// objects of a dead owner are gone with its depot, never reuse them
+			InMagazine.Owner = this;
+			InMagazine.OwnerId = Id;
+			InMagazine.Num = 0;
+			return &InMagazine;
+		}
+
+		// magazine is empty, take half from depot with one call
+		void Refill(FMagazine& InMagazine)
+		{
+			TArray<T*, TInlineAllocator<MagazineSize> > batch;
+			Depot.AllocBatch(MagazineSize / 2, batch);
+			for (int32 i = 0; i < batch.Num(); ++i)
+			{
+				InMagazine.Items[InMagazine.Num++] = batch[i];
+			}
+		}
+
+		// move the oldest InNum objects to depot with one call, the newest are hot in cache
+		void Flush(FMagazine& InMagazine, int32 InNum)
+		{
+			TArray<T*, TInlineAllocator<MagazineSize> > batch;
+			batch.Append(InMagazine.Items, InNum);
+			FMemory::Memmove(InMagazine.Items, InMagazine.Items + InNum, (InMagazine.Num - InNum) * sizeof(T*));
+			InMagazine.Num -= InNum;
+
+			Depot.DeallocBatch(batch);
+		}
+
+		TDepot Depot;
+		uint64 Id;
+	};
+}
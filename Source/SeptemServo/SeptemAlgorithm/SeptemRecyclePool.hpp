@@ -5,6 +5,9 @@
 #include "CoreMinimal.h"
 #include "Containers/Queue.h"
 #include "Templates/SharedPointerInternals.h"
+#include "HAL/ThreadSafeCounter.h"
+#include "HAL/ThreadSafeCounter64.h"
+#include "SeptemRecyclePoolSizer.h"
 //#include "Containers/BinaryHeap.h"
 
 namespace Septem
@@ -130,4 +133,225 @@ namespace Septem
 		TArray< TSharedPtr<T, InMode> >  ptrPool;
 		FCriticalSection poolCriticalSection;
 	};
+
+	/*
+	*	Raw pointer Recycle Pool, api of TSharedRecyclePool over T* plus batch alloc/dealloc with one lock
+	*	for objects with intrusive reference count which return themselves to the pool
+	*	objects over the pool capacity are deleted on dealloc
+	*	Maintain grows/trims cached objects toward demand off the hot path
+	*	thread safe
+	*/
+	template<typename T>
+	class SEPTEMSERVO_API TRecyclePool
+	{
+	public:
+		// InMinNum < 0 fills the whole capacity
+		TRecyclePool(int32 InMaxNum = 1024, int32 InMinNum = -1)
+			: Sizer(InMinNum < 0 ? InMaxNum : FMath::Min(InMinNum, InMaxNum), InMaxNum)
+			, LastMissCount(0)
+		{
+			FScopeLock lockPool(&poolCriticalSection);
+			// capacity is the slack of pool array
+			ptrPool.Reset(Sizer.GetMaxNum());
+			for (int32 i = 0; i < Sizer.GetMinNum(); ++i)
+			{
+				ptrPool.Add(new T());
+			}
+			LiveNum.Set(ptrPool.Num());
+		}
+
+		~TRecyclePool()
+		{
+			FScopeLock lockPool(&poolCriticalSection);
+			for (int32 i = 0; i < ptrPool.Num(); ++i)
+			{
+				delete ptrPool[i];
+			}
+			ptrPool.Empty();
+		}
+
+		// thread safe
+		T* Alloc()
+		{
+			{
+				FScopeLock lockPool(&poolCriticalSection);
+				if (ptrPool.Num() > 0)
+				{
+					return ptrPool.Pop(false);
+				}
+			}
+			MissCount.Increment();
+			LiveNum.Increment();
+			return new T();
+		}
+
+		// thread safe
+		void Dealloc(T* InPtr)
+		{
+			if (nullptr == InPtr)
+				return;
+
+			{
+				FScopeLock lockPool(&poolCriticalSection);
+				if (ptrPool.GetSlack() > 0)
+				{
+					ptrPool.Push(InPtr);
+					return;
+				}
+			}
+			DropCount.Increment();
+			LiveNum.Decrement();
+			delete InPtr;
+		}
+
+		// thread safe; alloc InNum ptrs into OutPtrs with one lock, append to the end
+		template<typename AllocatorType>
+		void AllocBatch(int32 InNum, TArray<T*, AllocatorType>& OutPtrs)
+		{
+			if (InNum <= 0)
+				return;
+
+			OutPtrs.Reserve(OutPtrs.Num() + InNum);
+
+			int32 popNum = 0;
+			{
+				FScopeLock lockPool(&poolCriticalSection);
+				popNum = FMath::Min(InNum, ptrPool.Num());
+				const int32 popIndex = ptrPool.Num() - popNum;
+				for (int32 i = ptrPool.Num() - 1; i >= popIndex; --i)
+				{
+					OutPtrs.Add(ptrPool[i]);
+				}
+				ptrPool.RemoveAt(popIndex, popNum, false);
+			}
+
+			// pool is empty, create the rest outside lock
+			if (popNum < InNum)
+			{
+				MissCount.Increment();
+				LiveNum.Add(InNum - popNum);
+			}
+			for (int32 i = popNum; i < InNum; ++i)
+			{
+				OutPtrs.Add(new T());
+			}
+		}
+
+		// thread safe; dealloc ptrs of InPtrs with one lock
+		template<typename AllocatorType>
+		void DeallocBatch(const TArray<T*, AllocatorType>& InPtrs)
+		{
+			if (InPtrs.Num() == 0)
+				return;
+
+			int32 pushNum = 0;
+			{
+				FScopeLock lockPool(&poolCriticalSection);
+				for (; pushNum < InPtrs.Num() && ptrPool.GetSlack() > 0; ++pushNum)
+				{
+					if (InPtrs[pushNum])
+					{
+						ptrPool.Push(InPtrs[pushNum]);
+					}
+				}
+			}
+
+			// pool is full, delete the rest outside lock
+			for (int32 i = pushNum; i < InPtrs.Num(); ++i)
+			{
+				if (InPtrs[i])
+				{
+					DropCount.Increment();
+					LiveNum.Decrement();
+					delete InPtrs[i];
+				}
+			}
+		}
+
+		// thread safe; pool grows over capacity
+		void DeallocForceRecycle(T* InPtr)
+		{
+			if (nullptr == InPtr)
+				return;
+
+			FScopeLock lockPool(&poolCriticalSection);
+			ptrPool.Push(InPtr);
+		}
+
+		// not thread safe
+		int32 Num()
+		{
+			return ptrPool.Num();
+		}
+
+		/*
+		*	thread safe with alloc/dealloc, one maintain thread at a time
+		*	sample demand, then create or delete up to one chunk of cached objects outside lock
+		*/
+		void Maintain()
+		{
+			int32 cachedNum = 0;
+			{
+				FScopeLock lockPool(&poolCriticalSection);
+				cachedNum = ptrPool.Num();
+			}
+
+			const int64 missCount = MissCount.GetValue();
+			const int32 delta = Sizer.Sample(LiveNum.GetValue(), cachedNum, missCount != LastMissCount);
+			LastMissCount = missCount;
+
+			if (delta > 0)
+			{
+				TArray<T*, TInlineAllocator<SEPTEM_RECYCLE_POOL_GROW_CHUNK> > chunk;
+				for (int32 i = 0; i < delta; ++i)
+				{
+					chunk.Add(new T());
+				}
+				LiveNum.Add(delta);
+				DeallocBatch(chunk);
+			}
+			else if (delta < 0)
+			{
+				TArray<T*, TInlineAllocator<SEPTEM_RECYCLE_POOL_GROW_CHUNK> > chunk;
+				{
+					FScopeLock lockPool(&poolCriticalSection);
+					const int32 popNum = FMath::Min(-delta, ptrPool.Num());
+					// the oldest objects are cold
+					chunk.Append(ptrPool.GetData(), popNum);
+					ptrPool.RemoveAt(0, popNum, false);
+				}
+				for (int32 i = 0; i < chunk.Num(); ++i)
+				{
+					delete chunk[i];
+				}
+				LiveNum.Subtract(chunk.Num());
+			}
+		}
+
+		// thread safe, approximate while other threads alloc/dealloc
+		void GetStats(FRecyclePoolStats& OutStats)
+		{
+			{
+				FScopeLock lockPool(&poolCriticalSection);
+				OutStats.CachedNum = ptrPool.Num();
+			}
+			OutStats.LiveNum = LiveNum.GetValue();
+			OutStats.PeakInUse = Sizer.GetPeakInUse();
+			OutStats.TargetNum = Sizer.GetTargetNum();
+			OutStats.MissCount = MissCount.GetValue();
+			OutStats.DropCount = DropCount.GetValue();
+		}
+
+	private:
+		TArray<T*> ptrPool;
+		FCriticalSection poolCriticalSection;
+
+		// objects owned by pool and callers
+		FThreadSafeCounter LiveNum;
+		FThreadSafeCounter64 MissCount;
+		FThreadSafeCounter64 DropCount;
+		// used by maintain thread only
+		FRecyclePoolSizer Sizer;
+		int64 LastMissCount;
+	};
 }
\ No newline at end of file
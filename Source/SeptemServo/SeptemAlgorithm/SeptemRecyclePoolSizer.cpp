@@ -0,0 +1,62 @@
+// Copyright (c) 2013-2019 7Mersenne All Rights Reserved.
+
+#include "SeptemRecyclePoolSizer.h"
+
+namespace Septem
+{
+	FRecyclePoolSizer::FRecyclePoolSizer(int32 InMinNum, int32 InMaxNum)
+		: MinNum(FMath::Max(InMinNum, 0))
+		, MaxNum(FMath::Max(InMaxNum, FMath::Max(InMinNum, 1)))
+		, PeakInUse(0)
+		, WindowIndex(0)
+	{
+		TargetNum = MinNum;
+		Window.SetNumZeroed(SEPTEM_RECYCLE_POOL_WINDOW);
+	}
+
+	int32 FRecyclePoolSizer::Sample(int32 InLiveNum, int32 InCachedNum, bool bMissed)
+	{
+		// after a miss every live object was in use at some moment
+		const int32 demand = bMissed ? InLiveNum : InLiveNum - InCachedNum;
+		Window[WindowIndex] = demand;
+		WindowIndex = (WindowIndex + 1) % Window.Num();
+
+		PeakInUse = 0;
+		for (int32 i = 0; i < Window.Num(); ++i)
+		{
+			PeakInUse = FMath::Max(PeakInUse, Window[i]);
+		}
+
+		// one chunk of headroom over the peak, so a spike doesn't miss before next step
+		TargetNum = FMath::Clamp(PeakInUse + SEPTEM_RECYCLE_POOL_GROW_CHUNK, MinNum, MaxNum);
+
+		const int32 delta = TargetNum - InLiveNum;
+		if (delta > 0)
+		{
+			return FMath::Min(delta, SEPTEM_RECYCLE_POOL_GROW_CHUNK);
+		}
+
+		// trim cached objects only, one chunk per step
+		return -FMath::Min3(-delta, InCachedNum, (int32)SEPTEM_RECYCLE_POOL_GROW_CHUNK);
+	}
+
+	int32 FRecyclePoolSizer::GetMinNum() const
+	{
+		return MinNum;
+	}
+
+	int32 FRecyclePoolSizer::GetMaxNum() const
+	{
+		return MaxNum;
+	}
+
+	int32 FRecyclePoolSizer::GetPeakInUse() const
+	{
+		return PeakInUse;
+	}
+
+	int32 FRecyclePoolSizer::GetTargetNum() const
+	{
+		return TargetNum;
+	}
+}
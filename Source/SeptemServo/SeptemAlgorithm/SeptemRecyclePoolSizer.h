@@ -0,0 +1,68 @@
+// Copyright (c) 2013-2019 7Mersenne All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/*
+* Objects created or deleted by one maintain step of an adaptive recycle pool
+*/
+#ifndef SEPTEM_RECYCLE_POOL_GROW_CHUNK
+#define SEPTEM_RECYCLE_POOL_GROW_CHUNK 64
+#endif // !SEPTEM_RECYCLE_POOL_GROW_CHUNK
+
+/*
+* Demand samples kept by an adaptive recycle pool, one sample per maintain step
+* the pool trims only after demand stays low for the whole window
+*/
+#ifndef SEPTEM_RECYCLE_POOL_WINDOW
+#define SEPTEM_RECYCLE_POOL_WINDOW 200
+#endif // !SEPTEM_RECYCLE_POOL_WINDOW
+
+namespace Septem
+{
+	// stats of an adaptive recycle pool
+	struct FRecyclePoolStats
+	{
+		int32 LiveNum;			// objects owned by pool and callers
+		int32 CachedNum;		// objects cached in pool
+		int32 PeakInUse;		// max demand over window
+		int32 TargetNum;		// live objects the pool aims for
+		int64 MissCount;		// alloc found pool empty
+		int64 DropCount;		// dealloc found pool full
+	};
+
+	/*
+	*	sizing policy of adaptive recycle pools
+	*	samples demand each maintain step, keeps the high-water mark over a sliding window,
+	*	and asks the pool to grow before it runs dry or trim when demand stays low.
+	*	not thread safe, used by the thread which maintains the pool
+	*/
+	class SEPTEMSERVO_API FRecyclePoolSizer
+	{
+	public:
+		FRecyclePoolSizer(int32 InMinNum, int32 InMaxNum);
+
+		/**
+		 * Sample demand of one maintain step.
+		 * @param InLiveNum		objects owned by pool and callers
+		 * @param InCachedNum	objects cached in pool
+		 * @param bMissed		alloc found pool empty since last sample
+		 * @return objects to create (> 0) or delete (< 0), at most one chunk
+		 */
+		int32 Sample(int32 InLiveNum, int32 InCachedNum, bool bMissed);
+
+		int32 GetMinNum() const;
+		int32 GetMaxNum() const;
+		int32 GetPeakInUse() const;
+		int32 GetTargetNum() const;
+
+	private:
+		int32 MinNum;
+		int32 MaxNum;
+		int32 TargetNum;
+		int32 PeakInUse;
+		int32 WindowIndex;
+		TArray<int32> Window;
+	};
+}
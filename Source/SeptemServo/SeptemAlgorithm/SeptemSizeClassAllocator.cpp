@@ -0,0 +1,305 @@
+// Copyright (c) 2013-2019 7Mersenne All Rights Reserved.
+
+#include "SeptemSizeClassAllocator.h"
+
+#include "Misc/ScopeLock.h"
+
+namespace Septem
+{
+	static const int32 SizeClassBlockSizes[FSizeClassAllocator::NumClasses] = { 64, 256, 1024, 4 * 1024, 16 * 1024 };
+	static const int32 SizeClassAlignment = 16;
+
+	/*
+	*	free blocks cached by one thread
+	*	blocks go back to depot when the thread exits
+	*/
+	struct FSizeClassThreadCache
+	{
+		void* Blocks[FSizeClassAllocator::NumClasses][SEPTEM_SIZE_CLASS_THREAD_CACHE];
+		int32 Num[FSizeClassAllocator::NumClasses];
+
+		// written by owner thread only, read relaxed by GetStats; the last one is large class
+		int64 AllocCount[FSizeClassAllocator::NumClasses + 1];
+		int64 FreeCount[FSizeClassAllocator::NumClasses + 1];
+
+		FSizeClassThreadCache()
+		{
+			FMemory::Memzero(Num, sizeof(Num));
+			FMemory::Memzero(AllocCount, sizeof(AllocCount));
+			FMemory::Memzero(FreeCount, sizeof(FreeCount));
+			FSizeClassAllocator::Get().RegisterCache(this);
+		}
+
+		~FSizeClassThreadCache()
+		{
+			FSizeClassAllocator& allocator = FSizeClassAllocator::Get();
+			for (int32 i = 0; i < FSizeClassAllocator::NumClasses; ++i)
+			{
+				if (Num[i] > 0)
+				{
+					allocator.FlushToDepot(i, Blocks[i], Num[i]);
+					Num[i] = 0;
+				}
+			}
+			allocator.UnregisterCache(this);
+		}
+	};
+
+	// no rmw, the owner is the only writer
+	static FORCEINLINE void BumpCount(int64& InOutCount)
+	{
+		FPlatformAtomics::AtomicStore_Relaxed(&InOutCount, InOutCount + 1);
+	}
+
+	static thread_local FSizeClassThreadCache SizeClassThreadCache;
+
+	FSizeClassAllocator & FSizeClassAllocator::Get()
+	{
+		// never destructed, thread caches may flush after static destruction
+		static FSizeClassAllocator* allocator = new FSizeClassAllocator();
+		return *allocator;
+	}
+
+	FSizeClassAllocator::FSizeClassAllocator()
+	{
+		FMemory::Memzero(RetiredAllocCount, sizeof(RetiredAllocCount));
+		FMemory::Memzero(RetiredFreeCount, sizeof(RetiredFreeCount));
+	}
+
+	FSizeClassAllocator::~FSizeClassAllocator()
+	{
+		Trim();
+	}
+
+	void * FSizeClassAllocator::Malloc(int32 InSize)
+	{
+		const int32 sizeClass = SizeToClass(InSize);
+		FSizeClassThreadCache& cache = SizeClassThreadCache;
+		if (sizeClass < 0)
+		{
+			void* block = FMemory::Malloc(InSize, SizeClassAlignment);
+			if (block)
+			{
+				BumpCount(cache.AllocCount[NumClasses]);
+			}
+			return block;
+		}
+
+		if (0 == cache.Num[sizeClass])
+		{
+			cache.Num[sizeClass] = RefillFromDepot(sizeClass, cache.Blocks[sizeClass], SEPTEM_SIZE_CLASS_THREAD_CACHE / 2);
+			if (0 == cache.Num[sizeClass])
+			{
+				// out of system memory
+				return nullptr;
+			}
+		}
+
+		BumpCount(cache.AllocCount[sizeClass]);
+		return cache.Blocks[sizeClass][--cache.Num[sizeClass]];
+	}
+
+	void FSizeClassAllocator::Free(void * InPtr, int32 InSize)
+	{
+		if (nullptr == InPtr)
+			return;
+
+		const int32 sizeClass = SizeToClass(InSize);
+		FSizeClassThreadCache& cache = SizeClassThreadCache;
+		if (sizeClass < 0)
+		{
+			BumpCount(cache.FreeCount[NumClasses]);
+			FMemory::Free(InPtr);
+			return;
+		}
+
+		BumpCount(cache.FreeCount[sizeClass]);
+		if (SEPTEM_SIZE_CLASS_THREAD_CACHE == cache.Num[sizeClass])
+		{
+			// keep the newest half, they are hot in cache
+			const int32 flushNum = SEPTEM_SIZE_CLASS_THREAD_CACHE / 2;
+			FlushToDepot(sizeClass, cache.Blocks[sizeClass], flushNum);
+			FMemory::Memmove(cache.Blocks[sizeClass], cache.Blocks[sizeClass] + flushNum, (SEPTEM_SIZE_CLASS_THREAD_CACHE - flushNum) * sizeof(void*));
+			cache.Num[sizeClass] -= flushNum;
+		}
+
+		cache.Blocks[sizeClass][cache.Num[sizeClass]++] = InPtr;
+	}
+
+	int32 FSizeClassAllocator::SizeToClass(int32 InSize)
+	{
+		for (int32 i = 0; i < NumClasses; ++i)
+		{
+			if (InSize <= SizeClassBlockSizes[i])
+			{
+				return i;
+			}
+		}
+		return -1;
+	}
+
+	int32 FSizeClassAllocator::ClassToSize(int32 InClass)
+	{
+		if (InClass < 0 || InClass >= NumClasses)
+			return 0;
+		return SizeClassBlockSizes[InClass];
+	}
+
+	void FSizeClassAllocator::GetStats(TArray<FSizeClassStats>& OutStats)
+	{
+		OutStats.SetNum(NumClasses + 1);
+		{
+			// counts of running threads are read while they move, stats are approximate
+			FScopeLock lockCaches(&CachesLock);
+			for (int32 i = 0; i <= NumClasses; ++i)
+			{
+				FSizeClassStats& stats = OutStats[i];
+				stats.AllocCount = RetiredAllocCount[i];
+				stats.FreeCount = RetiredFreeCount[i];
+				for (FSizeClassThreadCache* cache : Caches)
+				{
+					stats.AllocCount += FPlatformAtomics::AtomicRead_Relaxed(&cache->AllocCount[i]);
+					stats.FreeCount += FPlatformAtomics::AtomicRead_Relaxed(&cache->FreeCount[i]);
+				}
+			}
+		}
+
+		for (int32 i = 0; i <= NumClasses; ++i)
+		{
+			FSizeClassStats& stats = OutStats[i];
+			stats.BlockSize = ClassToSize(i);
+			// a block may be freed by another thread than the one which allocated it
+			stats.InUse = (int32)(stats.AllocCount - stats.FreeCount);
+			if (i == NumClasses)
+			{
+				// large blocks go back to system on Free
+				stats.SystemBlocks = stats.InUse;
+				stats.DepotNum = 0;
+				continue;
+			}
+
+			FClassDepot& depot = Depots[i];
+			stats.SystemBlocks = depot.SystemBlocks.GetValue();
+			{
+				FScopeLock lockDepot(&depot.Lock);
+				stats.DepotNum = depot.Blocks.Num();
+			}
+		}
+	}
+
+	void FSizeClassAllocator::LogStats()
+	{
+		TArray<FSizeClassStats> stats;
+		GetStats(stats);
+		for (int32 i = 0; i < stats.Num(); ++i)
+		{
+			UE_LOG(LogTemp, Display, TEXT("FSizeClassAllocator: class %d size %d alloc %lld free %lld inuse %d system %d depot %d"),
+				i, stats[i].BlockSize, stats[i].AllocCount, stats[i].FreeCount, stats[i].InUse, stats[i].SystemBlocks, stats[i].DepotNum);
+		}
+	}
+
+	void FSizeClassAllocator::Trim()
+	{
+		for (int32 i = 0; i < NumClasses; ++i)
+		{
+			FClassDepot& depot = Depots[i];
+			FScopeLock lockDepot(&depot.Lock);
+			for (int32 j = 0; j < depot.Blocks.Num(); ++j)
+			{
+				FMemory::Free(depot.Blocks[j]);
+			}
+			depot.SystemBlocks.Subtract(depot.Blocks.Num());
+			depot.Blocks.Empty();
+			depot.LowWater = 0;
+		}
+	}
+
+	void FSizeClassAllocator::Maintain()
+	{
+		if (++MaintainSteps < SEPTEM_SIZE_CLASS_TRIM_WINDOW)
+			return;
+		MaintainSteps = 0;
+
+		TArray<void*> cold;
+		for (int32 i = 0; i < NumClasses; ++i)
+		{
+			FClassDepot& depot = Depots[i];
+			cold.Reset();
+			{
+				FScopeLock lockDepot(&depot.Lock);
+				// keep one refill for the next burst
+				const int32 trimNum = (depot.LowWater - SEPTEM_SIZE_CLASS_THREAD_CACHE / 2) / 2;
+				if (trimNum > 0)
+				{
+					// refill pops from the end, the front blocks are cold
+					cold.Append(depot.Blocks.GetData(), trimNum);
+					depot.Blocks.RemoveAt(0, trimNum, false);
+				}
+				depot.LowWater = depot.Blocks.Num();
+			}
+
+			// free to system outside lock
+			for (int32 j = 0; j < cold.Num(); ++j)
+			{
+				FMemory::Free(cold[j]);
+			}
+			depot.SystemBlocks.Subtract(cold.Num());
+		}
+	}
+
+	int32 FSizeClassAllocator::RefillFromDepot(int32 InClass, void ** OutBlocks, int32 InNum)
+	{
+		FClassDepot& depot = Depots[InClass];
+		int32 count = 0;
+		{
+			FScopeLock lockDepot(&depot.Lock);
+			count = FMath::Min(InNum, depot.Blocks.Num());
+			const int32 popIndex = depot.Blocks.Num() - count;
+			FMemory::Memcpy(OutBlocks, depot.Blocks.GetData() + popIndex, count * sizeof(void*));
+			depot.Blocks.RemoveAt(popIndex, count, false);
+			depot.LowWater = FMath::Min(depot.LowWater, depot.Blocks.Num());
+		}
+
+		if (0 == count)
+		{
+			// depot is empty, allocate from system outside lock
+			const int32 blockSize = SizeClassBlockSizes[InClass];
+			for (; count < InNum; ++count)
+			{
+				void* block = FMemory::Malloc(blockSize, SizeClassAlignment);
+				if (nullptr == block)
+				{
+					break;
+				}
+				OutBlocks[count] = block;
+			}
+			depot.SystemBlocks.Add(count);
+		}
+
+		return count;
+	}
+
+	void FSizeClassAllocator::FlushToDepot(int32 InClass, void ** InBlocks, int32 InNum)
+	{
+		FClassDepot& depot = Depots[InClass];
+		FScopeLock lockDepot(&depot.Lock);
+		depot.Blocks.Append(InBlocks, InNum);
+	}
+
+	void FSizeClassAllocator::RegisterCache(FSizeClassThreadCache * InCache)
+	{
+		FScopeLock lockCaches(&CachesLock);
+		Caches.Add(InCache);
+	}
+
+	void FSizeClassAllocator::UnregisterCache(FSizeClassThreadCache * InCache)
+	{
+		FScopeLock lockCaches(&CachesLock);
+		for (int32 i = 0; i <= NumClasses; ++i)
+		{
+			RetiredAllocCount[i] += InCache->AllocCount[i];
+			RetiredFreeCount[i] += InCache->FreeCount[i];
+		}
+		Caches.RemoveSwap(InCache);
+	}
+}
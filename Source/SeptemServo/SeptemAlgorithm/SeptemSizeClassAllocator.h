@@ -0,0 +1,109 @@
+// Copyright (c) 2013-2019 7Mersenne All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/ThreadSafeCounter.h"
+
+/*
+* Max blocks of one size class cached by one thread
+* half of the cache moves to/from the shared depot when it is full/empty
+*/
+#ifndef SEPTEM_SIZE_CLASS_THREAD_CACHE
+#define SEPTEM_SIZE_CLASS_THREAD_CACHE 64
+#endif // !SEPTEM_SIZE_CLASS_THREAD_CACHE
+
+/*
+* Maintain steps of one depot trim window
+* blocks which stayed in the depot for the whole window are cold, half of them are freed to system
+*/
+#ifndef SEPTEM_SIZE_CLASS_TRIM_WINDOW
+#define SEPTEM_SIZE_CLASS_TRIM_WINDOW 200
+#endif // !SEPTEM_SIZE_CLASS_TRIM_WINDOW
+
+namespace Septem
+{
+	// stats of one size class, Large is the class over the max block size
+	struct FSizeClassStats
+	{
+		int32 BlockSize;		// 0 for large class
+		int64 AllocCount;		// total Malloc calls
+		int64 FreeCount;		// total Free calls
+		int32 InUse;			// blocks hold by callers
+		int32 SystemBlocks;		// blocks allocated from system and not trimmed
+		int32 DepotNum;			// blocks cached in shared depot
+	};
+
+	struct FSizeClassThreadCache;
+
+	/*
+	*	size class allocator for packet bodies
+	*	64B/256B/1KB/4KB/16KB classes, bigger size goes to FMemory directly
+	*	each thread caches free blocks, shared depot balances between threads
+	*	thread safe
+	*/
+	class SEPTEMSERVO_API FSizeClassAllocator
+	{
+	public:
+		enum { NumClasses = 5 };
+
+		static FSizeClassAllocator& Get();
+
+		// thread safe; block size is the size class of InSize
+		void* Malloc(int32 InSize);
+		// thread safe; InSize must be the size passed to Malloc
+		void Free(void* InPtr, int32 InSize);
+
+		// -1 means large size without class
+		static int32 SizeToClass(int32 InSize);
+		static int32 ClassToSize(int32 InClass);
+
+		// thread safe; NumClasses + 1 stats, the last one is large class
+		void GetStats(TArray<FSizeClassStats>& OutStats);
+		void LogStats();
+
+		// thread safe; free all blocks cached in shared depot to system
+		void Trim();
+
+		/*
+		*	thread safe with malloc/free, one maintain thread at a time
+		*	trim depots toward demand, call it periodically from a housekeeping thread
+		*	every SEPTEM_SIZE_CLASS_TRIM_WINDOW steps half of the blocks unused for the window are freed
+		*/
+		void Maintain();
+
+	private:
+		FSizeClassAllocator();
+		~FSizeClassAllocator();
+
+		friend struct FSizeClassThreadCache;
+
+		// alloc/free counts live in thread caches, depot only counts refill/trim
+		struct FClassDepot
+		{
+			FCriticalSection Lock;
+			TArray<void*> Blocks;
+			FThreadSafeCounter SystemBlocks;
+			// min depot blocks since the last trim window, guarded by Lock
+			int32 LowWater = 0;
+		};
+
+		// caches of running threads, summed by GetStats
+		void RegisterCache(FSizeClassThreadCache* InCache);
+		// fold counts of an exiting thread into retired counts
+		void UnregisterCache(FSizeClassThreadCache* InCache);
+
+		// move up to InNum blocks from depot to OutBlocks, allocate from system when depot is empty
+		int32 RefillFromDepot(int32 InClass, void** OutBlocks, int32 InNum);
+		// move InNum blocks to depot
+		void FlushToDepot(int32 InClass, void** InBlocks, int32 InNum);
+
+		FClassDepot Depots[NumClasses];
+		int32 MaintainSteps = 0;
+
+		FCriticalSection CachesLock;
+		TArray<FSizeClassThreadCache*> Caches;
+		int64 RetiredAllocCount[NumClasses + 1];
+		int64 RetiredFreeCount[NumClasses + 1];
+	};
+}
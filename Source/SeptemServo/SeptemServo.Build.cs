@@ -1,6 +1,7 @@
 // Copyright (c) 2013-2019 7Mersenne All Rights Reserved.
 
 using UnrealBuildTool;
+using System.IO;
 
 public class SeptemServo : ModuleRules
 {
@@ -21,6 +22,10 @@ public class SeptemServo : ModuleRules
 				// ... add other private include paths required here ...
 			}
 			);
+
+		// engine BSD socket headers are private, only Protocol/ServoNativeSocket.cpp includes them
+		// never add this path to PublicIncludePaths, modules using SeptemServo must not see it
+		PrivateIncludePaths.Add(Path.Combine(EngineDirectory, "Source/Runtime/Sockets/Private"));
 			
 		
 		PublicDependencyModuleNames.AddRange(
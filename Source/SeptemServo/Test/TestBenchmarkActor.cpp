@@ -0,0 +1,669 @@
+// Copyright (c) 2013-2019 7Mersenne All Rights Reserved.
+
+#include "TestBenchmarkActor.h"
+
+#include "../Protocol/ServoProtocol.h"
+#include "../Protocol/ServoShards.h"
+#include "../Protocol/ServoPacketWriter.h"
+#include "../Threads/ListenThread.h"
+#include "../Threads/ServoReactorThread.h"
+#include "../SeptemAlgorithm/SeptemAlgorithm.h"
+#include "Math/RandomStream.h"
+#include "Misc/SecureHash.h"
+#include "HAL/Runnable.h"
+#include "HAL/RunnableThread.h"
+#include "HAL/Event.h"
+#include "SocketSubsystem.h"
+#include "Sockets.h"
+
+using namespace Septem;
+
+// bytes handled by one kernel call, fits in L2 so memory bandwidth doesn't hide the kernel
+static const int32 BenchBlockSize = 64 * 1024;
+
+// run InBody on one block until InMegaBytes are handled, return MB/s
+static double BenchThroughput(int32 InBlockSize, int32 InMegaBytes, TFunctionRef<void()> InBody)
+{
+	const int64 total = (int64)FMath::Max(InMegaBytes, 1) * 1024 * 1024;
+	const int64 loops = FMath::Max<int64>(total / InBlockSize, 1);
+
+	// warm up caches and branch predictors
+	InBody();
+
+	const double begin = FPlatformTime::Seconds();
+	for (int64 i = 0; i < loops; ++i)
+	{
+		InBody();
+	}
+	const double seconds = FPlatformTime::Seconds() - begin;
+
+	return seconds > 0.0 ? (double)(loops * InBlockSize) / (1024.0 * 1024.0) / seconds : 0.0;
+}
+
+// one line per kernel: MB/s, ms per GB and speedup over the baseline kernel
+static void BenchLog(const TCHAR* InName, double InMBps, double InBaselineMBps)
+{
+	const double msPerGB = InMBps > 0.0 ? 1024.0 * 1000.0 / InMBps : 0.0;
+	const double speedup = InBaselineMBps > 0.0 ? InMBps / InBaselineMBps : 0.0;
+	UE_LOG(LogTemp, Display, TEXT("ATestBenchmarkActor: %s %.0f MB/s, %.1f ms/GB, x%.2f"), InName, InMBps, msPerGB, speedup);
+}
+
+// random bytes, same for every run
+static void BenchFillRandom(TArray<uint8>& OutBuffer, int32 InSize)
+{
+	FRandomStream stream(7);
+	OutBuffer.SetNumUninitialized(InSize);
+	for (int32 i = 0; i < InSize; ++i)
+	{
+		OutBuffer[i] = (uint8)stream.RandRange(0, 255);
+	}
+}
+
+/**
+ * bench thread, runs Body Iterations times after Start is triggered
+ */
+class FBenchRunnable : public FRunnable
+{
+public:
+	FBenchRunnable(FEvent* InStart, TFunction<void()> InBody, int32 InIterations)
+		: Start(InStart)
+		, Body(MoveTemp(InBody))
+		, Iterations(InIterations)
+	{
+	}
+
+	virtual uint32 Run() override
+	{
+		Start->Wait();
+		for (int32 i = 0; i < Iterations; ++i)
+		{
+			Body();
+		}
+		return 0;
+	}
+
+private:
+	FEvent* Start;
+	TFunction<void()> Body;
+	int32 Iterations;
+};
+
+// run InBody InIterations times on each of InThreadNum threads started together, return seconds until all done
+static double BenchThreads(int32 InThreadNum, int32 InIterations, TFunction<void()> InBody)
+{
+	// manual reset, releases every thread at once
+	FEvent* start = FPlatformProcess::GetSynchEventFromPool(true);
+
+	TArray<FBenchRunnable*> runnables;
+	TArray<FRunnableThread*> threads;
+	for (int32 i = 0; i < InThreadNum; ++i)
+	{
+		FBenchRunnable* runnable = new FBenchRunnable(start, InBody, InIterations);
+		FRunnableThread* thread = FRunnableThread::Create(runnable, *FString::Printf(TEXT("FBenchRunnable_%d"), i), 0, TPri_Normal);
+		if (nullptr == thread)
+		{
+			delete runnable;
+			continue;
+		}
+		runnables.Add(runnable);
+		threads.Add(thread);
+	}
+
+	const double begin = FPlatformTime::Seconds();
+	start->Trigger();
+	for (FRunnableThread* thread : threads)
+	{
+		thread->WaitForCompletion();
+	}
+	const double seconds = FPlatformTime::Seconds() - begin;
+
+	for (int32 i = 0; i < threads.Num(); ++i)
+	{
+		delete threads[i];
+		delete runnables[i];
+	}
+	FPlatformProcess::ReturnSynchEventToPool(start);
+
+	return seconds;
+}
+
+// Sets default values
+ATestBenchmarkActor::ATestBenchmarkActor()
+{
+	PrimaryActorTick.bCanEverTick = false;
+}
+
+typedef int32(*FBenchSyncwordKernel)(const uint8* Buffer, int32 BufferSize, int32 Syncword);
+
+// noisy and clean stream MB/s of one syncword kernel, logged against the scalar baselines
+static double BenchSyncwordKernel(const TCHAR* InName, FBenchSyncwordKernel InKernel, int32 InMegaBytes,
+	const TArray<uint8>& InNoisy, const TArray<uint8>& InClean, const TArray<int32>& InFrameOffsets,
+	double& InOutNoisyBaseline, double& InOutCleanBaseline, int32& OutSink)
+{
+	const int32 syncword = (int32)DEFAULT_SYNCWORD_INT32;
+
+	// noisy: no syncword, the kernel scans the whole block
+	const double noisy = BenchThroughput(InNoisy.Num(), InMegaBytes, [&]() { OutSink += InKernel(InNoisy.GetData(), InNoisy.Num(), syncword); });
+	// clean: one call per frame on the rest of the buffer, as ReUse / NextFrame do, syncword is at index 0
+	const double clean = BenchThroughput(InClean.Num(), InMegaBytes, [&]()
+	{
+		const uint8* data = InClean.GetData();
+		const int32 size = InClean.Num();
+		for (int32 i = 0; i < InFrameOffsets.Num(); ++i)
+		{
+			OutSink += InKernel(data + InFrameOffsets[i], size - InFrameOffsets[i], syncword);
+		}
+	});
+
+	if (InOutNoisyBaseline <= 0.0)
+	{
+		InOutNoisyBaseline = noisy;
+		InOutCleanBaseline = clean;
+	}
+	BenchLog(*FString::Printf(TEXT("syncword scan noisy %s"), InName), noisy, InOutNoisyBaseline);
+	BenchLog(*FString::Printf(TEXT("syncword scan clean %s"), InName), clean, InOutCleanBaseline);
+	return noisy;
+}
+
+float ATestBenchmarkActor::BenchSyncwordScan(int32 InMegaBytes)
+{
+	const int32 syncword = (int32)DEFAULT_SYNCWORD_INT32;
+
+	// the worst case: every kernel scans the whole block
+	TArray<uint8> noisy;
+	BenchFillRandom(noisy, BenchBlockSize);
+	for (int32 index = BufferBufferSyncwordScalar(noisy.GetData(), noisy.Num(), syncword); index >= 0;
+		index = BufferBufferSyncwordScalar(noisy.GetData(), noisy.Num(), syncword))
+	{
+		noisy[index] ^= 0xFF;
+	}
+
+	// the common case: back to back frames of 16 to 256 body bytes
+	TArray<uint8> body;
+	BenchFillRandom(body, 256);
+	TArray<uint8> clean;
+	TArray<int32> frameOffsets;
+	{
+		FRandomStream stream(11);
+		FServoPacketWriter writer(clean);
+		while (writer.Num() < BenchBlockSize)
+		{
+			frameOffsets.Add(writer.Num());
+			writer.Begin(1);
+			writer.Write(body.GetData(), stream.RandRange(16, 256));
+			writer.Finish();
+		}
+	}
+
+	double noisyBaseline = 0.0;
+	double cleanBaseline = 0.0;
+	int32 sink = 0;
+
+	BenchSyncwordKernel(TEXT("scalar"), &BufferBufferSyncwordScalar, InMegaBytes, noisy, clean, frameOffsets, noisyBaseline, cleanBaseline, sink);
+#if SEPTEM_SIMD_X86
+	const FCpuFeatures& cpu = FCpuFeatures::Get();
+	if (cpu.bSSE2)
+	{
+		BenchSyncwordKernel(TEXT("SSE2"), &BufferBufferSyncwordSSE2, InMegaBytes, noisy, clean, frameOffsets, noisyBaseline, cleanBaseline, sink);
+	}
+	if (cpu.bAVX2)
+	{
+		BenchSyncwordKernel(TEXT("AVX2"), &BufferBufferSyncwordAVX2, InMegaBytes, noisy, clean, frameOffsets, noisyBaseline, cleanBaseline, sink);
+	}
+#endif // SEPTEM_SIMD_X86
+	const double dispatched = BenchSyncwordKernel(TEXT("BufferBufferSyncword"), &BufferBufferSyncword, InMegaBytes, noisy, clean, frameOffsets, noisyBaseline, cleanBaseline, sink);
+
+	// the sink keeps the calls alive
+	UE_LOG(LogTemp, Display, TEXT("ATestBenchmarkActor: syncword scan %d frames in clean block (sink %d)"), frameOffsets.Num(), sink);
+	return (float)dispatched;
+}
+
+float ATestBenchmarkActor::BenchChecksum(int32 InMegaBytes)
+{
+	TArray<uint8> buffer;
+	BenchFillRandom(buffer, BenchBlockSize);
+	TArray<uint8> copy;
+	copy.SetNumUninitialized(BenchBlockSize);
+
+	const uint8* data = buffer.GetData();
+	uint8* dst = copy.GetData();
+	const int32 size = buffer.Num();
+	uint32 sink = 0;
+
+	// 1. xor fastcode
+	const double xorScalar = BenchThroughput(BenchBlockSize, InMegaBytes, [&]() { sink += BufferXORScalar(data, size); });
+	BenchLog(TEXT("xor scalar"), xorScalar, xorScalar);
+#if SEPTEM_SIMD_X86
+	const FCpuFeatures& cpu = FCpuFeatures::Get();
+	if (cpu.bSSE2)
+	{
+		BenchLog(TEXT("xor SSE2"), BenchThroughput(BenchBlockSize, InMegaBytes, [&]() { sink += BufferXORSSE2(data, size); }), xorScalar);
+	}
+	if (cpu.bAVX2)
+	{
+		BenchLog(TEXT("xor AVX2"), BenchThroughput(BenchBlockSize, InMegaBytes, [&]() { sink += BufferXORAVX2(data, size); }), xorScalar);
+	}
+#endif // SEPTEM_SIMD_X86
+	BenchLog(TEXT("BufferXOR"), BenchThroughput(BenchBlockSize, InMegaBytes, [&]() { sink += BufferXOR(data, size); }), xorScalar);
+
+	// 2. fused copy and xor, baseline is memcpy then xor
+	const double copyThenXor = BenchThroughput(BenchBlockSize, InMegaBytes, [&]()
+	{
+		FMemory::Memcpy(dst, data, size);
+		sink += BufferXOR(dst, size);
+	});
+	BenchLog(TEXT("memcpy + BufferXOR"), copyThenXor, copyThenXor);
+	BenchLog(TEXT("BufferCopyXOR"), BenchThroughput(BenchBlockSize, InMegaBytes, [&]() { sink += BufferCopyXOR(dst, data, size); }), copyThenXor);
+
+	// 3. crc32c
+	const double crcSlicing = BenchThroughput(BenchBlockSize, InMegaBytes, [&]() { sink += Crc32cSlicing8(data, size); });
+	BenchLog(TEXT("crc32c slicing-by-8"), crcSlicing, crcSlicing);
+#if SEPTEM_SIMD_X86
+	if (cpu.bSSE42)
+	{
+		BenchLog(TEXT("crc32c SSE4.2"), BenchThroughput(BenchBlockSize, InMegaBytes, [&]() { sink += Crc32cSSE42(data, size); }), crcSlicing);
+	}
+#endif // SEPTEM_SIMD_X86
+	const double crc = BenchThroughput(BenchBlockSize, InMegaBytes, [&]() { sink += Crc32c(data, size); });
+	BenchLog(TEXT("Crc32c"), crc, crcSlicing);
+
+	// 4. sha256 of foot signature, compared with crc32c
+#if PLATFORM_WINDOWS || PLATFORM_MAC
+	FSHA256Signature signature;
+	const double sha256 = BenchThroughput(BenchBlockSize, InMegaBytes, [&]()
+	{
+		FPlatformMisc::GetSHA256Signature(data, size, signature);
+		sink += signature.Signature[0];
+	});
+	BenchLog(TEXT("sha256"), sha256, crc);
+#else
+	UE_LOG(LogTemp, Display, TEXT("ATestBenchmarkActor: sha256 has no platform implementation here"));
+#endif // PLATFORM_WINDOWS || PLATFORM_MAC
+
+	UE_LOG(LogTemp, Display, TEXT("ATestBenchmarkActor: checksum sink %u"), sink);
+	return (float)crc;
+}
+
+// compress and decompress one body repeatedly, log MB/s of raw bytes and the ratio; return compress MB/s
+static double BenchCodecPayload(const TCHAR* InName, const TArray<uint8>& InRaw, int32 InMegaBytes)
+{
+	const int32 rawSize = InRaw.Num();
+	TArray<uint8> packed;
+	packed.SetNumUninitialized(LZCompressBound(rawSize));
+	TArray<uint8> unpacked;
+	unpacked.SetNumUninitialized(rawSize);
+
+	const int32 packedSize = LZCompress(InRaw.GetData(), rawSize, packed.GetData(), packed.Num());
+	if (packedSize <= 0 || LZDecompress(packed.GetData(), packedSize, unpacked.GetData(), rawSize) != rawSize
+		|| 0 != FMemory::Memcmp(unpacked.GetData(), InRaw.GetData(), rawSize))
+	{
+		UE_LOG(LogTemp, Warning, TEXT("ATestBenchmarkActor: lz %s round trip failed"), InName);
+		return 0.0;
+	}
+
+	int64 sink = 0;
+	const double compress = BenchThroughput(rawSize, InMegaBytes, [&]() { sink += LZCompress(InRaw.GetData(), rawSize, packed.GetData(), packed.Num()); });
+	const double decompress = BenchThroughput(rawSize, InMegaBytes, [&]() { sink += LZDecompress(packed.GetData(), packedSize, unpacked.GetData(), rawSize); });
+
+	UE_LOG(LogTemp, Display, TEXT("ATestBenchmarkActor: lz %s %d -> %d bytes ratio %.3f, compress %.0f MB/s, decompress %.0f MB/s (sink %lld)"),
+		InName, rawSize, packedSize, (double)packedSize / (double)rawSize, compress, decompress, sink);
+	return compress;
+}
+
+float ATestBenchmarkActor::BenchCodec(int32 InMegaBytes)
+{
+	const int32 bodySize = 4 * 1024;
+
+	// actor states: ids in order, positions move a little, flags rarely change
+#pragma pack(push, 1)
+	struct FStateRecord
+	{
+		int32 actor;
+		float x, y, z;
+		uint8 flags;
+	};
+#pragma pack(pop)
+
+	TArray<uint8> state;
+	state.SetNumZeroed(bodySize);
+	FRandomStream stream(7);
+	const int32 recordNum = bodySize / sizeof(FStateRecord);
+	for (int32 i = 0; i < recordNum; ++i)
+	{
+		FStateRecord record;
+		record.actor = 1000 + i;
+		record.x = 100.f + (float)stream.RandRange(0, 3);
+		record.y = 200.f;
+		record.z = 0.f;
+		record.flags = 0 == i % 16 ? 1 : 0;
+		FMemory::Memcpy(state.GetData() + i * sizeof(FStateRecord), &record, sizeof(FStateRecord));
+	}
+
+	TArray<uint8> random;
+	BenchFillRandom(random, bodySize);
+
+	const double compress = BenchCodecPayload(TEXT("game state"), state, InMegaBytes);
+	BenchCodecPayload(TEXT("random"), random, InMegaBytes);
+	return (float)compress;
+}
+
+// object of the size of a small packet, own type so the magazine of FSNetPacket is untouched
+struct FBenchPoolItem
+{
+	uint8 Data[64];
+};
+
+// objects held by one thread between alloc and dealloc, like a decoded batch
+static const int32 BenchPoolBatch = 8;
+
+// alloc/dealloc Mops/s of pool TPool at InThreadNum threads
+template<typename TPool>
+static double BenchPool(int32 InThreadNum, int32 InIterations)
+{
+	// every thread can hold a batch and a full magazine, nothing is created on the hot path
+	TPool* pool = new TPool(InThreadNum * (BenchPoolBatch + SEPTEM_RECYCLE_MAGAZINE_SIZE), -1);
+	const double seconds = BenchThreads(InThreadNum, InIterations, [pool]()
+	{
+		FBenchPoolItem* items[BenchPoolBatch];
+		for (int32 i = 0; i < BenchPoolBatch; ++i)
+		{
+			items[i] = pool->Alloc();
+		}
+		for (int32 i = 0; i < BenchPoolBatch; ++i)
+		{
+			pool->Dealloc(items[i]);
+		}
+	});
+	// threads have exited, magazines are back in the pool
+	delete pool;
+
+	const double ops = (double)InThreadNum * InIterations * BenchPoolBatch * 2;
+	return seconds > 0.0 ? ops / seconds / 1000000.0 : 0.0;
+}
+
+float ATestBenchmarkActor::BenchRecyclePool(int32 InIterations)
+{
+	typedef TRecyclePool<FBenchPoolItem> FMutexPool;
+	typedef TLockFreeRecyclePool<FBenchPoolItem> FLockFreePool;
+	typedef TMagazineRecyclePool<FBenchPoolItem, FLockFreePool> FMagazinePool;
+
+	const int32 threadNums[] = { 1, 4, 16, 64 };
+	float speedup = 0.f;
+	for (int32 threadNum : threadNums)
+	{
+		const double mutex = BenchPool<FMutexPool>(threadNum, InIterations);
+		const double lockFree = BenchPool<FLockFreePool>(threadNum, InIterations);
+		const double magazine = BenchPool<FMagazinePool>(threadNum, InIterations);
+		UE_LOG(LogTemp, Display, TEXT("ATestBenchmarkActor: recycle pool %d threads, mutex %.1f, lock-free %.1f (x%.2f), magazine %.1f (x%.2f) Mops/s"),
+			threadNum, mutex, lockFree, mutex > 0.0 ? lockFree / mutex : 0.0, magazine, mutex > 0.0 ? magazine / mutex : 0.0);
+		speedup = mutex > 0.0 ? (float)(lockFree / mutex) : 0.f;
+	}
+
+	return speedup;
+}
+
+float ATestBenchmarkActor::BenchShardWorkers(int32 InPackets, int32 InWorkBytes)
+{
+	const int32 producerNum = 4;
+	const int32 batchNum = 32;
+	const int32 sessionNum = 256;
+	const int32 iterations = FMath::Max(InPackets / (producerNum * batchNum), 1);
+	const int32 total = iterations * producerNum * batchNum;
+
+	// stands in for game logic of one packet
+	TArray<uint8> work;
+	BenchFillRandom(work, FMath::Max(InWorkBytes, 1));
+	const uint8* workData = work.GetData();
+	const int32 workSize = work.Num();
+
+	const int32 shardNums[] = { 1, 2, 4, 8, 16 };
+	double baseline = 0.0;
+	float speedup = 0.f;
+	for (int32 shardNum : shardNums)
+	{
+		FServoShards* shards = new FServoShards(shardNum);
+		FThreadSafeCounter handled;
+		// one slot per shard, written by its worker only
+		TArray<uint32> sinks;
+		sinks.SetNumZeroed(shardNum);
+		uint32* sinkData = sinks.GetData();
+		for (int32 i = 0; i < shardNum; ++i)
+		{
+			shards->RegisterHandler(i, [&handled, sinkData, workData, workSize](int32 InShard, const FServoPacketRef& InPacket)
+			{
+				sinkData[InShard] += Crc32c(workData, workSize, (uint32)InPacket->sid);
+				handled.Increment();
+			});
+		}
+
+		FThreadSafeCounter sequence;
+		const double begin = FPlatformTime::Seconds();
+		BenchThreads(producerNum, iterations, [shards, &sequence, batchNum, sessionNum]()
+		{
+			// reactors alloc from the protocol pool and push one decoded batch
+			TArray<FServoPacketRef> batch;
+			const int32 first = sequence.Add(batchNum);
+			for (int32 i = 0; i < batchNum; ++i)
+			{
+				FServoPacketRef packet = FServoProtocol::Get()->AllocNetPacket();
+				packet->sid = 1 + (first + i) % sessionNum;
+				batch.Add(MoveTemp(packet));
+			}
+			shards->PushBatch(batch, 0);
+		});
+		while (handled.GetValue() < total)
+		{
+			FPlatformProcess::Sleep(0.f);
+		}
+		const double seconds = FPlatformTime::Seconds() - begin;
+		delete shards;
+
+		uint32 sink = 0;
+		for (uint32 value : sinks)
+		{
+			sink ^= value;
+		}
+
+		const double rate = seconds > 0.0 ? total / seconds : 0.0;
+		if (1 == shardNum)
+		{
+			baseline = rate;
+		}
+		speedup = baseline > 0.0 ? (float)(rate / baseline) : 0.f;
+		UE_LOG(LogTemp, Display, TEXT("ATestBenchmarkActor: %d shard workers, %d packets in %.3f s, %.0f packets/s, x%.2f (sink %u)"),
+			shardNum, total, seconds, rate, speedup, sink);
+	}
+
+	return speedup;
+}
+
+// packets per client send and body bytes of each, the body begins with the send time in cycles
+static const int32 BenchReactorBatch = 16;
+static const int32 BenchReactorBodySize = 64;
+// latency samples kept by the pop thread
+static const int32 BenchReactorSampleMax = 4 * 1024 * 1024;
+
+// encode one client batch stamped with the current time
+static void BenchReactorEncode(TArray<uint8>& OutBlock, TArray<uint8>& InOutBody)
+{
+	const uint64 now = FPlatformTime::Cycles64();
+	FMemory::Memcpy(InOutBody.GetData(), &now, sizeof(uint64));
+
+	OutBlock.Reset();
+	FServoPacketWriter writer(OutBlock);
+	for (int32 i = 0; i < BenchReactorBatch; ++i)
+	{
+		writer.Begin(1);
+		writer.Write(InOutBody.GetData(), InOutBody.Num());
+		writer.Finish();
+	}
+}
+
+// value at InPercent of sorted samples
+static float BenchPercentile(const TArray<float>& InSorted, float InPercent)
+{
+	if (0 == InSorted.Num())
+		return 0.f;
+	const int32 index = FMath::Clamp((int32)(InSorted.Num() * InPercent / 100.f), 0, InSorted.Num() - 1);
+	return InSorted[index];
+}
+
+// packets/s popped from the packet pool while clients blast a server on one reactor backend
+// logs send to pop latency p50/p99
+static double BenchReactorBackend(bool bUring, int32 InSeconds, int32 InClients, int32 InPort)
+{
+	FServoReactorThread::bUseUring = bUring;
+	FListenThread* server = FListenThread::Create(InPort, 0.05f, 1);
+	if (nullptr == server)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("ATestBenchmarkActor: reactor bench failed to listen on %d"), InPort);
+		return 0.0;
+	}
+	FPlatformProcess::Sleep(0.2f);
+
+	// leftovers of former runs
+	FServoProtocol* protocol = FServoProtocol::Get();
+	TArray<FServoPacketRef> popped;
+	while (protocol->PopBatch(popped, 1024) > 0)
+	{
+		popped.Reset();
+	}
+
+	TArray<uint8> body;
+	BenchFillRandom(body, BenchReactorBodySize);
+	int32 packetBytes = 0;
+	{
+		TArray<uint8> block;
+		BenchReactorEncode(block, body);
+		packetBytes = block.Num() / BenchReactorBatch;
+	}
+
+	const int32 clientThreadNum = FMath::Clamp(InClients, 1, 4);
+	const double begin = FPlatformTime::Seconds();
+	const double end = begin + FMath::Max(InSeconds, 1);
+	FThreadSafeCounter roles;
+	FThreadSafeCounter64 sent;
+	int64 received = 0;
+	double lastPop = begin;
+	TArray<float> latencies;
+	latencies.Reserve(BenchReactorSampleMax);
+
+	// role 0 drains the packet pool, the others are client threads
+	BenchThreads(clientThreadNum + 1, 1, [&]()
+	{
+		const int32 role = roles.Increment() - 1;
+		if (0 == role)
+		{
+			const double microsecondsPerCycle = FPlatformTime::GetSecondsPerCycle64() * 1000000.0;
+			TArray<FServoPacketRef> packets;
+			for (;;)
+			{
+				packets.Reset();
+				const int32 num = protocol->PopBatch(packets, 1024);
+				const double now = FPlatformTime::Seconds();
+				if (num > 0)
+				{
+					const uint64 nowCycles = FPlatformTime::Cycles64();
+					for (int32 i = 0; i < num && latencies.Num() < BenchReactorSampleMax; ++i)
+					{
+						const FSNetBufferBody& packetBody = packets[i]->Body;
+						if (packetBody.bufferPtr && packetBody.length >= (int32)sizeof(uint64))
+						{
+							uint64 sendCycles = 0;
+							FMemory::Memcpy(&sendCycles, packetBody.bufferPtr, sizeof(uint64));
+							latencies.Add((float)((double)(nowCycles - sendCycles) * microsecondsPerCycle));
+						}
+					}
+					received += num;
+					lastPop = now;
+				}
+				else if (now > end && now - FMath::Max(lastPop, end) > 0.2)
+				{
+					break;
+				}
+				else {
+					protocol->WaitForPackets(1);
+				}
+			}
+			return;
+		}
+
+		// sockets of this client thread
+		const int32 clientIndex = role - 1;
+		const int32 socketNum = InClients / clientThreadNum + (clientIndex < InClients % clientThreadNum ? 1 : 0);
+		ISocketSubsystem* subsystem = ISocketSubsystem::Get(PLATFORM_SOCKETSUBSYSTEM);
+		TSharedRef<FInternetAddr> addr = subsystem->CreateInternetAddr(0x7F000001, InPort);
+		TArray<FSocket*> sockets;
+		for (int32 i = 0; i < socketNum; ++i)
+		{
+			FSocket* socket = subsystem->CreateSocket(NAME_Stream, TEXT("BenchReactorClient"), false);
+			if (socket && socket->Connect(*addr))
+			{
+				sockets.Add(socket);
+			}
+			else if (socket) {
+				subsystem->DestroySocket(socket);
+			}
+		}
+
+		// every send is stamped right before it goes to socket
+		TArray<uint8> clientBody = body;
+		TArray<uint8> block;
+		int64 count = 0;
+		for (int32 i = 0; sockets.Num() > 0 && FPlatformTime::Seconds() < end; i = (i + 1) % sockets.Num())
+		{
+			BenchReactorEncode(block, clientBody);
+			int32 bytesSend = 0;
+			if (sockets[i]->Send(block.GetData(), block.Num(), bytesSend))
+			{
+				count += bytesSend / packetBytes;
+			}
+		}
+		sent.Add(count);
+
+		for (FSocket* socket : sockets)
+		{
+			socket->Close();
+			subsystem->DestroySocket(socket);
+		}
+	});
+
+	server->KillThread();
+	delete server;
+
+	latencies.Sort();
+	const double seconds = lastPop - begin;
+	const double rate = seconds > 0.0 ? received / seconds : 0.0;
+	UE_LOG(LogTemp, Display, TEXT("ATestBenchmarkActor: reactor %s, %d clients, sent %lld received %lld packets in %.2f s, %.0f packets/s, %.1f MB/s, latency p50 %.1f us p99 %.1f us (%d samples)"),
+		bUring ? TEXT("io_uring") : (SERVO_REACTOR_EPOLL ? TEXT("epoll") : TEXT("poll")), InClients, sent.GetValue(), received, seconds, rate, rate * packetBytes / (1024.0 * 1024.0),
+		BenchPercentile(latencies, 50.f), BenchPercentile(latencies, 99.f), latencies.Num());
+	return rate;
+}
+
+float ATestBenchmarkActor::BenchReactor(int32 InSeconds, int32 InClients, int32 InPort)
+{
+	if (nullptr != FServoProtocol::Get()->GetShards())
+	{
+		UE_LOG(LogTemp, Warning, TEXT("ATestBenchmarkActor: reactor bench pops the packet pool, it can't run with shards"));
+		return 0.f;
+	}
+
+	const bool bUseUring = FServoReactorThread::bUseUring;
+	const double epoll = BenchReactorBackend(false, InSeconds, InClients, InPort);
+	double uring = 0.0;
+#if SERVO_REACTOR_URING
+	if (FServoUring::IsSupported())
+	{
+		uring = BenchReactorBackend(true, InSeconds, InClients, InPort);
+		UE_LOG(LogTemp, Display, TEXT("ATestBenchmarkActor: reactor io_uring x%.2f over epoll"), epoll > 0.0 ? uring / epoll : 0.0);
+	}
+	else {
+		UE_LOG(LogTemp, Display, TEXT("ATestBenchmarkActor: reactor io_uring is not supported by this kernel"));
+	}
+#else
+	UE_LOG(LogTemp, Display, TEXT("ATestBenchmarkActor: reactor io_uring is not built on this platform"));
+#endif // SERVO_REACTOR_URING
+	FServoReactorThread::bUseUring = bUseUring;
+
+	return epoll > 0.0 ? (float)(uring / epoll) : 0.f;
+}
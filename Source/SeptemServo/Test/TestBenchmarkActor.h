@@ -0,0 +1,56 @@
+// Copyright (c) 2013-2019 7Mersenne All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Actor.h"
+#include "TestBenchmarkActor.generated.h"
+
+/**
+ * micro benchmarks of servo hot paths, call from Blueprint or level script
+ * every bench blocks the calling thread, logs one line per variant and returns the number of the default variant
+ * run in a shipping or development build, debug numbers are meaningless
+ */
+UCLASS()
+class SEPTEMSERVO_API ATestBenchmarkActor : public AActor
+{
+	GENERATED_BODY()
+	
+public:	
+	// Sets default values for this actor's properties
+	ATestBenchmarkActor();
+
+public:
+	// syncword scan, scalar / SSE2 / AVX2 over a buffer without syncword (noisy) and frame by frame over encoded frames (clean)
+	// return noisy MB/s of BufferBufferSyncword
+	UFUNCTION(BlueprintCallable, Category = "Benchmark")
+		float BenchSyncwordScan(int32 InMegaBytes = 1024);
+
+	// xor fastcode, fused copy xor, crc32c per kernel and sha256 where the platform has it; return MB/s of Crc32c
+	UFUNCTION(BlueprintCallable, Category = "Benchmark")
+		float BenchChecksum(int32 InMegaBytes = 1024);
+
+	// lz compress / decompress of 4KB bodies, game state and random payloads; return compress MB/s of game state
+	UFUNCTION(BlueprintCallable, Category = "Benchmark")
+		float BenchCodec(int32 InMegaBytes = 256);
+
+	// alloc/dealloc of mutex, lock-free and magazine recycle pools at 1, 4, 16 and 64 threads
+	// return lock-free speedup over the mutex pool at 64 threads
+	UFUNCTION(BlueprintCallable, Category = "Benchmark")
+		float BenchRecyclePool(int32 InIterations = 100000);
+
+	// 4 producer threads push packets of 256 sessions to 1, 2, 4, 8 and 16 shard workers,
+	// each packet costs a crc32c of InWorkBytes; return packets/s speedup of 16 workers over 1
+	UFUNCTION(BlueprintCallable, Category = "Benchmark")
+		float BenchShardWorkers(int32 InPackets = 200000, int32 InWorkBytes = 1024);
+
+	/**
+	 * loopback server on InPort, InClients connections blast 64B packets for InSeconds,
+	 * once on epoll reactors and once on io_uring reactors; logs packets/s and MB/s popped from the packet pool,
+	 * and p50/p99 latency from client send to PopBatch, every packet body carries its send time.
+	 * needs ShardNum 0 and no other consumer of the packet pool, e.g. no ATestServerActor in the level
+	 * @return io_uring speedup over epoll, 0 when io_uring is not supported
+	 */
+	UFUNCTION(BlueprintCallable, Category = "Benchmark")
+		float BenchReactor(int32 InSeconds = 5, int32 InClients = 64, int32 InPort = 3799);
+};
@@ -3,6 +3,8 @@
 #include "TestClientNoThreadActor.h"
 
 #include "../Protocol/ServoProtocol.h"
+#include "../Protocol/ServoPacketWriter.h"
+#include "TestServoMessage.h"
 
 // Sets default values
 ATestClientNoThreadActor::ATestClientNoThreadActor()
@@ -144,24 +146,48 @@ void ATestClientNoThreadActor::SendHeartbeat()
 {
 	if (ClientSocket)
 	{
-		FSNetPacket* ptr = FSNetPacket::CreateHeartbeat();
-		TSharedPtr<FSNetPacket, ESPMode::ThreadSafe> ptrPacket(ptr);
+		int32 bytesSend = 0;
+
+		// reuse send buffer, heartbeat is encoded in place
+		SendBuffer.Reset();
+		FServoPacketWriter writer(SendBuffer);
+		writer.Begin(0);
+		writer.Finish();
+
+		if (ClientSocket->Send(writer.GetData(), writer.Num(), bytesSend))
+		{
+			UE_LOG(LogTemp, Display, TEXT("ATestClientNoThreadActor: socket heartbeat send  %d bytes done. buffer num = %d \n"), bytesSend, writer.Num());
+		}
+		else {
+			ReleaseSocket();
+		}
+	}
+}
 
+void ATestClientNoThreadActor::SendMove(int32 InActor, FVector InLocation)
+{
+	if (ClientSocket)
+	{
 		int32 bytesSend = 0;
-		TArray<uint8> buffer;
 
-		buffer.Reset(1024);
+		FTestMoveLayout move;
+		move.actor = InActor;
+		move.x = InLocation.X;
+		move.y = InLocation.Y;
+		move.z = InLocation.Z;
 
-		if(ptrPacket.Get())
-			ptrPacket.Get()->WriteToArray(buffer);
+		SendBuffer.Reset();
+		FServoPacketWriter writer(SendBuffer);
+		writer.Begin(FTestMoveMessage::Uid);
+		writer.Write(move);
+		writer.Finish();
 
-		if (ClientSocket->Send(buffer.GetData(), buffer.Num(), bytesSend))
+		if (ClientSocket->Send(writer.GetData(), writer.Num(), bytesSend))
 		{
-			UE_LOG(LogTemp, Display, TEXT("ATestClientNoThreadActor: socket heartbeat send  %d bytes done. buffer num = %d \n"), bytesSend, buffer.Num());
+			UE_LOG(LogTemp, Display, TEXT("ATestClientNoThreadActor: socket move send  %d bytes done. buffer num = %d \n"), bytesSend, writer.Num());
 		}
 		else {
 			ReleaseSocket();
 		}
 	}
 }
-
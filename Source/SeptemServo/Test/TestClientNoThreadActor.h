@@ -46,6 +46,9 @@ public:
 
 	FSocket* ClientSocket;
 
+	// packets are encoded into this buffer, kept between sends
+	TArray<uint8> SendBuffer;
+
 public:
 	UFUNCTION(BlueprintCallable, Category = "Client")
 		void ConnectToServer();
@@ -64,4 +67,8 @@ public:
 
 	UFUNCTION(BlueprintCallable, Category = "Client")
 		void SendHeartbeat();
+
+	// FTestMoveMessage, read by ATestServerActor::OnMessage
+	UFUNCTION(BlueprintCallable, Category = "Client")
+		void SendMove(int32 InActor, FVector InLocation);
 };
@@ -14,10 +14,19 @@ ATestServerActor::ATestServerActor()
 	ServerThread = nullptr;
 
 	PoolTimespan = 0.05f;
+	ListenShardNum = 1;
+	bUseUring = false;
 
 	bCleanup = true;
 
-	LastPacket = TSharedPtr<FSNetPacket, ESPMode::ThreadSafe>(new FSNetPacket());
+	Dispatcher = nullptr;
+	LastMoveActor = 0;
+	LastMoveLocation = FVector::ZeroVector;
+	MoveMessageNum = 0;
+	DispatchMaxPerFrame = 1024;
+	DispatchBudgetMicroseconds = 2000;
+
+	LastPacket = FServoPacketRef(new FSNetPacket());
 	//FServoProtocol::Get()->AllocNetPacket();
 }
 
@@ -25,6 +34,13 @@ ATestServerActor::ATestServerActor()
 void ATestServerActor::BeginPlay()
 {
 	Super::BeginPlay();
+
+	// last packet is recycled when it is replaced
+	Dispatcher = new FServoPacketDispatcher([this](const FServoPacketRef& InPacket)
+	{
+		LastPacket = InPacket;
+		TServoMessageDispatcher<ATestServerActor, FTestMoveMessage>::Dispatch(*this, *InPacket);
+	}, DispatchMaxPerFrame, DispatchBudgetMicroseconds);
 	
 	if (bListenInit)
 		RunServer();
@@ -34,7 +50,12 @@ void ATestServerActor::EndPlay(const EEndPlayReason::Type EndPlayReason)
 {
 	//release thread
 	ShutdownServer();
-	FServoProtocol::Get()->DeallockNetPacket(LastPacket);
+	if (Dispatcher)
+	{
+		delete Dispatcher;
+		Dispatcher = nullptr;
+	}
+	LastPacket.Reset();
 
 	Super::EndPlay(EndPlayReason);
 }
@@ -44,12 +65,14 @@ void ATestServerActor::Tick(float DeltaTime)
 {
 	Super::Tick(DeltaTime);
 
-	TSharedPtr<FSNetPacket, ESPMode::ThreadSafe> newPacket;
-	if (FServoProtocol::Get()->Pop(newPacket))
-	{
-		FServoProtocol::Get()->DeallockNetPacket(LastPacket);
-		LastPacket = MoveTemp(newPacket);
-	}
+	// packets are drained by Dispatcher
+}
+
+void ATestServerActor::OnMessage(const FTestMoveLayout & InMove, FSNetPacket & InPacket)
+{
+	LastMoveActor = InMove.actor;
+	LastMoveLocation = FVector(InMove.x, InMove.y, InMove.z);
+	++MoveMessageNum;
 }
 
 void ATestServerActor::RunServer(bool bRestart)
@@ -61,7 +84,8 @@ void ATestServerActor::RunServer(bool bRestart)
 
 	if (nullptr == ServerThread)
 	{
-		ServerThread = FListenThread::Create(Port, PoolTimespan);
+		FServoReactorThread::bUseUring = bUseUring;
+		ServerThread = FListenThread::Create(Port, PoolTimespan, ListenShardNum);
 	}
 }
 
@@ -108,16 +132,23 @@ int32 ATestServerActor::GetConnectPoolLifecycle()
 
 int32 ATestServerActor::GetConnectPoolLength()
 {
-	if (ServerThread)
+	int32 length = 0;
+	TArray<int32> nums = GetShardConnectionNums();
+	for (int32 i = 0; i < nums.Num(); ++i)
 	{
-		FConnectThreadPoolThread* poolThread = ServerThread->GetPoolThread();
+		length += nums[i];
+	}
+	return length;
+}
 
-		if (poolThread)
-		{
-			return poolThread->GetPoolLength();
-		}
+TArray<int32> ATestServerActor::GetShardConnectionNums()
+{
+	TArray<int32> nums;
+	if (ServerThread)
+	{
+		ServerThread->GetShardConnectionNums(nums);
 	}
-	return 0;
+	return nums;
 }
 
 float ATestServerActor::GetPoolTimespan()
@@ -233,4 +264,24 @@ int32 ATestServerActor::GetRecyclePoolNum()
 	return FServoProtocol::Get()->RecyclePoolNum();
 }
 
+int32 ATestServerActor::GetLastDrainNum()
+{
+	if (Dispatcher)
+	{
+		return Dispatcher->GetLastDrainNum();
+	}
+	return 0;
+}
+
+void ATestServerActor::LogDrainHistogram()
+{
+	if (Dispatcher)
+	{
+		Dispatcher->LogHistogram();
+	}
+}
 
+void ATestServerActor::LogCompressionStats()
+{
+	FServoProtocol::LogCompressionStats();
+}
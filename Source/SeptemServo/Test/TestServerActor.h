@@ -6,6 +6,8 @@
 #include "GameFramework/Actor.h"
 #include "../Threads/ListenThread.h"
 #include "../Protocol/ServoProtocol.h"
+#include "../Protocol/ServoPacketDispatcher.h"
+#include "TestServoMessage.h"
 #include "TestServerActor.generated.h"
 
 UCLASS()
@@ -31,6 +33,13 @@ public:
 protected:
 	FListenThread* ServerThread;
 
+	// drains packet pool each frame into LastPacket, known messages go to OnMessage
+	FServoPacketDispatcher* Dispatcher;
+
+public:
+	// called by TServoMessageDispatcher on game thread
+	void OnMessage(const FTestMoveLayout& InMove, FSNetPacket& InPacket);
+
 public:
 	UFUNCTION(BlueprintCallable, Category = "Server")
 	void RunServer(bool bRestart = false);
@@ -51,6 +60,10 @@ public:
 	UFUNCTION(BlueprintCallable, Category = "Server")
 		int32 GetConnectPoolLength();
 
+	// connections of each listener shard
+	UFUNCTION(BlueprintCallable, Category = "Server")
+		TArray<int32> GetShardConnectionNums();
+
 	UFUNCTION(BlueprintCallable, Category = "Server")
 		float GetPoolTimespan();
 
@@ -71,10 +84,26 @@ public:
 	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Actor)
 		float PoolTimespan;
 
+	// listener/reactor pairs on Port, balanced by SO_REUSEPORT
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Actor)
+		int32 ListenShardNum;
+
+	// reactors run on io_uring when the kernel supports it, epoll otherwise
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Actor)
+		bool bUseUring;
+
 	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Actor)
 		bool bCleanup;
 
-	TSharedPtr<FSNetPacket, ESPMode::ThreadSafe> LastPacket;
+	// max packets handled per frame, <= 0 means no limit
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Actor)
+		int32 DispatchMaxPerFrame;
+
+	// time budget of packets per frame, <= 0 means no limit
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Actor)
+		int32 DispatchBudgetMicroseconds;
+
+	FServoPacketRef LastPacket;
 	UFUNCTION(BlueprintCallable, Category = "Server")
 		int32 GetHeadSyncword();
 	UFUNCTION(BlueprintCallable, Category = "Server")
@@ -91,9 +120,27 @@ public:
 	UFUNCTION(BlueprintCallable, Category = "Server")
 		int32 GetTimestamp(int32 InPart = 0);
 
+	// last FTestMoveMessage received
+	UPROPERTY(BlueprintReadOnly, Category = "Server")
+		int32 LastMoveActor;
+	UPROPERTY(BlueprintReadOnly, Category = "Server")
+		FVector LastMoveLocation;
+	UPROPERTY(BlueprintReadOnly, Category = "Server")
+		int32 MoveMessageNum;
+
 	UFUNCTION(BlueprintCallable, Category = "Server")
 		int32 GetPacketPoolNum();
 
 	UFUNCTION(BlueprintCallable, Category = "Server")
 		int32 GetRecyclePoolNum();
+
+	UFUNCTION(BlueprintCallable, Category = "Server")
+		int32 GetLastDrainNum();
+
+	UFUNCTION(BlueprintCallable, Category = "Server")
+		void LogDrainHistogram();
+
+	// lz ratio of packets sent and received by this process
+	UFUNCTION(BlueprintCallable, Category = "Server")
+		void LogCompressionStats();
 };
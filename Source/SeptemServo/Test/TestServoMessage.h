@@ -0,0 +1,18 @@
+// Copyright (c) 2013-2019 7Mersenne All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "../Protocol/ServoMessage.hpp"
+
+// messages between test client and test server
+
+#pragma pack(push, 1)
+struct FTestMoveLayout
+{
+	int32 actor;
+	float x, y, z;
+};
+#pragma pack(pop)
+
+typedef TServoMessage<100, FTestMoveLayout> FTestMoveMessage;
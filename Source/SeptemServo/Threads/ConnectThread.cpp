@@ -3,9 +3,6 @@
 #include "ConnectThread.h"
 #include "../Protocol/ServoProtocol.h"
 
-// default buffer max  = 1mb
-int32 FConnectThread::MaxReceivedCount = 1024 * 1024;
-
 FConnectThread::FConnectThread()
 	:FRunnable()
 	, TimeToDie(false)
@@ -14,7 +11,6 @@ FConnectThread::FConnectThread()
 	, Port(3717)
 	, RankId(0)
 {
-	ReceivedData.Reset(MaxReceivedCount);
 }
 
 FConnectThread::FConnectThread(FSocket * InSocket, FIPv4Address & InIP, int32 InPort, int32 InRank)
@@ -24,8 +20,8 @@ FConnectThread::FConnectThread(FSocket * InSocket, FIPv4Address & InIP, int32 In
 	, ClientIPAdress(InIP)
 	, Port(InPort)
 	, RankId(InRank)
+	, Sender(InSocket)
 {
-	ReceivedData.Reset(MaxReceivedCount);
 }
 
 FConnectThread::~FConnectThread()
@@ -67,54 +63,73 @@ uint32 FConnectThread::Run()
 	while (!TimeToDie)
 	{
 		FPlatformProcess::Sleep(0.01f);
-		if (ConnectSocket->HasPendingData(pendingDataSize) && pendingDataSize > 0)
+		FlushSend();
+		// over high watermark leave bytes in kernel, tcp flow control slows the client
+		while (!TimeToDie && !ServoProtocol->IsBackpressure() && ConnectSocket->HasPendingData(pendingDataSize) && pendingDataSize > 0)
 		{
 			BytesRead = 0;
 			bRcev = false;
 
-			// read all buffer
-			ReceivedData.SetNumUninitialized(pendingDataSize);
-			// Attention: ReceivedData.Num must >= pendingDataSize
-			bRcev = ConnectSocket->Recv(ReceivedData.GetData(), ReceivedData.Num(), BytesRead);
+			// recv into a pooled slab, packet bodies are views into the slab
+			FSNetRecvSlab* RecvSlab = ServoProtocol->AllocRecvSlab();
+			const int32 RecvSize = FMath::Min<int32>(pendingDataSize, RecvSlab->GetCapacity());
+			bRcev = ConnectSocket->Recv(RecvSlab->GetData(), RecvSize, BytesRead);
+
+			if (!bRcev || BytesRead <= 0)
+			{
+				//Error: pendingDataSize>0 Rcev failed
+				UE_LOG(LogTemp, Display, TEXT("FConnectThread: pending data size > 0, rcev failed. Check the capacity of recv slab"));
+				RecvSlab->Release();
+				break;
+			}
+
+			if (BytesRead > RecvSize)
+			{
+				//stack overflow
+				UE_LOG(LogTemp, Display, TEXT("[Warnning]FConnectThread: receive stack overflow!\n"));
+				RecvSlab->Release();
+				continue;
+			}
+
+			UE_LOG(LogTemp, Display, TEXT("FConnectThread: receive byte = %d length = %d\n"), RecvSlab->GetData()[0], BytesRead);
 
-			if (bRcev && BytesRead > 0)
+			int32 TotalBytesRead = 0;
+			int32 RecivedBytesRead = 0;
+			// bytes read are always decoded, backpressure only stops the next recv
+			while (TotalBytesRead < BytesRead && !TimeToDie)
 			{
-				if (BytesRead > ReceivedData.Num())
+				// decode no more frames than the pool can take and this thread can park, wait for consumers when full
+				const int32 room = FMath::Min(ServoProtocol->GetPushHeadroom(), SERVO_PROTOCOL_PACKET_POOL_MAX - BatchPackets.Num());
+				if (room <= 0)
 				{
-					//stack overflow
-					UE_LOG(LogTemp, Display, TEXT("[Warnning]FConnectThread: receive stack overflow!\n"));
+					FPlatformProcess::Sleep(0.001f);
+					ServoProtocol->TryPushBatch(BatchPackets, RankId);
 					continue;
 				}
 
-				// TODO: recv data for while every syncword
-				UE_LOG(LogTemp, Display, TEXT("FConnectThread: receive byte = %d length = %d\n"), ReceivedData.GetData()[0], ReceivedData.Num());
-				
-				int32 TotalBytesRead = 0;
-				int32 RecivedBytesRead = 0;
-				while (TotalBytesRead < BytesRead && ServoProtocol->PacketPoolNum() < SERVO_PROTOCOL_PACKET_POOL_MAX)
-				{
-					TSharedPtr<FSNetPacket, ESPMode::ThreadSafe> pPacket(ServoProtocol->AllocNetPacket());
-					pPacket->ReUse(ReceivedData.GetData() + TotalBytesRead, ReceivedData.Num(), RecivedBytesRead);
-					TotalBytesRead += RecivedBytesRead;
-					UE_LOG(LogTemp, Display, TEXT("FConnectThread: write bytes %d, total write bytes %d \n"), RecivedBytesRead, TotalBytesRead);
-					
-					FPlatformMisc::MemoryBarrier();
-
-					if (pPacket->IsValid())
-					{
-						ServoProtocol->Push(pPacket);
-					}
-					else {
-						// packet is illegal, dealloc shared pointer
-						ServoProtocol->DeallockNetPacket(pPacket);
-					}
-				}
+				// decoder keeps the tail of a split frame until next recv
+				// packets of full lanes stay in BatchPackets, new packets go behind them
+				RecivedBytesRead = ServoProtocol->DecodeBatch(FrameDecoder, RecvSlab->GetData() + TotalBytesRead, BytesRead - TotalBytesRead,
+					BatchPackets, RecvSlab, room);
+				TotalBytesRead += RecivedBytesRead;
+				UE_LOG(LogTemp, Display, TEXT("FConnectThread: write bytes %d, total write bytes %d, packets %d \n"), RecivedBytesRead, TotalBytesRead, BatchPackets.Num());
+
+				FPlatformMisc::MemoryBarrier();
+
+				ServoProtocol->TryPushBatch(BatchPackets, RankId);
 			}
-			else {
-				//Error: pendingDataSize>0 Rcev failed
-				UE_LOG(LogTemp, Display, TEXT("FConnectThread: pending data size > 0, rcev failed. Check the length of ReceivedData.Num()"));
+
+			// parked packets go before the next recv
+			while (BatchPackets.Num() > 0 && !TimeToDie)
+			{
+				FPlatformProcess::Sleep(0.001f);
+				ServoProtocol->TryPushBatch(BatchPackets, RankId);
 			}
-			
+			BatchPackets.Reset();
+
+			// drop the reader reference, the slab will be recycled after the last packet view is deallocated
+			RecvSlab->Release();
+
 			// TODO: check disconnect
 		}
 	}
@@ -262,6 +277,34 @@ int32 FConnectThread::GetRankID() const
 	return RankId;
 }
 
+void FConnectThread::SendPacket(const FServoPacketRef& InPacket)
+{
+	FScopeLock lockOutbox(&OutboxCriticalSection);
+	Outbox.Add(InPacket);
+}
+
+void FConnectThread::FlushSend()
+{
+	{
+		FScopeLock lockOutbox(&OutboxCriticalSection);
+		for (int32 i = 0; i < Outbox.Num(); ++i)
+		{
+			Sender.Enqueue(Outbox[i]);
+		}
+		Outbox.Reset();
+	}
+
+	if (Sender.NumQueued() > 0)
+	{
+		int32 bytesSent = 0;
+		if (!Sender.Flush(bytesSent))
+		{
+			UE_LOG(LogTemp, Display, TEXT("FConnectThread: send failed, drop %d packets\n"), Sender.NumQueued());
+			Sender.Reset();
+		}
+	}
+}
+
 void FConnectThread::SafeDestorySocket()
 {
 	if (nullptr != ConnectSocket)
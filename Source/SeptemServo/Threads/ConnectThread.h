@@ -5,6 +5,8 @@
 #include "CoreMinimal.h"
 #include "Core/Private/HAL/PThreadRunnableThread.h"
 #include "Networking.h"
+#include "../Protocol/ServoFrameDecoder.h"
+#include "../Protocol/ServoGatherSender.h"
 
 /**
  * 
@@ -38,6 +40,9 @@ public:
 	bool IsExited();
 	int32 GetRankID() const;
 
+	// thread safe; queue sealed packet, sent by this connection thread in batch
+	void SendPacket(const FServoPacketRef& InPacket);
+
 private:
 	//---------------------------------------------
 	// thread control
@@ -69,8 +74,19 @@ private:
 	int32 Port;										// client Port
 	int32 RankId;									// rank id
 
-	TArray<uint8> ReceivedData;
-	static int32 MaxReceivedCount; // = 1024 * 1024;
+	// carry frames split by recv
+	FServoFrameDecoder FrameDecoder;
+	// packets decoded from one recv, packets of full lanes wait here
+	TArray<FServoPacketRef> BatchPackets;
+
+	// packets queued by other threads
+	FCriticalSection OutboxCriticalSection;
+	TArray<FServoPacketRef> Outbox;
+	// head, body and foot of queued packets go to socket in place
+	FServoGatherSender Sender;
+
+	// move outbox to sender and send as much as socket takes
+	void FlushSend();
 
 	void SafeDestorySocket();
 };
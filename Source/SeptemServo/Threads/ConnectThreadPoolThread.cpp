@@ -41,6 +41,7 @@ FConnectThreadPoolThread::~FConnectThreadPoolThread()
 
 	SafeCleanupPool();
 	SafeCleanupQueue();
+	SafeCleanupReactors();
 }
 
 bool FConnectThreadPoolThread::Init()
@@ -62,6 +63,9 @@ uint32 FConnectThreadPoolThread::Run()
 	{
 		FPlatformProcess::Sleep(SleepTimeSpan);
 
+		// grow/trim packet recycle pool here, off the connection threads
+		FServoProtocol::Get()->MaintainRecyclePool();
+
 		if (bCleanup) {
 			// remove disconnected client
 			for (int32 i = ConnectThreadPool.Num() - 1; i >= 0; --i)
@@ -171,6 +175,17 @@ void FConnectThreadPoolThread::SafeCleanupPool()
 }
 
 
+void FConnectThreadPoolThread::SafeCleanupReactors()
+{
+	// reactors close their connections on exit
+	for (int32 i = 0; i < Reactors.Num(); ++i)
+	{
+		Reactors[i]->KillThread();
+		delete Reactors[i];
+	}
+	Reactors.Empty();
+}
+
 void FConnectThreadPoolThread::SafeCleanupQueue()
 {
 	if (DestructQueue.IsEmpty())
@@ -218,6 +233,7 @@ bool FConnectThreadPoolThread::KillThread()
 
 			SafeCleanupPool();
 			SafeCleanupQueue();
+			SafeCleanupReactors();
 
 			// Clean up the event
 			// if(event) FPlatformProcess::ReturnSynchEventToPool(event);
@@ -234,11 +250,21 @@ bool FConnectThreadPoolThread::KillThread()
 	return bKillDone;
 }
 
-FConnectThreadPoolThread * FConnectThreadPoolThread::Create(int32 InMaxBacklog, float InPoolTimespan)
+FConnectThreadPoolThread * FConnectThreadPoolThread::Create(int32 InMaxBacklog, float InPoolTimespan, int32 InReactorNum)
 {
 	FConnectThreadPoolThread* runnable = new FConnectThreadPoolThread(InMaxBacklog);
 
 	runnable->SleepTimeSpan = InPoolTimespan;
+
+	// reactors are ready before the first accept
+	for (int32 i = 0; i < InReactorNum; ++i)
+	{
+		FServoReactorThread* reactor = FServoReactorThread::Create(i);
+		if (nullptr != reactor)
+		{
+			runnable->Reactors.Add(reactor);
+		}
+	}
 	
 	// create thread with runnable
 	FRunnableThread* thread = FRunnableThread::Create(runnable, TEXT("FConnectThreadPoolThread"), 0, TPri_BelowNormal); //windows default = 8mb for thread, could specify 
@@ -266,6 +292,61 @@ void FConnectThreadPoolThread::SafeHoldThread(FConnectThread * InThread)
 	}
 }
 
+bool FConnectThreadPoolThread::SafeHoldConnection(FSocket * InSocket, const FIPv4Address & InIP, int32 InPort, int32 InRank)
+{
+	if (nullptr == InSocket)
+		return false;
+
+	if (Reactors.Num() == 0)
+	{
+		FIPv4Address ip = InIP;
+		FConnectThread* connectThread = FConnectThread::Create(InSocket, ip, InPort, InRank);
+		if (nullptr == connectThread)
+		{
+			InSocket->Close();
+			ISocketSubsystem::Get(PLATFORM_SOCKETSUBSYSTEM)->DestroySocket(InSocket);
+			return false;
+		}
+		SafeHoldThread(connectThread);
+		return true;
+	}
+
+	// least loaded reactor
+	FServoReactorThread* reactor = Reactors[0];
+	for (int32 i = 1; i < Reactors.Num(); ++i)
+	{
+		if (Reactors[i]->GetConnectionNum() < reactor->GetConnectionNum())
+		{
+			reactor = Reactors[i];
+		}
+	}
+
+	reactor->AddConnection(new FServoConnection(InSocket, InIP, InPort, InRank));
+	return true;
+}
+
+bool FConnectThreadPoolThread::SendPacket(int32 InRank, const FServoPacketRef & InPacket)
+{
+	for (int32 i = 0; i < Reactors.Num(); ++i)
+	{
+		if (Reactors[i]->SendPacket(InRank, InPacket))
+		{
+			return true;
+		}
+	}
+
+	FScopeLock lockPool(&ThreadPoolLock);
+	for (int32 i = 0; i < ConnectThreadPool.Num(); ++i)
+	{
+		if (ConnectThreadPool[i] && ConnectThreadPool[i]->GetRankID() == InRank)
+		{
+			ConnectThreadPool[i]->SendPacket(InPacket);
+			return true;
+		}
+	}
+	return false;
+}
+
 bool FConnectThreadPoolThread::IsKillDone()
 {
 	bool ret = bKillDone;
@@ -279,8 +360,19 @@ int32 FConnectThreadPoolThread::GetLifecycleStep()
 
 int32 FConnectThreadPoolThread::GetPoolLength()
 {
+	int32 length = 0;
+	for (int32 i = 0; i < Reactors.Num(); ++i)
+	{
+		length += Reactors[i]->GetConnectionNum();
+	}
+
 	FScopeLock lockPool(&ThreadPoolLock);
-	return ConnectThreadPool.Num();
+	return length + ConnectThreadPool.Num();
+}
+
+int32 FConnectThreadPoolThread::GetReactorNum()
+{
+	return Reactors.Num();
 }
 
 void FConnectThreadPoolThread::SetCleanupTimespan(float InTimespan)
@@ -6,6 +6,7 @@
 #include "Core/Private/HAL/PThreadRunnableThread.h"
 #include "Networking.h"
 #include "ConnectThread.h"
+#include "ServoReactorThread.h"
 
 /**
  * 
@@ -56,6 +57,10 @@ private:
 	void SafeCleanupPool();
 	void SafeCleanupQueue();
 
+	// connections accepted by SafeHoldConnection are served by reactors
+	TArray<FServoReactorThread*> Reactors;
+	void SafeCleanupReactors();
+
 	float SleepTimeSpan;
 public:
 	//-------------------------------------------------------------------
@@ -67,15 +72,27 @@ public:
 	// must use KillThread to void deadlock
 	// if you use thread->kill() directly , easy to get deadlock or crash
 	bool KillThread();// use KillThread instead of thread->kill
-	static FConnectThreadPoolThread* Create(int32 InMaxBacklog = 100, float InPoolTimespan = 0.05f);
+	static FConnectThreadPoolThread* Create(int32 InMaxBacklog = 100, float InPoolTimespan = 0.05f, int32 InReactorNum = SERVO_REACTOR_THREAD_NUM);
 	void SafeHoldThread(FConnectThread* InThread);
 
+	/**
+	 * thread safe; hand accepted non-blocking socket to the reactor with fewest connections
+	 * without reactor the socket gets its own FConnectThread
+	 * @return false if the connection can't be served, the socket is destroyed
+	 */
+	bool SafeHoldConnection(FSocket* InSocket, const FIPv4Address& InIP, int32 InPort, int32 InRank);
+
+	// thread safe; queue packet to the connection of InRank, false if not found
+	bool SendPacket(int32 InRank, const FServoPacketRef& InPacket);
+
 	// state
 	bool IsKillDone();
 	int32 GetLifecycleStep();
 
 	// debug info
+	// connect threads and reactor connections
 	int32 GetPoolLength();
+	int32 GetReactorNum();
 
 public:
 	//-------------------------------------------------------------------
@@ -2,6 +2,19 @@
 
 #include "ListenThread.h"
 
+#if SERVO_LISTEN_REUSEPORT || SERVO_LISTEN_EPOLL
+#include "../Protocol/ServoNativeSocket.h"
+#include <sys/socket.h>
+#include <errno.h>
+#endif // SERVO_LISTEN_REUSEPORT || SERVO_LISTEN_EPOLL
+
+#if SERVO_LISTEN_EPOLL
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <netinet/in.h>
+#include <unistd.h>
+#endif // SERVO_LISTEN_EPOLL
+
 FListenThread::FListenThread()
 	:FRunnable()
 	, TimeToDie(false)
@@ -10,15 +23,30 @@ FListenThread::FListenThread()
 	, Port(3717)
 	, MaxBacklog(100)
 	, PoolTimespan(0)
+	, ReactorNum(SERVO_REACTOR_THREAD_NUM)
+	, ShardIndex(0)
+	, ShardNum(1)
 	, ListenerSocket(nullptr)
 	, Thread(nullptr)
 	, RankId(0)
 	, ConnectionPoolThread(nullptr)
 {
+#if SERVO_LISTEN_EPOLL
+	EpollFd = -1;
+	WakeFd = -1;
+#endif // SERVO_LISTEN_EPOLL
 }
 
 FListenThread::~FListenThread()
 {
+	// shards are owned by shard 0
+	for (int32 i = 0; i < Shards.Num(); ++i)
+	{
+		Shards[i]->KillThread();
+		delete Shards[i];
+	}
+	Shards.Empty();
+
 	// cleanup thread
 	if (nullptr != Thread)
 	{
@@ -30,6 +58,19 @@ FListenThread::~FListenThread()
 
 	// cleanup init ptr
 	SafeDestorySocket();
+
+#if SERVO_LISTEN_EPOLL
+	if (WakeFd >= 0)
+	{
+		close(WakeFd);
+		WakeFd = -1;
+	}
+	if (EpollFd >= 0)
+	{
+		close(EpollFd);
+		EpollFd = -1;
+	}
+#endif // SERVO_LISTEN_EPOLL
 }
 
 bool FListenThread::Init()
@@ -47,6 +88,20 @@ bool FListenThread::Init()
 		return false;
 	}
 
+#if SERVO_LISTEN_REUSEPORT
+	// every shard binds the same port, must be set before bind
+	if (ShardNum > 1)
+	{
+		int32 enable = 1;
+		const int32 fd = GetNativeSocketHandle(ListenerSocket);
+		if (0 != setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &enable, sizeof(enable)))
+		{
+			UE_LOG(LogTemp, Display, TEXT("ListenerSocket: failed to set SO_REUSEPORT, errno %d, shard = %d\n"), errno, ShardIndex);
+			return false;
+		}
+	}
+#endif // SERVO_LISTEN_REUSEPORT
+
 	// 2. bind socket
 	TSharedRef<FInternetAddr> addr = ISocketSubsystem::Get(PLATFORM_SOCKETSUBSYSTEM)->CreateInternetAddr();
 	addr->SetIp(IPAdress.Value);
@@ -67,6 +122,25 @@ bool FListenThread::Init()
 
 	UE_LOG(LogTemp, Display, TEXT("ListenerSocket: server listening\n"));
 
+#if SERVO_LISTEN_EPOLL
+	// listen socket is level-triggered, connections left by a full batch wake the next wait
+	ListenerSocket->SetNonBlocking(true);
+	EpollFd = epoll_create1(EPOLL_CLOEXEC);
+	WakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (EpollFd < 0 || WakeFd < 0)
+	{
+		UE_LOG(LogTemp, Display, TEXT("ListenerSocket: failed to create epoll, errno %d\n"), errno);
+		return false;
+	}
+
+	struct epoll_event event;
+	event.events = EPOLLIN;
+	event.data.fd = GetNativeSocketHandle(ListenerSocket);
+	epoll_ctl(EpollFd, EPOLL_CTL_ADD, event.data.fd, &event);
+	event.data.fd = WakeFd;
+	epoll_ctl(EpollFd, EPOLL_CTL_ADD, WakeFd, &event);
+#endif // SERVO_LISTEN_EPOLL
+
 	// <----- insert:  create connection pool
 	SafeConstructConnectionPool();
 
@@ -79,56 +153,136 @@ bool FListenThread::Init()
 uint32 FListenThread::Run()
 {
 	LifecycleStep.Set(2);
-	bool bHasPendingConnection = false;
 	if (nullptr == ListenerSocket) return 1ui32;  //exit code == 1 : thread run failed
+
+#if SERVO_LISTEN_EPOLL
+	struct epoll_event events[2];
 	while (!TimeToDie)
 	{
-		if (ListenerSocket->HasPendingConnection(bHasPendingConnection))
+		// sleep in kernel until a client connects or Stop wakes us
+		const int32 num = epoll_wait(EpollFd, events, 2, SERVO_REACTOR_WAIT_MS);
+		if (num < 0 && EINTR != errno)
 		{
-			if (!bHasPendingConnection)
+			UE_LOG(LogTemp, Display, TEXT("ListenerSocket: epoll_wait failed, errno %d\n"), errno);
+			return 1ui32;
+		}
+
+		for (int32 i = 0; i < num; ++i)
+		{
+			if (events[i].data.fd == WakeFd)
 			{
-				//no pending connection
-				//FPlatformProcess::Sleep(0.02f);
-				continue;
+				uint64 value = 0;
+				read(WakeFd, &value, sizeof(value));
 			}
-
-			//FPlatformMisc::MemoryBarrier();
-
-			TSharedRef<FInternetAddr> clientAddr = ISocketSubsystem::Get(PLATFORM_SOCKETSUBSYSTEM)->CreateInternetAddr();
-			// accept with description = client {Rank Id}
-			FSocket* ConnectSocket = ListenerSocket->Accept(*clientAddr, FString::Printf(TEXT("ListenServer%d"), RankId));
-
-			if(nullptr == ConnectSocket)
+			else if (!AcceptBatch())
 			{
-				UE_LOG(LogTemp, Display, TEXT("ListenerSocket: accept null socket, listener cannot read and write \n"));
-				// break and close the thread
 				return 1ui32;
 			}
+		}
+	}
+#else
+	bool bHasPendingConnection = false;
+	while (!TimeToDie)
+	{
+		// block with timeout instead of spinning, Stop is seen within one timeout
+		if (!ListenerSocket->WaitForPendingConnection(bHasPendingConnection, FTimespan::FromMilliseconds(SERVO_REACTOR_WAIT_MS)))
+		{
+			UE_LOG(LogTemp, Display, TEXT("ListenerSocket: throw error when pending connection\n"));
+			FPlatformProcess::Sleep(0.01f);
+			continue;
+		}
 
-			UE_LOG(LogTemp, Display, TEXT("ListenerSocket: connect socket ptr = %d  ip =  %s\n"), ConnectSocket, *FIPv4Endpoint(clientAddr).ToString());
-
-			//check(ConnectSocket && "ConnectSocket == nullptr");
-			// connectThread will hold the ConnectSocket ptr, Don't care about it in this thread
-			ConnectSocket->SetNonBlocking(true);
+		if (bHasPendingConnection && !AcceptBatch())
+		{
+			return 1ui32;
+		}
+	}
+#endif // SERVO_LISTEN_EPOLL
 
-			FPlatformMisc::MemoryBarrier();
-			FIPv4Endpoint endPoint(clientAddr);
+	//FPlatformMisc::MemoryBarrier();
+	return 0;
+}
 
-			UE_LOG(LogTemp, Display, TEXT("ListenerSocket: accept client ip = %s \n"), *endPoint.ToString());
+bool FListenThread::AcceptBatch()
+{
+#if SERVO_LISTEN_EPOLL
+	const int32 listenFd = GetNativeSocketHandle(ListenerSocket);
 
-			FConnectThread* connectThread = FConnectThread::Create(ConnectSocket, endPoint.Address, endPoint.Port, RankId);
-			if (connectThread != nullptr)
+	for (int32 i = 0; i < SERVO_LISTEN_ACCEPT_BATCH && !TimeToDie; ++i)
+	{
+		// socket is non-blocking from accept, no extra fcntl
+		struct sockaddr_in clientAddr;
+		socklen_t addrSize = sizeof(clientAddr);
+		const int32 fd = accept4(listenFd, (struct sockaddr*)&clientAddr, &addrSize, SOCK_NONBLOCK | SOCK_CLOEXEC);
+		if (fd < 0)
+		{
+			if (EINTR == errno || ECONNABORTED == errno)
+				continue;
+			if (EAGAIN == errno || EWOULDBLOCK == errno)
+				break;
+			if (EMFILE == errno || ENFILE == errno || ENOBUFS == errno || ENOMEM == errno)
 			{
-				ConnectionPoolThread->SafeHoldThread(connectThread);
-				++RankId;
+				// out of resources, connection stays in backlog; don't spin on level-triggered listen socket
+				UE_LOG(LogTemp, Display, TEXT("ListenerSocket: accept4 out of resources, errno %d\n"), errno);
+				FPlatformProcess::Sleep(0.01f);
+				break;
 			}
+
+			UE_LOG(LogTemp, Display, TEXT("ListenerSocket: accept4 failed, errno %d, listener cannot read and write \n"), errno);
+			return false;
 		}
-		else {
-			UE_LOG(LogTemp, Display, TEXT("ListenerSocket: throw error when pending connection\n"));
+
+		// accept with description = client {Rank Id}
+		FSocket* ConnectSocket = CreateSocketFromNativeHandle(fd, FString::Printf(TEXT("ListenServer%d"), RankId));
+		if (nullptr == ConnectSocket)
+		{
+			close(fd);
+			continue;
 		}
+
+		HoldConnection(ConnectSocket, FIPv4Address(ntohl(clientAddr.sin_addr.s_addr)), ntohs(clientAddr.sin_port));
+	}
+#else
+	bool bHasPendingConnection = true;
+	for (int32 i = 0; i < SERVO_LISTEN_ACCEPT_BATCH && bHasPendingConnection && !TimeToDie; ++i)
+	{
+		TSharedRef<FInternetAddr> clientAddr = ISocketSubsystem::Get(PLATFORM_SOCKETSUBSYSTEM)->CreateInternetAddr();
+		// accept with description = client {Rank Id}
+		FSocket* ConnectSocket = ListenerSocket->Accept(*clientAddr, FString::Printf(TEXT("ListenServer%d"), RankId));
+
+		if (nullptr == ConnectSocket)
+		{
+			UE_LOG(LogTemp, Display, TEXT("ListenerSocket: accept null socket, listener cannot read and write \n"));
+			// break and close the thread
+			return false;
+		}
+
+		// connectThread will hold the ConnectSocket ptr, Don't care about it in this thread
+		ConnectSocket->SetNonBlocking(true);
+
+		FIPv4Endpoint endPoint(clientAddr);
+		HoldConnection(ConnectSocket, endPoint.Address, endPoint.Port);
+
+		if (!ListenerSocket->HasPendingConnection(bHasPendingConnection))
+		{
+			break;
+		}
+	}
+#endif // SERVO_LISTEN_EPOLL
+
+	return true;
+}
+
+void FListenThread::HoldConnection(FSocket * InSocket, const FIPv4Address & InIP, int32 InPort)
+{
+	UE_LOG(LogTemp, Display, TEXT("ListenerSocket: accept client ip = %s \n"), *FIPv4Endpoint(InIP, InPort).ToString());
+
+	// reactors of connection pool serve the socket, no thread per connection
+	if (ConnectionPoolThread->SafeHoldConnection(InSocket, InIP, InPort, RankId))
+	{
+		RankId += ShardNum;
+		AcceptedNum.Increment();
 	}
-	//FPlatformMisc::MemoryBarrier();
-	return 0;
 }
 
 void FListenThread::Stop()
@@ -146,6 +300,15 @@ void FListenThread::Stop()
 			ListenerSocket->Shutdown(ESocketShutdownMode::ReadWrite);
 		}
 
+#if SERVO_LISTEN_EPOLL
+		// wake epoll_wait
+		if (WakeFd >= 0)
+		{
+			const uint64 value = 1;
+			write(WakeFd, &value, sizeof(value));
+		}
+#endif // SERVO_LISTEN_EPOLL
+
 		bStopped = true;
 	}
 }
@@ -172,6 +335,14 @@ bool FListenThread::KillThread()
 {
 	bool bDidExit = true;
 
+	// shards are owned by shard 0
+	for (int32 i = 0; i < Shards.Num(); ++i)
+	{
+		bDidExit = Shards[i]->KillThread() && bDidExit;
+		delete Shards[i];
+	}
+	Shards.Empty();
+
 	TimeToDie = true;
 
 	if (nullptr != Thread)
@@ -200,7 +371,38 @@ bool FListenThread::KillThread()
 	return bDidExit;
 }
 
-FListenThread * FListenThread::Create(int32 InPort, float InPoolTimespan)
+FListenThread * FListenThread::Create(int32 InPort, float InPoolTimespan, int32 InShardNum, int32 InReactorNum)
+{
+	int32 shardNum = FMath::Max(InShardNum, 1);
+#if !SERVO_LISTEN_REUSEPORT
+	if (shardNum > 1)
+	{
+		UE_LOG(LogTemp, Display, TEXT("FListenThread: SO_REUSEPORT does not balance accepts here, create 1 listener instead of %d\n"), shardNum);
+		shardNum = 1;
+	}
+#endif // !SERVO_LISTEN_REUSEPORT
+
+	const int32 reactorNum = InReactorNum > 0 ? InReactorNum : FMath::Max(SERVO_REACTOR_THREAD_NUM / shardNum, 1);
+
+	FListenThread* primary = CreateShard(InPort, InPoolTimespan, 0, shardNum, reactorNum);
+	if (nullptr == primary)
+	{
+		return nullptr;
+	}
+
+	for (int32 i = 1; i < shardNum; ++i)
+	{
+		FListenThread* shard = CreateShard(InPort, InPoolTimespan, i, shardNum, reactorNum);
+		if (nullptr != shard)
+		{
+			primary->Shards.Add(shard);
+		}
+	}
+
+	return primary;
+}
+
+FListenThread * FListenThread::CreateShard(int32 InPort, float InPoolTimespan, int32 InShardIndex, int32 InShardNum, int32 InReactorNum)
 {
 	// if you need create event
 	//Event = FPlatformProcess::GetSynchEventFromPool();
@@ -209,9 +411,14 @@ FListenThread * FListenThread::Create(int32 InPort, float InPoolTimespan)
 	FListenThread* runnable = new FListenThread();
 	runnable->Port = InPort;
 	runnable->PoolTimespan = InPoolTimespan;
+	runnable->ReactorNum = InReactorNum;
+	runnable->ShardIndex = InShardIndex;
+	runnable->ShardNum = InShardNum;
+	runnable->RankId = InShardIndex;
 
 	// create thread with runnable
-	FRunnableThread* thread = FRunnableThread::Create(runnable, TEXT("FListenThread"), 0, TPri_BelowNormal); //windows default = 8mb for thread, could specify 
+	FString threadName = FString::Printf(TEXT("FListenThread%d"), InShardIndex);
+	FRunnableThread* thread = FRunnableThread::Create(runnable, *threadName, 0, TPri_BelowNormal); //windows default = 8mb for thread, could specify 
 	
 	if (nullptr == thread)
 	{
@@ -249,6 +456,32 @@ int32 FListenThread::GetRankID()
 	return RankId;
 }
 
+int32 FListenThread::GetShardNum()
+{
+	return 1 + Shards.Num();
+}
+
+void FListenThread::GetShardConnectionNums(TArray<int32>& OutNums)
+{
+	OutNums.Reset(GetShardNum());
+	OutNums.Add(ConnectionPoolThread ? ConnectionPoolThread->GetPoolLength() : 0);
+	for (int32 i = 0; i < Shards.Num(); ++i)
+	{
+		FConnectThreadPoolThread* poolThread = Shards[i]->GetPoolThread();
+		OutNums.Add(poolThread ? poolThread->GetPoolLength() : 0);
+	}
+}
+
+void FListenThread::GetShardAcceptedNums(TArray<int32>& OutNums)
+{
+	OutNums.Reset(GetShardNum());
+	OutNums.Add(AcceptedNum.GetValue());
+	for (int32 i = 0; i < Shards.Num(); ++i)
+	{
+		OutNums.Add(Shards[i]->AcceptedNum.GetValue());
+	}
+}
+
 void FListenThread::SafeDestorySocket()
 {
 	if (nullptr != ListenerSocket)
@@ -263,7 +496,7 @@ void FListenThread::SafeConstructConnectionPool()
 {
 	if (nullptr == ConnectionPoolThread)
 	{ 
-		ConnectionPoolThread = FConnectThreadPoolThread::Create(MaxBacklog, PoolTimespan);
+		ConnectionPoolThread = FConnectThreadPoolThread::Create(MaxBacklog, PoolTimespan, ReactorNum);
 		UE_LOG(LogTemp, Display, TEXT("ListenerSocket: init connection pool \n"));
 	}
 }
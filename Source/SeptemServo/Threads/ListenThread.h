@@ -7,6 +7,30 @@
 #include "Networking.h"
 #include "ConnectThreadPoolThread.h"
 
+/*
+* Listener shards bind the same port with SO_REUSEPORT, kernel balances accepts between them
+* without it FListenThread::Create makes one listener.
+* linux only: bsd and mac accept SO_REUSEPORT but hand every connection to one socket
+*/
+#ifndef SERVO_LISTEN_REUSEPORT
+#define SERVO_LISTEN_REUSEPORT PLATFORM_LINUX
+#endif // !SERVO_LISTEN_REUSEPORT
+
+/*
+* Listener waits listen socket with epoll and accepts with accept4(SOCK_NONBLOCK)
+* other platforms block in WaitForPendingConnection with timeout
+*/
+#ifndef SERVO_LISTEN_EPOLL
+#define SERVO_LISTEN_EPOLL SERVO_REACTOR_EPOLL
+#endif // !SERVO_LISTEN_EPOLL
+
+/*
+* Max connections accepted per wakeup, the rest are accepted on next wakeup
+*/
+#ifndef SERVO_LISTEN_ACCEPT_BATCH
+#define SERVO_LISTEN_ACCEPT_BATCH 64
+#endif // !SERVO_LISTEN_ACCEPT_BATCH
+
  /**
  * litsen runnable for server thread
  */
@@ -29,7 +53,15 @@ public:
 	// must use KillThread to void deadlock
 	// if you use thread->kill() directly , easy to get deadlock or crash
 	bool KillThread();// use KillThread instead of thread->kill
-	static FListenThread* Create(int32 InPort = 3717, float InPoolTimespan = 0.05f);
+
+	/**
+	 * Create InShardNum listener/reactor pairs on InPort.
+	 * each shard has its own listen socket and connection pool, clients never move between shards.
+	 * the returned thread is shard 0, it owns and kills the other shards
+	 * @param InShardNum		listener shards, 1 without SO_REUSEPORT
+	 * @param InReactorNum		reactors per shard, <= 0 splits SERVO_REACTOR_THREAD_NUM between shards
+	 */
+	static FListenThread* Create(int32 InPort = 3717, float InPoolTimespan = 0.05f, int32 InShardNum = 1, int32 InReactorNum = 0);
 
 	int32 GetLifecycleStep();
 	int32 GetPoolLifecycleStep();
@@ -37,7 +69,16 @@ public:
 	// [Dangerous call] only for debug info
 	FConnectThreadPoolThread* GetPoolThread();
 	int32 GetRankID();
+
+	// shards created by shard 0, 1 for a single listener
+	int32 GetShardNum();
+	// thread safe; connections served by each shard, index is shard
+	void GetShardConnectionNums(TArray<int32>& OutNums);
+	// thread safe; connections accepted by each shard since start
+	void GetShardAcceptedNums(TArray<int32>& OutNums);
 private:
+	static FListenThread* CreateShard(int32 InPort, float InPoolTimespan, int32 InShardIndex, int32 InShardNum, int32 InReactorNum);
+
 	//---------------------------------------------
 	// thread control
 	//---------------------------------------------
@@ -60,18 +101,36 @@ private:
 	int32 Port;
 	int32 MaxBacklog;				// max count of client
 	float PoolTimespan;
+	int32 ReactorNum;				// reactors of connection pool
+
+	// this listener is shard ShardIndex of ShardNum on the same port
+	int32 ShardIndex;
+	int32 ShardNum;
+	// shards 1..N-1, owned by shard 0
+	TArray<FListenThread*> Shards;
+	FThreadSafeCounter AcceptedNum;
 
 	// socket
 	FSocket* ListenerSocket;
 	void SafeDestorySocket();
 
+	// accept pending connections, up to SERVO_LISTEN_ACCEPT_BATCH; false on fatal listen error
+	bool AcceptBatch();
+	// hand accepted socket to connection pool
+	void HoldConnection(FSocket* InSocket, const FIPv4Address& InIP, int32 InPort);
+#if SERVO_LISTEN_EPOLL
+	int32 EpollFd;
+	// eventfd in epoll set, written by Stop
+	int32 WakeFd;
+#endif // SERVO_LISTEN_EPOLL
+
 	// server listen thread
 	FRunnableThread* Thread;
 
 	//---------------------------------------------
 	// client connections
 	//---------------------------------------------
-	int32 RankId;	// consider volatile 
+	int32 RankId;	// consider volatile, shards step by ShardNum so ranks are unique over all shards
 
 	FConnectThreadPoolThread* ConnectionPoolThread;
 	void SafeConstructConnectionPool();
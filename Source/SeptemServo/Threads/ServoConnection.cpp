@@ -0,0 +1,206 @@
+// Copyright (c) 2013-2019 7Mersenne All Rights Reserved.
+
+#include "ServoConnection.h"
+
+#include "Misc/ScopeLock.h"
+
+#if SERVO_PROTOCOL_GATHER_SEND
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+// kernel reads the message until the async send completes
+struct FServoAsyncSend
+{
+	struct msghdr Message;
+	struct iovec Iovecs[SERVO_PROTOCOL_SEND_BATCH_MAX * 3];
+};
+#endif // SERVO_PROTOCOL_GATHER_SEND
+
+FServoConnection::FServoConnection(FSocket * InSocket, const FIPv4Address & InIP, int32 InPort, int32 InRank)
+	: bReadPaused(false)
+	, bRecvArmed(false)
+	, bSendArmed(false)
+	, bClosing(false)
+	, Socket(InSocket)
+	, ClientIPAdress(InIP)
+	, Port(InPort)
+	, RankId(InRank)
+	, Sender(InSocket)
+#if SERVO_PROTOCOL_GATHER_SEND
+	, AsyncSend(nullptr)
+#endif // SERVO_PROTOCOL_GATHER_SEND
+{
+}
+
+FServoConnection::~FServoConnection()
+{
+	// queued packets are recycled with their refs
+	Sender.Reset();
+	Sender.SetSocket(nullptr);
+
+	for (int32 i = 0; i < PendingRecvs.Num(); ++i)
+	{
+		PendingRecvs[i].Slab->Release();
+	}
+	PendingRecvs.Reset();
+
+#if SERVO_PROTOCOL_GATHER_SEND
+	if (nullptr != AsyncSend)
+	{
+		delete AsyncSend;
+		AsyncSend = nullptr;
+	}
+#endif // SERVO_PROTOCOL_GATHER_SEND
+
+	if (nullptr != Socket)
+	{
+		Socket->Close();
+		ISocketSubsystem::Get(PLATFORM_SOCKETSUBSYSTEM)->DestroySocket(Socket);
+		Socket = nullptr;
+	}
+}
+
+FSocket * FServoConnection::GetSocket() const
+{
+	return Socket;
+}
+
+const FIPv4Address & FServoConnection::GetIP() const
+{
+	return ClientIPAdress;
+}
+
+int32 FServoConnection::GetPort() const
+{
+	return Port;
+}
+
+int32 FServoConnection::GetRankID() const
+{
+	return RankId;
+}
+
+bool FServoConnection::OnReceived(FSNetRecvSlab * InSlab, int32 InBytes)
+{
+	// bytes go behind the ones still waiting, the slab stays alive while they wait
+	InSlab->AddRef();
+	PendingRecvs.Add(FPendingRecv(InSlab, 0, InBytes));
+	return ResumeReceived();
+}
+
+bool FServoConnection::ResumeReceived()
+{
+	FServoProtocol* ServoProtocol = FServoProtocol::Get();
+
+	// packets of full lanes go before newer ones of the same lane
+	if (ParkedPackets.Num() > 0)
+	{
+		ServoProtocol->TryPushBatch(ParkedPackets, RankId);
+	}
+
+	while (PendingRecvs.Num() > 0)
+	{
+		FPendingRecv& pending = PendingRecvs[0];
+		while (pending.Offset < pending.End)
+		{
+			// decode no more frames than the pool can take and the connection can park
+			const int32 room = FMath::Min(ServoProtocol->GetPushHeadroom(), SERVO_PROTOCOL_PACKET_POOL_MAX - ParkedPackets.Num());
+			if (room <= 0)
+			{
+				return false;
+			}
+
+			// decoder keeps the tail of a split frame until next recv
+			// new packets go behind parked ones, one push keeps the order of each lane
+			pending.Offset += ServoProtocol->DecodeBatch(FrameDecoder, pending.Slab->GetData() + pending.Offset, pending.End - pending.Offset,
+				ParkedPackets, pending.Slab, room);
+			ServoProtocol->TryPushBatch(ParkedPackets, RankId);
+		}
+
+		pending.Slab->Release();
+		PendingRecvs.RemoveAt(0, 1, false);
+	}
+
+	return 0 == ParkedPackets.Num();
+}
+
+bool FServoConnection::HasPendingReceived() const
+{
+	return PendingRecvs.Num() > 0 || ParkedPackets.Num() > 0;
+}
+
+bool FServoConnection::SendPacket(const FServoPacketRef & InPacket)
+{
+	FScopeLock lockOutbox(&OutboxCriticalSection);
+	Outbox.Add(InPacket);
+	return 1 == Outbox.Num();
+}
+
+bool FServoConnection::FlushSend()
+{
+	MoveOutbox();
+
+	if (Sender.NumQueued() > 0)
+	{
+		int32 bytesSent = 0;
+		if (!Sender.Flush(bytesSent))
+		{
+			UE_LOG(LogTemp, Display, TEXT("FServoConnection: send failed, drop %d packets, rank = %d\n"), Sender.NumQueued(), RankId);
+			Sender.Reset();
+			return false;
+		}
+	}
+	return true;
+}
+
+bool FServoConnection::HasPendingSend() const
+{
+	return Sender.NumQueued() > 0;
+}
+
+#if SERVO_PROTOCOL_GATHER_SEND
+const struct msghdr * FServoConnection::PrepareAsyncSend()
+{
+	MoveOutbox();
+
+	if (nullptr == AsyncSend)
+	{
+		AsyncSend = new FServoAsyncSend();
+	}
+
+	const int32 iovNum = Sender.PrepareBatch(AsyncSend->Iovecs);
+	if (0 == iovNum)
+	{
+		return nullptr;
+	}
+
+	FMemory::Memzero(&AsyncSend->Message, sizeof(AsyncSend->Message));
+	AsyncSend->Message.msg_iov = AsyncSend->Iovecs;
+	AsyncSend->Message.msg_iovlen = iovNum;
+	return &AsyncSend->Message;
+}
+
+bool FServoConnection::CompleteAsyncSend(int32 InResult)
+{
+	if (InResult < 0)
+	{
+		UE_LOG(LogTemp, Display, TEXT("FServoConnection: async send failed, errno %d, drop %d packets, rank = %d\n"), -InResult, Sender.NumQueued(), RankId);
+		Sender.Reset();
+		return false;
+	}
+
+	// a short send leaves the rest queued for the next batch
+	Sender.Complete(InResult);
+	return true;
+}
+#endif // SERVO_PROTOCOL_GATHER_SEND
+
+void FServoConnection::MoveOutbox()
+{
+	FScopeLock lockOutbox(&OutboxCriticalSection);
+	for (int32 i = 0; i < Outbox.Num(); ++i)
+	{
+		Sender.Enqueue(Outbox[i]);
+	}
+	Outbox.Reset();
+}
@@ -0,0 +1,122 @@
+// Copyright (c) 2013-2019 7Mersenne All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Networking.h"
+#include "../Protocol/ServoFrameDecoder.h"
+#include "../Protocol/ServoGatherSender.h"
+
+/**
+ * one client connection served by a reactor thread
+ * owns the socket, the decoder of split frames and the send queue.
+ * read/flush are called by the owning reactor only,
+ * SendPacket is thread safe
+ */
+class SEPTEMSERVO_API FServoConnection
+{
+public:
+	FServoConnection(FSocket* InSocket, const FIPv4Address& InIP, int32 InPort, int32 InRank);
+	~FServoConnection();
+
+	FSocket* GetSocket() const;
+	const FIPv4Address& GetIP() const;
+	int32 GetPort() const;
+	int32 GetRankID() const;
+
+	/**
+	 * Decode bytes received into slab and push packets to protocol.
+	 * the slab keeps one reference per packet body view, caller still releases its own reference.
+	 * frames are decoded only as far as the packet pool has room, the rest is kept with a slab reference.
+	 * packets of a full lane are parked here, packets of other lanes still go through
+	 * @return false when bytes or packets are kept, the reader should pause and call ResumeReceived later
+	 */
+	bool OnReceived(FSNetRecvSlab* InSlab, int32 InBytes);
+
+	/**
+	 * Push parked packets, then decode bytes kept by OnReceived, in recv order.
+	 * @return true when nothing is kept any more
+	 */
+	bool ResumeReceived();
+
+	// bytes received but not decoded yet or packets parked, the reader must not recv before they are pushed
+	bool HasPendingReceived() const;
+
+	/**
+	 * thread safe; queue sealed packet, sent by the reactor in batch
+	 * @return true if outbox was empty, the reactor should be woken to flush
+	 */
+	bool SendPacket(const FServoPacketRef& InPacket);
+
+	/**
+	 * Move outbox to sender and send until queue is empty or socket would block.
+	 * @return false when socket error
+	 */
+	bool FlushSend();
+
+	// packets queued in sender, not fully sent
+	bool HasPendingSend() const;
+
+#if SERVO_PROTOCOL_GATHER_SEND
+	/**
+	 * Move outbox to sender and build the message of the next batch for an async sendmsg.
+	 * the message and its packets stay valid until CompleteAsyncSend
+	 * @return nullptr when nothing to send
+	 */
+	const struct msghdr* PrepareAsyncSend();
+
+	/**
+	 * @param InResult		bytes sent, or -errno
+	 * @return false when send failed, queued packets are dropped
+	 */
+	bool CompleteAsyncSend(int32 InResult);
+#endif // SERVO_PROTOCOL_GATHER_SEND
+
+	// reactor stopped reading at backpressure, bytes are left in kernel
+	bool bReadPaused;
+
+	// async reactor (io_uring) only: ops in flight, the connection is deleted when closing and none is armed
+	bool bRecvArmed;
+	bool bSendArmed;
+	bool bClosing;
+
+private:
+	// packets queued by other threads go to sender
+	void MoveOutbox();
+
+	FSocket* Socket;
+	FIPv4Address ClientIPAdress;
+	int32 Port;
+	int32 RankId;
+
+	// carry frames split by recv
+	FServoFrameDecoder FrameDecoder;
+	// packets decoded but not pushed yet, their lane was full; in decode order
+	TArray<FServoPacketRef> ParkedPackets;
+
+	// bytes [Offset, End) of a recv slab waiting for room in packet pool
+	struct FPendingRecv
+	{
+		FSNetRecvSlab* Slab;
+		int32 Offset;
+		int32 End;
+
+		FPendingRecv(FSNetRecvSlab* InSlab, int32 InOffset, int32 InEnd)
+			: Slab(InSlab)
+			, Offset(InOffset)
+			, End(InEnd)
+		{
+		}
+	};
+	TArray<FPendingRecv> PendingRecvs;
+
+	// packets queued by other threads
+	FCriticalSection OutboxCriticalSection;
+	TArray<FServoPacketRef> Outbox;
+	// head, body and foot of queued packets go to socket in place
+	FServoGatherSender Sender;
+#if SERVO_PROTOCOL_GATHER_SEND
+	// message of the async send in flight, allocated on first use
+	struct FServoAsyncSend* AsyncSend;
+#endif // SERVO_PROTOCOL_GATHER_SEND
+};
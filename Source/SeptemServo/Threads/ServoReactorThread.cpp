@@ -0,0 +1,901 @@
+// Copyright (c) 2013-2019 7Mersenne All Rights Reserved.
+
+#include "ServoReactorThread.h"
+
+#include "Misc/ScopeLock.h"
+
+#if SERVO_REACTOR_EPOLL
+#include "../Protocol/ServoNativeSocket.h"
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <errno.h>
+
+static int32 GetNativeHandle(FServoConnection* InConnection)
+{
+	return GetNativeSocketHandle(InConnection->GetSocket());
+}
+#endif // SERVO_REACTOR_EPOLL
+
+#if SERVO_REACTOR_URING
+#include <poll.h>
+
+// op of a ring entry in the low bits of user_data, the rest is the connection
+enum class EServoUringOp : uint64
+{
+	Wake = 0,
+	Recv = 1,
+	Send = 2,
+	Cancel = 3
+};
+
+static const uint64 ServoUringOpMask = 7;
+
+static FORCEINLINE uint64 PackUserData(FServoConnection* InConnection, EServoUringOp InOp)
+{
+	return (uint64)(UPTRINT)InConnection | (uint64)InOp;
+}
+#endif // SERVO_REACTOR_URING
+
+bool FServoReactorThread::bUseUring = false;
+
+FServoReactorThread::FServoReactorThread(int32 InIndex)
+	:FRunnable()
+	, TimeToDie(false)
+	, bKillDone(false)
+	, Thread(nullptr)
+	, ReactorIndex(InIndex)
+	, SpareSlab(nullptr)
+#if SERVO_REACTOR_URING
+	, Uring(nullptr)
+#endif // SERVO_REACTOR_URING
+{
+#if SERVO_REACTOR_EPOLL
+	EpollFd = epoll_create1(EPOLL_CLOEXEC);
+	WakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (EpollFd >= 0 && WakeFd >= 0)
+	{
+		// wake event has no connection
+		struct epoll_event event;
+		event.events = EPOLLIN;
+		event.data.ptr = nullptr;
+		epoll_ctl(EpollFd, EPOLL_CTL_ADD, WakeFd, &event);
+	}
+#endif // SERVO_REACTOR_EPOLL
+}
+
+FServoReactorThread::~FServoReactorThread()
+{
+	// cleanup thread
+	if (nullptr != Thread)
+	{
+		delete Thread;
+		Thread = nullptr;
+	}
+
+	// connections added after exit
+	CloseAllConnections();
+
+#if SERVO_REACTOR_URING
+	DestroyUring();
+#endif // SERVO_REACTOR_URING
+
+#if SERVO_REACTOR_EPOLL
+	if (WakeFd >= 0)
+	{
+		close(WakeFd);
+		WakeFd = -1;
+	}
+	if (EpollFd >= 0)
+	{
+		close(EpollFd);
+		EpollFd = -1;
+	}
+#endif // SERVO_REACTOR_EPOLL
+}
+
+bool FServoReactorThread::Init()
+{
+	LifecycleStep.Set(1);
+#if SERVO_REACTOR_EPOLL
+	return EpollFd >= 0 && WakeFd >= 0;
+#else
+	return true;
+#endif // SERVO_REACTOR_EPOLL
+}
+
+uint32 FServoReactorThread::Run()
+{
+	LifecycleStep.Set(2);
+
+#if SERVO_REACTOR_URING
+	if (nullptr != Uring)
+	{
+		return RunUring();
+	}
+#endif // SERVO_REACTOR_URING
+
+#if SERVO_REACTOR_EPOLL
+	struct epoll_event events[SERVO_REACTOR_EVENTS_MAX];
+	while (!TimeToDie)
+	{
+		// paused reads are retried soon, backpressure drains in milliseconds
+		const int32 waitMs = PausedRanks.Num() > 0 ? 1 : SERVO_REACTOR_WAIT_MS;
+		const int32 num = epoll_wait(EpollFd, events, SERVO_REACTOR_EVENTS_MAX, waitMs);
+		if (num < 0 && EINTR != errno)
+		{
+			UE_LOG(LogTemp, Warning, TEXT("FServoReactorThread: epoll_wait failed, errno %d, reactor = %d"), errno, ReactorIndex);
+			return 1ui32;
+		}
+
+		for (int32 i = 0; i < num; ++i)
+		{
+			FServoConnection* connection = (FServoConnection*)events[i].data.ptr;
+			if (nullptr == connection)
+			{
+				// woken by other thread
+				uint64 value = 0;
+				read(WakeFd, &value, sizeof(value));
+				continue;
+			}
+
+			// hang up and error are found by recv: 0 or error after the last bytes
+			const uint32 flags = events[i].events;
+			bool bOpen = true;
+			if (flags & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR))
+			{
+				bOpen = ReadConnection(connection);
+			}
+			if (bOpen && (flags & EPOLLOUT))
+			{
+				bOpen = WriteConnection(connection);
+			}
+			if (!bOpen)
+			{
+				CloseConnection(connection);
+			}
+		}
+
+		AcceptIncoming();
+		FlushSendReady();
+		ResumePausedReads();
+	}
+#else
+	while (!TimeToDie)
+	{
+		AcceptIncoming();
+		FlushSendReady();
+		ResumePausedReads();
+		PollConnections();
+	}
+#endif // SERVO_REACTOR_EPOLL
+
+	// ExitCode:0 means no error
+	return 0;
+}
+
+void FServoReactorThread::Stop()
+{
+	if (!bStopped) {
+		TimeToDie = true;
+		Wake();
+		bStopped = true;
+	}
+}
+
+void FServoReactorThread::Exit()
+{
+	LifecycleStep.Set(3);
+	CloseAllConnections();
+#if SERVO_REACTOR_URING
+	DrainUring();
+#endif // SERVO_REACTOR_URING
+	UE_LOG(LogTemp, Display, TEXT("FServoReactorThread: exit(), reactor = %d\n"), ReactorIndex);
+	LifecycleStep.Set(4);
+}
+
+bool FServoReactorThread::KillThread()
+{
+	if (!bKillDone)
+	{
+		TimeToDie = true;
+
+		if (nullptr != Thread)
+		{
+			Stop();
+
+			// Block until this thread exits()
+			Thread->WaitForCompletion();
+
+			delete Thread;
+			Thread = nullptr;
+		}
+
+		bKillDone = true;
+	}
+
+	return bKillDone;
+}
+
+FServoReactorThread * FServoReactorThread::Create(int32 InIndex)
+{
+	FServoReactorThread* runnable = new FServoReactorThread(InIndex);
+#if SERVO_REACTOR_EPOLL
+	if (runnable->EpollFd < 0 || runnable->WakeFd < 0)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("FServoReactorThread: failed to create epoll, errno %d"), errno);
+		delete runnable;
+		return nullptr;
+	}
+#endif // SERVO_REACTOR_EPOLL
+
+#if SERVO_REACTOR_URING
+	if (bUseUring && !runnable->InitUring())
+	{
+		UE_LOG(LogTemp, Display, TEXT("FServoReactorThread: io_uring is not available, reactor %d runs on epoll"), InIndex);
+	}
+#endif // SERVO_REACTOR_URING
+
+	// create thread with runnable
+	FString threadName = FString::Printf(TEXT("FServoReactorThread%d"), InIndex);
+
+	FRunnableThread* thread = FRunnableThread::Create(runnable, *threadName, 0, TPri_BelowNormal);
+	if (nullptr == thread)
+	{
+		// create failed
+		delete runnable;
+		return nullptr;
+	}
+
+	// setting thread
+	runnable->Thread = thread;
+	return runnable;
+}
+
+void FServoReactorThread::AddConnection(FServoConnection * InConnection)
+{
+	if (nullptr == InConnection)
+		return;
+
+	Incoming.Enqueue(InConnection);
+	Wake();
+}
+
+bool FServoReactorThread::SendPacket(int32 InRank, const FServoPacketRef & InPacket)
+{
+	bool bWake = false;
+	{
+		FScopeLock lockConnections(&ConnectionsLock);
+		FServoConnection** connection = Connections.Find(InRank);
+		if (nullptr == connection)
+		{
+			return false;
+		}
+		bWake = (*connection)->SendPacket(InPacket);
+	}
+
+	if (bWake)
+	{
+		SendReady.Enqueue(InRank);
+		Wake();
+	}
+	return true;
+}
+
+int32 FServoReactorThread::GetConnectionNum() const
+{
+	return ConnectionNum.GetValue();
+}
+
+int32 FServoReactorThread::GetLifecycleStep()
+{
+	return LifecycleStep.GetValue();
+}
+
+bool FServoReactorThread::IsKillDone()
+{
+	bool ret = bKillDone;
+	return ret;
+}
+
+bool FServoReactorThread::IsUring() const
+{
+#if SERVO_REACTOR_URING
+	return nullptr != Uring;
+#else
+	return false;
+#endif // SERVO_REACTOR_URING
+}
+
+void FServoReactorThread::Wake()
+{
+#if SERVO_REACTOR_EPOLL
+	const uint64 value = 1;
+	write(WakeFd, &value, sizeof(value));
+#endif // SERVO_REACTOR_EPOLL
+}
+
+void FServoReactorThread::AcceptIncoming()
+{
+	FServoConnection* connection = nullptr;
+	while (Incoming.Dequeue(connection))
+	{
+		{
+			FScopeLock lockConnections(&ConnectionsLock);
+			Connections.Add(connection->GetRankID(), connection);
+		}
+		ConnectionNum.Increment();
+
+#if SERVO_REACTOR_URING
+		if (nullptr != Uring)
+		{
+			// sockets stay non-blocking, the ring arms its own poll
+			if (!ArmRecv(connection))
+			{
+				CloseConnection(connection);
+			}
+			continue;
+		}
+#endif // SERVO_REACTOR_URING
+
+#if SERVO_REACTOR_EPOLL
+		// edge-triggered: one event per arrival, the reader drains the socket
+		struct epoll_event event;
+		event.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+		event.data.ptr = connection;
+		if (0 != epoll_ctl(EpollFd, EPOLL_CTL_ADD, GetNativeHandle(connection), &event))
+		{
+			UE_LOG(LogTemp, Warning, TEXT("FServoReactorThread: epoll_ctl add failed, errno %d, rank = %d"), errno, connection->GetRankID());
+			CloseConnection(connection);
+		}
+#endif // SERVO_REACTOR_EPOLL
+	}
+}
+
+void FServoReactorThread::FlushSendReady()
+{
+	int32 rank = 0;
+	while (SendReady.Dequeue(rank))
+	{
+		// the connection may have closed since queued
+		FServoConnection** connection = Connections.Find(rank);
+		if (connection && !WriteConnection(*connection))
+		{
+			CloseConnection(*connection);
+		}
+	}
+}
+
+void FServoReactorThread::ResumePausedReads()
+{
+	if (PausedRanks.Num() == 0 || FServoProtocol::Get()->IsBackpressure())
+		return;
+
+	TArray<int32> pausedRanks;
+	Exchange(pausedRanks, PausedRanks);
+	for (int32 i = 0; i < pausedRanks.Num(); ++i)
+	{
+		FServoConnection** connection = Connections.Find(pausedRanks[i]);
+		if (nullptr == connection)
+			continue;
+
+		(*connection)->bReadPaused = false;
+		if (!ReadConnection(*connection))
+		{
+			CloseConnection(*connection);
+		}
+	}
+}
+
+bool FServoReactorThread::ReadConnection(FServoConnection * InConnection)
+{
+#if SERVO_REACTOR_URING
+	if (nullptr != Uring)
+	{
+		// recv is async, bytes are handled on completion
+		return ArmRecv(InConnection);
+	}
+#endif // SERVO_REACTOR_URING
+
+	FServoProtocol* ServoProtocol = FServoProtocol::Get();
+
+	// bytes kept from last recv go first
+	if (InConnection->HasPendingReceived() && !InConnection->ResumeReceived())
+	{
+		PauseRead(InConnection);
+		return true;
+	}
+
+	while (!TimeToDie)
+	{
+		// over high watermark leave bytes in kernel, tcp flow control slows the client
+		if (ServoProtocol->IsBackpressure())
+		{
+			PauseRead(InConnection);
+			return true;
+		}
+
+		if (nullptr == SpareSlab)
+		{
+			SpareSlab = ServoProtocol->AllocRecvSlab();
+		}
+
+		int32 BytesRead = 0;
+#if SERVO_REACTOR_EPOLL
+		const ssize_t recvSize = recv(GetNativeHandle(InConnection), SpareSlab->GetData(), SpareSlab->GetCapacity(), MSG_DONTWAIT);
+		if (recvSize == 0)
+		{
+			// peer closed
+			return false;
+		}
+		if (recvSize < 0)
+		{
+			if (EINTR == errno)
+				continue;
+			// socket drained, wait for next edge
+			return EAGAIN == errno || EWOULDBLOCK == errno;
+		}
+		BytesRead = (int32)recvSize;
+#else
+		uint32 pendingDataSize = 0;
+		if (!InConnection->GetSocket()->HasPendingData(pendingDataSize) || 0 == pendingDataSize)
+		{
+			return true;
+		}
+		const int32 RecvSize = FMath::Min<int32>(pendingDataSize, SpareSlab->GetCapacity());
+		if (!InConnection->GetSocket()->Recv(SpareSlab->GetData(), RecvSize, BytesRead) || BytesRead <= 0)
+		{
+			return false;
+		}
+#endif // SERVO_REACTOR_EPOLL
+
+		// packet bodies are views into the slab
+		FSNetRecvSlab* RecvSlab = SpareSlab;
+		SpareSlab = nullptr;
+		const bool bDecoded = InConnection->OnReceived(RecvSlab, BytesRead);
+
+		// drop the reader reference, the slab will be recycled after the last packet view is deallocated
+		RecvSlab->Release();
+
+		if (!bDecoded)
+		{
+			// packet pool is full, the rest of this recv waits in the connection
+			PauseRead(InConnection);
+			return true;
+		}
+	}
+
+	return true;
+}
+
+void FServoReactorThread::PauseRead(FServoConnection * InConnection)
+{
+	if (!InConnection->bReadPaused)
+	{
+		InConnection->bReadPaused = true;
+		PausedRanks.Add(InConnection->GetRankID());
+	}
+}
+
+bool FServoReactorThread::WriteConnection(FServoConnection * InConnection)
+{
+#if SERVO_REACTOR_URING
+	if (nullptr != Uring)
+	{
+		return ArmSend(InConnection);
+	}
+#endif // SERVO_REACTOR_URING
+
+	// bytes left by a would-block send go out on next writable edge
+	return InConnection->FlushSend();
+}
+
+void FServoReactorThread::CloseConnection(FServoConnection * InConnection)
+{
+	UE_LOG(LogTemp, Display, TEXT("FServoReactorThread: close connection ip = %s, rank = %d\n"),
+		*FIPv4Endpoint(InConnection->GetIP(), InConnection->GetPort()).ToString(), InConnection->GetRankID());
+
+	{
+		FScopeLock lockConnections(&ConnectionsLock);
+		Connections.Remove(InConnection->GetRankID());
+	}
+	ConnectionNum.Decrement();
+
+#if SERVO_REACTOR_URING
+	if (nullptr != Uring)
+	{
+		// shutdown ends the recv and send in flight, the connection is deleted after their completions
+		InConnection->bClosing = true;
+		shutdown(GetNativeHandle(InConnection), SHUT_RDWR);
+		ClosingConnections.Add(InConnection);
+		DeleteIfIdle(InConnection);
+		return;
+	}
+#endif // SERVO_REACTOR_URING
+
+#if SERVO_REACTOR_EPOLL
+	epoll_ctl(EpollFd, EPOLL_CTL_DEL, GetNativeHandle(InConnection), nullptr);
+#endif // SERVO_REACTOR_EPOLL
+
+	// socket is destroyed with connection
+	delete InConnection;
+}
+
+void FServoReactorThread::CloseAllConnections()
+{
+	TArray<FServoConnection*> connections;
+	{
+		FScopeLock lockConnections(&ConnectionsLock);
+		Connections.GenerateValueArray(connections);
+	}
+	for (int32 i = 0; i < connections.Num(); ++i)
+	{
+		CloseConnection(connections[i]);
+	}
+
+	// connections never accepted by reactor
+	FServoConnection* connection = nullptr;
+	while (Incoming.Dequeue(connection))
+	{
+		delete connection;
+	}
+
+	PausedRanks.Reset();
+	int32 rank = 0;
+	while (SendReady.Dequeue(rank))
+	{
+	}
+
+	if (SpareSlab)
+	{
+		SpareSlab->Release();
+		SpareSlab = nullptr;
+	}
+}
+
+#if !SERVO_REACTOR_EPOLL
+void FServoReactorThread::PollConnections()
+{
+	bool bBusy = false;
+	TArray<FServoConnection*> closedConnections;
+	for (TPair<int32, FServoConnection*>& pair : Connections)
+	{
+		FServoConnection* connection = pair.Value;
+		if (connection->GetSocket()->GetConnectionState() != ESocketConnectionState::SCS_Connected)
+		{
+			closedConnections.Add(connection);
+			continue;
+		}
+
+		uint32 pendingDataSize = 0;
+		if (connection->GetSocket()->HasPendingData(pendingDataSize) && pendingDataSize > 0)
+		{
+			bBusy = true;
+			if (!ReadConnection(connection))
+			{
+				closedConnections.Add(connection);
+				continue;
+			}
+		}
+
+		if (connection->HasPendingSend() && !WriteConnection(connection))
+		{
+			closedConnections.Add(connection);
+		}
+	}
+
+	for (int32 i = 0; i < closedConnections.Num(); ++i)
+	{
+		CloseConnection(closedConnections[i]);
+	}
+
+	if (!bBusy)
+	{
+		FPlatformProcess::Sleep(0.001f);
+	}
+}
+#endif // !SERVO_REACTOR_EPOLL
+
+#if SERVO_REACTOR_URING
+bool FServoReactorThread::InitUring()
+{
+	if (!FServoUring::IsSupported())
+		return false;
+
+	FServoUring* uring = new FServoUring();
+	if (!uring->Init(SERVO_REACTOR_URING_ENTRIES, SERVO_REACTOR_URING_BUFFERS, 0))
+	{
+		delete uring;
+		return false;
+	}
+	Uring = uring;
+
+	// kernel picks a slab for each recv, packet bodies are views into it like the epoll reader
+	FServoProtocol* ServoProtocol = FServoProtocol::Get();
+	UringSlabs.SetNum(SERVO_REACTOR_URING_BUFFERS);
+	for (int32 i = 0; i < UringSlabs.Num(); ++i)
+	{
+		UringSlabs[i] = ServoProtocol->AllocRecvSlab();
+		Uring->ProvideBuffer((uint16)i, UringSlabs[i]->GetData(), UringSlabs[i]->GetCapacity());
+	}
+	Uring->CommitBuffers();
+
+	UE_LOG(LogTemp, Display, TEXT("FServoReactorThread: reactor %d runs on io_uring, %d recv slabs"), ReactorIndex, UringSlabs.Num());
+	return true;
+}
+
+uint32 FServoReactorThread::RunUring()
+{
+	ArmWake();
+
+	while (!TimeToDie)
+	{
+		// paused reads are retried soon, backpressure drains in milliseconds
+		const int32 waitMs = PausedRanks.Num() > 0 ? 1 : SERVO_REACTOR_WAIT_MS;
+		if (!Uring->SubmitAndWait(waitMs))
+		{
+			UE_LOG(LogTemp, Warning, TEXT("FServoReactorThread: io_uring_enter failed, errno %d, reactor = %d"), errno, ReactorIndex);
+			return 1ui32;
+		}
+
+		ReapCompletions();
+		AcceptIncoming();
+		FlushSendReady();
+		ResumePausedReads();
+	}
+
+	// ExitCode:0 means no error
+	return 0;
+}
+
+void FServoReactorThread::DrainUring()
+{
+	if (nullptr == Uring)
+		return;
+
+	// sockets are shut down, ops in flight complete soon
+	const double deadline = FPlatformTime::Seconds() + 1.0;
+	while (ClosingConnections.Num() > 0 && FPlatformTime::Seconds() < deadline)
+	{
+		if (!Uring->SubmitAndWait(10))
+			break;
+		ReapCompletions();
+	}
+
+	if (ClosingConnections.Num() > 0)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("FServoReactorThread: %d connections still have ops in flight, reactor = %d"), ClosingConnections.Num(), ReactorIndex);
+	}
+}
+
+void FServoReactorThread::DestroyUring()
+{
+	if (nullptr == Uring)
+		return;
+
+	DrainUring();
+
+	// closing the ring cancels ops left, their buffers are freed after
+	delete Uring;
+	Uring = nullptr;
+
+	for (int32 i = 0; i < ClosingConnections.Num(); ++i)
+	{
+		delete ClosingConnections[i];
+	}
+	ClosingConnections.Reset();
+
+	for (int32 i = 0; i < UringSlabs.Num(); ++i)
+	{
+		UringSlabs[i]->Release();
+	}
+	UringSlabs.Reset();
+}
+
+void FServoReactorThread::ReapCompletions()
+{
+	struct io_uring_cqe* cqe = nullptr;
+	while (nullptr != (cqe = Uring->PeekCqe()))
+	{
+		const uint64 userData = cqe->user_data;
+		const int32 result = cqe->res;
+		const uint32 flags = cqe->flags;
+		Uring->AdvanceCqe();
+
+		FServoConnection* connection = (FServoConnection*)(UPTRINT)(userData & ~ServoUringOpMask);
+		switch ((EServoUringOp)(userData & ServoUringOpMask))
+		{
+		case EServoUringOp::Recv:
+			OnUringRecv(connection, result, flags);
+			break;
+		case EServoUringOp::Send:
+			OnUringSend(connection, result);
+			break;
+		case EServoUringOp::Wake:
+		{
+			// woken by other thread
+			uint64 value = 0;
+			read(WakeFd, &value, sizeof(value));
+			if (!(flags & IORING_CQE_F_MORE) && !TimeToDie)
+			{
+				ArmWake();
+			}
+			break;
+		}
+		default:
+			// result of cancel, the canceled recv completes on its own
+			break;
+		}
+	}
+
+	// slabs provided while reaping are visible to kernel before next submit
+	Uring->CommitBuffers();
+}
+
+void FServoReactorThread::OnUringRecv(FServoConnection * InConnection, int32 InResult, uint32 InFlags)
+{
+	if (InFlags & IORING_CQE_F_BUFFER)
+	{
+		const uint16 bid = (uint16)(InFlags >> IORING_CQE_BUFFER_SHIFT);
+		FSNetRecvSlab* slab = UringSlabs[bid];
+		if (InResult > 0 && !InConnection->bClosing)
+		{
+			// kept bytes hold a slab reference, the slab is replaced below
+			InConnection->OnReceived(slab, InResult);
+		}
+
+		if (slab->GetRefCount() > 1)
+		{
+			// packet views hold the slab, provide a fresh one for this buffer id
+			slab->Release();
+			slab = FServoProtocol::Get()->AllocRecvSlab();
+			UringSlabs[bid] = slab;
+		}
+		Uring->ProvideBuffer(bid, slab->GetData(), slab->GetCapacity());
+	}
+
+	if (InFlags & IORING_CQE_F_MORE)
+	{
+		// recv stays armed; over high watermark or with bytes kept, stop it and leave bytes in kernel
+		if (!InConnection->bReadPaused && (InConnection->HasPendingReceived() || FServoProtocol::Get()->IsBackpressure()))
+		{
+			InConnection->bReadPaused = true;
+			CancelRecv(InConnection);
+		}
+		return;
+	}
+
+	// multishot recv ended
+	InConnection->bRecvArmed = false;
+	if (InConnection->bClosing)
+	{
+		DeleteIfIdle(InConnection);
+		return;
+	}
+
+	// 0: peer closed; canceled at backpressure or out of slabs: arm again, ArmRecv pauses if still over watermark
+	const bool bOpen = InResult > 0 || -ECANCELED == InResult || -ENOBUFS == InResult;
+	InConnection->bReadPaused = false;
+	if (!bOpen || !ArmRecv(InConnection))
+	{
+		CloseConnection(InConnection);
+	}
+}
+
+void FServoReactorThread::OnUringSend(FServoConnection * InConnection, int32 InResult)
+{
+	InConnection->bSendArmed = false;
+	if (InConnection->bClosing)
+	{
+		DeleteIfIdle(InConnection);
+		return;
+	}
+
+	// next batch: rest of a short send and packets queued meanwhile
+	if (!InConnection->CompleteAsyncSend(InResult) || !ArmSend(InConnection))
+	{
+		CloseConnection(InConnection);
+	}
+}
+
+bool FServoReactorThread::ArmRecv(FServoConnection * InConnection)
+{
+	if (InConnection->bRecvArmed || InConnection->bClosing)
+		return true;
+
+	// over high watermark, or bytes kept from last recv, leave bytes in kernel
+	if ((InConnection->HasPendingReceived() && !InConnection->ResumeReceived()) || FServoProtocol::Get()->IsBackpressure())
+	{
+		PauseRead(InConnection);
+		return true;
+	}
+
+	struct io_uring_sqe* sqe = NextSqe();
+	if (nullptr == sqe)
+		return false;
+
+	// one recv serves until it fails, every completion takes one provided slab
+	sqe->opcode = IORING_OP_RECV;
+	sqe->fd = GetNativeHandle(InConnection);
+	sqe->ioprio = IORING_RECV_MULTISHOT;
+	sqe->flags = IOSQE_BUFFER_SELECT;
+	sqe->buf_group = Uring->GetBufferGroup();
+	sqe->user_data = PackUserData(InConnection, EServoUringOp::Recv);
+	InConnection->bRecvArmed = true;
+	return true;
+}
+
+bool FServoReactorThread::ArmSend(FServoConnection * InConnection)
+{
+	// one batch in flight per connection keeps bytes in order
+	if (InConnection->bSendArmed || InConnection->bClosing)
+		return true;
+
+	const struct msghdr* message = InConnection->PrepareAsyncSend();
+	if (nullptr == message)
+		return true;
+
+	struct io_uring_sqe* sqe = NextSqe();
+	if (nullptr == sqe)
+		return false;
+
+	sqe->opcode = IORING_OP_SENDMSG;
+	sqe->fd = GetNativeHandle(InConnection);
+	sqe->addr = (uint64)(UPTRINT)message;
+	sqe->len = 1;
+#ifdef MSG_NOSIGNAL
+	sqe->msg_flags = MSG_NOSIGNAL;
+#endif // MSG_NOSIGNAL
+	sqe->user_data = PackUserData(InConnection, EServoUringOp::Send);
+	InConnection->bSendArmed = true;
+	return true;
+}
+
+void FServoReactorThread::ArmWake()
+{
+	struct io_uring_sqe* sqe = NextSqe();
+	if (nullptr == sqe)
+		return;
+
+	// the ring wait ends when Wake writes eventfd
+	sqe->opcode = IORING_OP_POLL_ADD;
+	sqe->fd = WakeFd;
+	sqe->poll32_events = POLLIN;
+	sqe->len = IORING_POLL_ADD_MULTI;
+	sqe->user_data = PackUserData(nullptr, EServoUringOp::Wake);
+}
+
+void FServoReactorThread::CancelRecv(FServoConnection * InConnection)
+{
+	struct io_uring_sqe* sqe = NextSqe();
+	if (nullptr == sqe)
+		return;
+
+	sqe->opcode = IORING_OP_ASYNC_CANCEL;
+	sqe->addr = PackUserData(InConnection, EServoUringOp::Recv);
+	sqe->user_data = PackUserData(nullptr, EServoUringOp::Cancel);
+}
+
+void FServoReactorThread::DeleteIfIdle(FServoConnection * InConnection)
+{
+	if (InConnection->bRecvArmed || InConnection->bSendArmed)
+		return;
+
+	ClosingConnections.RemoveSwap(InConnection);
+	// socket is destroyed with connection
+	delete InConnection;
+}
+
+struct io_uring_sqe * FServoReactorThread::NextSqe()
+{
+	struct io_uring_sqe* sqe = Uring->GetSqe();
+	if (nullptr == sqe)
+	{
+		// submission queue is full, hand it to kernel and retry
+		Uring->Submit();
+		sqe = Uring->GetSqe();
+	}
+	return sqe;
+}
+#endif // SERVO_REACTOR_URING
@@ -0,0 +1,183 @@
+// Copyright (c) 2013-2019 7Mersenne All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Core/Private/HAL/PThreadRunnableThread.h"
+#include "Networking.h"
+#include "Containers/Queue.h"
+#include "ServoConnection.h"
+#include "ServoUring.h"
+
+/*
+* Reactor waits sockets with epoll (edge-triggered)
+* other platforms poll all sockets of the reactor each loop
+*/
+#ifndef SERVO_REACTOR_EPOLL
+#define SERVO_REACTOR_EPOLL PLATFORM_LINUX
+#endif // !SERVO_REACTOR_EPOLL
+
+/*
+* Reactor threads of one connection pool
+*/
+#ifndef SERVO_REACTOR_THREAD_NUM
+#define SERVO_REACTOR_THREAD_NUM 4
+#endif // !SERVO_REACTOR_THREAD_NUM
+
+/*
+* Max socket events handled by one epoll_wait
+*/
+#ifndef SERVO_REACTOR_EVENTS_MAX
+#define SERVO_REACTOR_EVENTS_MAX 256
+#endif // !SERVO_REACTOR_EVENTS_MAX
+
+/*
+* Max milliseconds of one wait, reactor checks stop at least this often
+*/
+#ifndef SERVO_REACTOR_WAIT_MS
+#define SERVO_REACTOR_WAIT_MS 50
+#endif // !SERVO_REACTOR_WAIT_MS
+
+#if SERVO_REACTOR_URING && !SERVO_REACTOR_EPOLL
+// io_uring reactor shares the wake eventfd of epoll reactor and falls back to it
+#undef SERVO_REACTOR_URING
+#define SERVO_REACTOR_URING 0
+#endif // SERVO_REACTOR_URING && !SERVO_REACTOR_EPOLL
+
+/**
+ * serves many non-blocking connections on one thread
+ * reads each readable socket until it would block, decodes into the packet pool,
+ * and flushes queued sends when the socket is writable.
+ * connections are owned by the reactor, closed on hang up or socket error.
+ * with bUseUring on linux 6.0+ the reactor runs on io_uring instead:
+ * multishot recv into provided recv slabs, one async sendmsg per send batch.
+ */
+class SEPTEMSERVO_API FServoReactorThread : public FRunnable
+{
+public:
+	FServoReactorThread(int32 InIndex);
+	virtual ~FServoReactorThread();
+
+	// Begin FRunnable interface.
+	virtual bool Init() override;
+	virtual uint32 Run() override;
+	virtual void Stop() override;
+	virtual void Exit() override;
+	// End FRunnable interface
+
+	// must use KillThread to void deadlock
+	// block kill, close all connections
+	bool KillThread();
+	// io_uring is tried when bUseUring, epoll is used when kernel doesn't support it
+	static FServoReactorThread* Create(int32 InIndex);
+
+	// config: serve connections with io_uring when supported, set before reactors are created
+	static bool bUseUring;
+
+	// thread safe; the reactor owns InConnection from now on
+	void AddConnection(FServoConnection* InConnection);
+
+	// thread safe; false if no connection of InRank in this reactor
+	bool SendPacket(int32 InRank, const FServoPacketRef& InPacket);
+
+	// thread safe
+	int32 GetConnectionNum() const;
+	int32 GetLifecycleStep();
+	bool IsKillDone();
+	// true if this reactor runs on io_uring
+	bool IsUring() const;
+
+private:
+	// wake reactor from wait, thread safe
+	void Wake();
+
+	// reactor thread only
+	void AcceptIncoming();
+	void FlushSendReady();
+	void ResumePausedReads();
+	// read until would block, false when connection should be closed
+	bool ReadConnection(FServoConnection* InConnection);
+	// false when connection should be closed
+	bool WriteConnection(FServoConnection* InConnection);
+	void CloseConnection(FServoConnection* InConnection);
+	void CloseAllConnections();
+	// stop reading until ResumePausedReads, bytes are left in kernel
+	void PauseRead(FServoConnection* InConnection);
+#if !SERVO_REACTOR_EPOLL
+	void PollConnections();
+#endif // !SERVO_REACTOR_EPOLL
+
+#if SERVO_REACTOR_URING
+	// create ring and provide recv slabs, false to stay on epoll
+	bool InitUring();
+	uint32 RunUring();
+	// wait closed connections for their ops in flight, then free the ring
+	void DrainUring();
+	void DestroyUring();
+	void ReapCompletions();
+	void OnUringRecv(FServoConnection* InConnection, int32 InResult, uint32 InFlags);
+	void OnUringSend(FServoConnection* InConnection, int32 InResult);
+	// false when the ring can't take the op, connection should be closed
+	bool ArmRecv(FServoConnection* InConnection);
+	bool ArmSend(FServoConnection* InConnection);
+	void ArmWake();
+	// stop multishot recv, the recv completes with -ECANCELED
+	void CancelRecv(FServoConnection* InConnection);
+	// delete closed connection after its last op completed
+	void DeleteIfIdle(FServoConnection* InConnection);
+	struct io_uring_sqe* NextSqe();
+#endif // SERVO_REACTOR_URING
+
+	//---------------------------------------------
+	// thread control
+	//---------------------------------------------
+
+	/** If true, the thread should exit. */
+	TAtomic<bool> TimeToDie;
+
+	// if ture means we had called stop();
+	FThreadSafeBool bStopped;
+
+	// thread had killed, so there is no run
+	FThreadSafeBool bKillDone;
+
+	FThreadSafeCounter LifecycleStep;
+
+	// main thread
+	FRunnableThread* Thread;
+
+	//---------------------------------------------
+	// connections
+	//---------------------------------------------
+	int32 ReactorIndex;
+
+	// written by reactor thread under lock, read by other threads under lock
+	mutable FCriticalSection ConnectionsLock;
+	TMap<int32, FServoConnection*> Connections;
+	FThreadSafeCounter ConnectionNum;
+
+	// connections added by other threads
+	TQueue<FServoConnection*, EQueueMode::Mpsc> Incoming;
+	// ranks of connections with new outbox packets
+	TQueue<int32, EQueueMode::Mpsc> SendReady;
+	// ranks of connections stopped at backpressure, reactor thread only
+	TArray<int32> PausedRanks;
+
+	// slab kept for next recv when last recv read nothing
+	FSNetRecvSlab* SpareSlab;
+
+#if SERVO_REACTOR_EPOLL
+	int32 EpollFd;
+	// eventfd in epoll set, written by Wake
+	int32 WakeFd;
+#endif // SERVO_REACTOR_EPOLL
+
+#if SERVO_REACTOR_URING
+	// nullptr when reactor runs on epoll
+	FServoUring* Uring;
+	// slab provided to kernel for each buffer id
+	TArray<FSNetRecvSlab*> UringSlabs;
+	// closed connections waiting for their ops in flight
+	TArray<FServoConnection*> ClosingConnections;
+#endif // SERVO_REACTOR_URING
+};
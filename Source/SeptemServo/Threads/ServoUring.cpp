@@ -0,0 +1,293 @@
+// Copyright (c) 2013-2019 7Mersenne All Rights Reserved.
+
+#include "ServoUring.h"
+
+#if SERVO_REACTOR_URING
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/utsname.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdio.h>
+
+// ring indexes are shared with the kernel
+template<typename T>
+static FORCEINLINE T LoadAcquire(const T* InPtr)
+{
+	return __atomic_load_n(InPtr, __ATOMIC_ACQUIRE);
+}
+
+template<typename T>
+static FORCEINLINE void StoreRelease(T* InPtr, T InValue)
+{
+	__atomic_store_n(InPtr, InValue, __ATOMIC_RELEASE);
+}
+
+FServoUring::FServoUring()
+	: RingFd(-1)
+	, RingPtr(nullptr)
+	, RingSize(0)
+	, Sqes(nullptr)
+	, SqesSize(0)
+	, SqHead(nullptr)
+	, SqTail(nullptr)
+	, SqArray(nullptr)
+	, SqMask(0)
+	, SqEntries(0)
+	, SqLocalTail(0)
+	, CqHead(nullptr)
+	, CqTail(nullptr)
+	, CqMask(0)
+	, Cqes(nullptr)
+	, BufRing(nullptr)
+	, BufRingSize(0)
+	, BufMask(0)
+	, BufGroup(0)
+	, BufLocalTail(0)
+{
+}
+
+FServoUring::~FServoUring()
+{
+	Destroy();
+}
+
+bool FServoUring::IsSupported()
+{
+	static const bool bSupported = []()
+	{
+		// multishot recv is the newest feature used, linux 6.0
+		struct utsname name;
+		int32 major = 0;
+		int32 minor = 0;
+		if (0 != uname(&name) || sscanf(name.release, "%d.%d", &major, &minor) != 2)
+		{
+			return false;
+		}
+		if (major < 6)
+		{
+			UE_LOG(LogTemp, Display, TEXT("FServoUring: kernel %d.%d has no multishot recv"), major, minor);
+			return false;
+		}
+
+		// io_uring may be disabled by sysctl or seccomp
+		FServoUring probe;
+		return probe.Init(4, 1, 0);
+	}();
+	return bSupported;
+}
+
+bool FServoUring::Init(uint32 InEntries, uint32 InBufferNum, uint16 InBufferGroup)
+{
+	Destroy();
+
+	struct io_uring_params params;
+	FMemory::Memzero(&params, sizeof(params));
+	params.flags = IORING_SETUP_CLAMP;
+#ifdef IORING_SETUP_COOP_TASKRUN
+	// the reactor enters the ring every loop, no need to interrupt it for completions
+	params.flags |= IORING_SETUP_COOP_TASKRUN;
+#endif // IORING_SETUP_COOP_TASKRUN
+
+	RingFd = (int32)syscall(__NR_io_uring_setup, InEntries, &params);
+#ifdef IORING_SETUP_COOP_TASKRUN
+	if (RingFd < 0 && EINVAL == errno)
+	{
+		// kernel before 5.19
+		params.flags &= ~IORING_SETUP_COOP_TASKRUN;
+		RingFd = (int32)syscall(__NR_io_uring_setup, InEntries, &params);
+	}
+#endif // IORING_SETUP_COOP_TASKRUN
+	if (RingFd < 0)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("FServoUring: io_uring_setup failed, errno %d"), errno);
+		return false;
+	}
+
+	const uint32 required = IORING_FEAT_SINGLE_MMAP | IORING_FEAT_NODROP | IORING_FEAT_EXT_ARG;
+	if ((params.features & required) != required)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("FServoUring: kernel ring features 0x%x lack 0x%x"), params.features, required);
+		Destroy();
+		return false;
+	}
+
+	// 1. map sq and cq rings, and the sqe array
+	RingSize = FMath::Max<size_t>(params.sq_off.array + params.sq_entries * sizeof(uint32),
+		params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe));
+	RingPtr = mmap(nullptr, RingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, RingFd, IORING_OFF_SQ_RING);
+	if (MAP_FAILED == RingPtr)
+	{
+		RingPtr = nullptr;
+		UE_LOG(LogTemp, Warning, TEXT("FServoUring: mmap ring failed, errno %d"), errno);
+		Destroy();
+		return false;
+	}
+
+	SqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+	void* sqes = mmap(nullptr, SqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, RingFd, IORING_OFF_SQES);
+	if (MAP_FAILED == sqes)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("FServoUring: mmap sqes failed, errno %d"), errno);
+		Destroy();
+		return false;
+	}
+	Sqes = (struct io_uring_sqe*)sqes;
+
+	uint8* ring = (uint8*)RingPtr;
+	SqHead = (uint32*)(ring + params.sq_off.head);
+	SqTail = (uint32*)(ring + params.sq_off.tail);
+	SqArray = (uint32*)(ring + params.sq_off.array);
+	SqMask = *(uint32*)(ring + params.sq_off.ring_mask);
+	SqEntries = params.sq_entries;
+	SqLocalTail = *SqTail;
+
+	CqHead = (uint32*)(ring + params.cq_off.head);
+	CqTail = (uint32*)(ring + params.cq_off.tail);
+	CqMask = *(uint32*)(ring + params.cq_off.ring_mask);
+	Cqes = (struct io_uring_cqe*)(ring + params.cq_off.cqes);
+
+	// 2. register provided buffer ring, entries are filled by ProvideBuffer
+	const uint32 bufferNum = FMath::RoundUpToPowerOfTwo(FMath::Max<uint32>(InBufferNum, 1));
+	BufRingSize = bufferNum * sizeof(struct io_uring_buf);
+	void* bufRing = mmap(nullptr, BufRingSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (MAP_FAILED == bufRing)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("FServoUring: mmap buffer ring failed, errno %d"), errno);
+		Destroy();
+		return false;
+	}
+	BufRing = (struct io_uring_buf_ring*)bufRing;
+
+	struct io_uring_buf_reg reg;
+	FMemory::Memzero(&reg, sizeof(reg));
+	reg.ring_addr = (uint64)(UPTRINT)BufRing;
+	reg.ring_entries = bufferNum;
+	reg.bgid = InBufferGroup;
+	if (0 != syscall(__NR_io_uring_register, RingFd, IORING_REGISTER_PBUF_RING, &reg, 1))
+	{
+		UE_LOG(LogTemp, Warning, TEXT("FServoUring: register buffer ring failed, errno %d"), errno);
+		munmap(BufRing, BufRingSize);
+		BufRing = nullptr;
+		Destroy();
+		return false;
+	}
+	BufMask = bufferNum - 1;
+	BufGroup = InBufferGroup;
+	BufLocalTail = 0;
+
+	return true;
+}
+
+struct io_uring_sqe * FServoUring::GetSqe()
+{
+	if (SqLocalTail - LoadAcquire(SqHead) >= SqEntries)
+	{
+		return nullptr;
+	}
+
+	const uint32 index = SqLocalTail & SqMask;
+	struct io_uring_sqe* sqe = &Sqes[index];
+	FMemory::Memzero(sqe, sizeof(struct io_uring_sqe));
+	SqArray[index] = index;
+	++SqLocalTail;
+	return sqe;
+}
+
+bool FServoUring::Submit()
+{
+	StoreRelease(SqTail, SqLocalTail);
+	const uint32 toSubmit = SqLocalTail - LoadAcquire(SqHead);
+	if (0 == toSubmit)
+	{
+		return true;
+	}
+
+	const int32 ret = (int32)syscall(__NR_io_uring_enter, RingFd, toSubmit, 0, 0, nullptr, 0);
+	// EBUSY: completions overflowed, they are reaped before next submit
+	return ret >= 0 || EINTR == errno || EAGAIN == errno || EBUSY == errno;
+}
+
+bool FServoUring::SubmitAndWait(int32 InWaitMs)
+{
+	StoreRelease(SqTail, SqLocalTail);
+	const uint32 toSubmit = SqLocalTail - LoadAcquire(SqHead);
+
+	struct __kernel_timespec timeout;
+	timeout.tv_sec = InWaitMs / 1000;
+	timeout.tv_nsec = (InWaitMs % 1000) * 1000000ll;
+
+	struct io_uring_getevents_arg arg;
+	FMemory::Memzero(&arg, sizeof(arg));
+	arg.ts = (uint64)(UPTRINT)&timeout;
+
+	const int32 ret = (int32)syscall(__NR_io_uring_enter, RingFd, toSubmit, 1, IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg, sizeof(arg));
+	return ret >= 0 || ETIME == errno || EINTR == errno || EAGAIN == errno || EBUSY == errno;
+}
+
+struct io_uring_cqe * FServoUring::PeekCqe()
+{
+	const uint32 head = *CqHead;
+	if (head == LoadAcquire(CqTail))
+	{
+		return nullptr;
+	}
+	return &Cqes[head & CqMask];
+}
+
+void FServoUring::AdvanceCqe()
+{
+	StoreRelease(CqHead, *CqHead + 1);
+}
+
+void FServoUring::ProvideBuffer(uint16 InBid, void * InData, uint32 InSize)
+{
+	// entries begin at the ring start, the tail overlays resv of entry 0.
+	// not BufRing->bufs: the uapi flex array member is misplaced when compiled as c++
+	struct io_uring_buf* buf = reinterpret_cast<struct io_uring_buf*>(BufRing) + (BufLocalTail & BufMask);
+	buf->addr = (uint64)(UPTRINT)InData;
+	buf->len = InSize;
+	buf->bid = InBid;
+	++BufLocalTail;
+}
+
+void FServoUring::CommitBuffers()
+{
+	StoreRelease(&BufRing->tail, BufLocalTail);
+}
+
+uint16 FServoUring::GetBufferGroup() const
+{
+	return BufGroup;
+}
+
+void FServoUring::Destroy()
+{
+	if (nullptr != BufRing)
+	{
+		struct io_uring_buf_reg reg;
+		FMemory::Memzero(&reg, sizeof(reg));
+		reg.bgid = BufGroup;
+		syscall(__NR_io_uring_register, RingFd, IORING_UNREGISTER_PBUF_RING, &reg, 1);
+		munmap(BufRing, BufRingSize);
+		BufRing = nullptr;
+	}
+	if (nullptr != Sqes)
+	{
+		munmap(Sqes, SqesSize);
+		Sqes = nullptr;
+	}
+	if (nullptr != RingPtr)
+	{
+		munmap(RingPtr, RingSize);
+		RingPtr = nullptr;
+	}
+	if (RingFd >= 0)
+	{
+		close(RingFd);
+		RingFd = -1;
+	}
+}
+
+#endif // SERVO_REACTOR_URING
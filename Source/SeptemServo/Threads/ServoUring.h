@@ -0,0 +1,129 @@
+// Copyright (c) 2013-2019 7Mersenne All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/*
+* Reactor may serve sockets with io_uring: multishot recv into provided buffers, async sendmsg.
+* needs linux uapi headers with multishot recv, the running kernel is probed at startup
+* and the reactor falls back to epoll when it is too old
+*/
+#ifndef SERVO_REACTOR_URING
+#if PLATFORM_LINUX && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define SERVO_REACTOR_URING 1
+#endif
+#endif
+#endif // !SERVO_REACTOR_URING
+
+#ifndef SERVO_REACTOR_URING
+#define SERVO_REACTOR_URING 0
+#endif // !SERVO_REACTOR_URING
+
+#if SERVO_REACTOR_URING
+#include <linux/io_uring.h>
+#if !defined(IORING_RECV_MULTISHOT) || !defined(IORING_ENTER_EXT_ARG)
+// uapi headers are older than linux 6.0
+#undef SERVO_REACTOR_URING
+#define SERVO_REACTOR_URING 0
+#endif
+#endif // SERVO_REACTOR_URING
+
+/*
+* Submission entries of one reactor ring, completion queue is twice as big
+*/
+#ifndef SERVO_REACTOR_URING_ENTRIES
+#define SERVO_REACTOR_URING_ENTRIES 256
+#endif // !SERVO_REACTOR_URING_ENTRIES
+
+/*
+* Recv slabs provided to the kernel by one reactor, power of two
+* every recv completion takes one slab, the reactor provides a new one right away
+*/
+#ifndef SERVO_REACTOR_URING_BUFFERS
+#define SERVO_REACTOR_URING_BUFFERS 32
+#endif // !SERVO_REACTOR_URING_BUFFERS
+
+#if SERVO_REACTOR_URING
+
+/**
+ * minimal io_uring over raw syscalls, no liburing
+ * one ring with one provided buffer ring, owned by one reactor thread.
+ * not thread safe
+ */
+class SEPTEMSERVO_API FServoUring
+{
+public:
+	FServoUring();
+	~FServoUring();
+
+	/**
+	 * true if the running kernel has every feature the reactor uses:
+	 * multishot recv (6.0), provided buffer rings and wait with timeout
+	 * probed once
+	 */
+	static bool IsSupported();
+
+	// create ring and buffer ring of InBufferNum entries in group InBufferGroup
+	bool Init(uint32 InEntries, uint32 InBufferNum, uint16 InBufferGroup);
+
+	/**
+	 * next free submission entry, zeroed
+	 * @return nullptr when submission queue is full, Submit and retry
+	 */
+	struct io_uring_sqe* GetSqe();
+
+	// submit queued entries without waiting, false on ring error
+	bool Submit();
+
+	/**
+	 * submit queued entries and wait for a completion up to InWaitMs
+	 * @return false on ring error, timeout and signal are not errors
+	 */
+	bool SubmitAndWait(int32 InWaitMs);
+
+	// next completion, nullptr when none; valid until AdvanceCqe
+	struct io_uring_cqe* PeekCqe();
+	void AdvanceCqe();
+
+	// queue buffer InBid to the buffer ring, visible to kernel after CommitBuffers
+	void ProvideBuffer(uint16 InBid, void* InData, uint32 InSize);
+	void CommitBuffers();
+
+	uint16 GetBufferGroup() const;
+
+private:
+	void Destroy();
+
+	int32 RingFd;
+
+	// sq and cq share one mapping (IORING_FEAT_SINGLE_MMAP)
+	void* RingPtr;
+	size_t RingSize;
+	struct io_uring_sqe* Sqes;
+	size_t SqesSize;
+
+	uint32* SqHead;
+	uint32* SqTail;
+	uint32* SqArray;
+	uint32 SqMask;
+	uint32 SqEntries;
+	// tail of entries filled by GetSqe, published by Submit
+	uint32 SqLocalTail;
+
+	uint32* CqHead;
+	uint32* CqTail;
+	uint32 CqMask;
+	struct io_uring_cqe* Cqes;
+
+	// provided buffer ring
+	struct io_uring_buf_ring* BufRing;
+	size_t BufRingSize;
+	uint32 BufMask;
+	uint16 BufGroup;
+	// buffers queued by ProvideBuffer, published by CommitBuffers
+	uint16 BufLocalTail;
+};
+
+#endif // SERVO_REACTOR_URING
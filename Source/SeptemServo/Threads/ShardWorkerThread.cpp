@@ -0,0 +1,105 @@
+// Copyright (c) 2013-2019 7Mersenne All Rights Reserved.
+
+#include "ShardWorkerThread.h"
+#include "../Protocol/ServoShards.h"
+
+FShardWorkerThread::FShardWorkerThread(FServoShards * InShards, int32 InShard)
+	:FRunnable()
+	, TimeToDie(false)
+	, bKillDone(false)
+	, Thread(nullptr)
+	, Shards(InShards)
+	, ShardIndex(InShard)
+{
+}
+
+FShardWorkerThread::~FShardWorkerThread()
+{
+	// cleanup thread
+	if (nullptr != Thread)
+	{
+		delete Thread;
+		Thread = nullptr;
+	}
+}
+
+bool FShardWorkerThread::Init()
+{
+	return nullptr != Shards;
+}
+
+uint32 FShardWorkerThread::Run()
+{
+	while (!TimeToDie)
+	{
+		if (0 == Shards->DrainShard(ShardIndex))
+		{
+			// shard is empty, sleep until the next push
+			Shards->WaitShard(ShardIndex);
+		}
+	}
+
+	// ExitCode:0 means no error
+	return 0;
+}
+
+void FShardWorkerThread::Stop()
+{
+	if (!bStopped) {
+		TimeToDie = true;
+		Shards->WakeShard(ShardIndex);
+		bStopped = true;
+	}
+}
+
+void FShardWorkerThread::Exit()
+{
+}
+
+bool FShardWorkerThread::KillThread()
+{
+	if (!bKillDone)
+	{
+		TimeToDie = true;
+
+		if (nullptr != Thread)
+		{
+			Stop();
+
+			// Block until this thread exits()
+			Thread->WaitForCompletion();
+
+			delete Thread;
+			Thread = nullptr;
+		}
+
+		bKillDone = true;
+	}
+
+	return bKillDone;
+}
+
+FShardWorkerThread * FShardWorkerThread::Create(FServoShards * InShards, int32 InShard)
+{
+	FShardWorkerThread* runnable = new FShardWorkerThread(InShards, InShard);
+	// create thread with runnable
+	FString threadName = FString::Printf(TEXT("FShardWorkerThread%d"), InShard);
+
+	FRunnableThread* thread = FRunnableThread::Create(runnable, *threadName, 0, TPri_BelowNormal);
+	if (nullptr == thread)
+	{
+		// create failed
+		delete runnable;
+		return nullptr;
+	}
+
+	// setting thread
+	runnable->Thread = thread;
+	return runnable;
+}
+
+bool FShardWorkerThread::IsKillDone()
+{
+	bool ret = bKillDone;
+	return ret;
+}
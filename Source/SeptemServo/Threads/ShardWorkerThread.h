@@ -0,0 +1,54 @@
+// Copyright (c) 2013-2019 7Mersenne All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Core/Private/HAL/PThreadRunnableThread.h"
+
+class FServoShards;
+
+/**
+ * worker of one packet shard
+ * drains the shard queue into the shard handler, in push order
+ * blocks on the shard arrival event while the shard is empty
+ */
+class SEPTEMSERVO_API FShardWorkerThread : public FRunnable
+{
+public:
+	FShardWorkerThread(FServoShards* InShards, int32 InShard);
+	virtual ~FShardWorkerThread();
+
+	// Begin FRunnable interface.
+	virtual bool Init() override;
+	virtual uint32 Run() override;
+	virtual void Stop() override;
+	virtual void Exit() override;
+	// End FRunnable interface
+
+	// must use KillThread to void deadlock
+	// block kill
+	bool KillThread();
+	static FShardWorkerThread* Create(FServoShards* InShards, int32 InShard);
+
+	bool IsKillDone();
+
+private:
+	//---------------------------------------------
+	// thread control
+	//---------------------------------------------
+
+	/** If true, the thread should exit. */
+	TAtomic<bool> TimeToDie;
+
+	// if ture means we had called stop();
+	FThreadSafeBool bStopped;
+
+	// thread had killed, so there is no run
+	FThreadSafeBool bKillDone;
+
+	// main thread
+	FRunnableThread* Thread;
+
+	FServoShards* Shards;
+	int32 ShardIndex;
+};